@@ -0,0 +1,86 @@
+// Mapping accuracy of SAM output for reads from bench/simulate_reads
+//
+//   g++ -std=c++23 -O3 -o eval_sam bench/eval_sam.cpp
+//   ./eval_sam out.sam [tolerance]
+//
+// A mapped read is correct if it lies on its true strand and record and its
+// position is within `tolerance` bases (default: 10) of the true one. Reports
+// sensitivity (correct / all reads) and precision (correct / mapped) for all
+// alignments and for those at or above a few MAPQ thresholds. Paired records
+// are scored against their mate's origin (SAM flags 0x40 and 0x80).
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <iomanip>
+#include "read_simulator.hpp"
+
+using namespace std;
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        cerr << "Usage: " << argv[0] << " <out.sam> [tolerance]" << endl;
+        return 1;
+    }
+    ifstream in(argv[1]);
+    if (!in) {
+        cerr << "Error: Cannot open " << argv[1] << endl;
+        return 1;
+    }
+    long long tolerance = argc > 2 ? stoll(argv[2]) : 10;
+    
+    const vector<int> mapq_thresholds = {0, 1, 20, 60};
+    vector<long long> mapped(mapq_thresholds.size()), correct(mapq_thresholds.size());
+    long long reads = 0, unparsed = 0;
+    string line;
+    vector<string_view> fields;
+    bench::ReadTruth truth;
+    while (getline(in, line)) {
+        if (line.empty() || line[0] == '@') continue;
+        fields.clear();
+        for (size_t start = 0; fields.size() < 6;) {
+            size_t tab = line.find('\t', start);
+            fields.push_back(string_view(line).substr(start, tab - start));
+            if (tab == string::npos) break;
+            start = tab + 1;
+        }
+        if (fields.size() < 6) {
+            cerr << "Error: malformed SAM line: " << line << endl;
+            return 1;
+        }
+        int flag = stoi(string(fields[1]));
+        if (flag & 0x900) continue;  // secondary/supplementary
+        reads++;
+        int mate = flag & 0x40 ? 1 : flag & 0x80 ? 2 : 0;
+        if (!bench::parseTruth(fields[0], truth, mate)) {
+            unparsed++;
+            continue;
+        }
+        if (flag & 0x4) continue;
+        
+        int mapq = stoi(string(fields[4]));
+        bool ok = fields[2] == truth.contig && bool(flag & 0x10) == truth.reverse &&
+                  abs(stoll(string(fields[3])) - truth.pos) <= tolerance;
+        for (size_t t = 0; t < mapq_thresholds.size(); t++) {
+            if (mapq < mapq_thresholds[t]) continue;
+            mapped[t]++;
+            correct[t] += ok;
+        }
+    }
+    if (reads == 0) {
+        cerr << "Error: no alignments in " << argv[1] << endl;
+        return 1;
+    }
+    if (unparsed) cerr << "Warning: " << unparsed << " read names carry no simulated origin" << endl;
+    
+    cout << "Reads: " << reads << " (position tolerance " << tolerance << " bp)" << endl;
+    cout << setw(8) << "MAPQ>=" << setw(12) << "mapped" << setw(12) << "correct" << setw(14) << "sensitivity"
+         << setw(12) << "precision" << endl;
+    for (size_t t = 0; t < mapq_thresholds.size(); t++) {
+        cout << setw(8) << mapq_thresholds[t] << setw(12) << mapped[t] << setw(12) << correct[t] << fixed
+             << setprecision(2) << setw(13) << 100.0 * correct[t] / reads << "%" << setw(11)
+             << (mapped[t] ? 100.0 * correct[t] / mapped[t] : 0.0) << "%" << endl;
+    }
+    return 0;
+}
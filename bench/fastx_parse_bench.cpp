@@ -0,0 +1,94 @@
+// Parse-only throughput of the FASTQ/FASTA readers
+//
+//   g++ -std=c++23 -O3 -pthread -o fastx_bench bench/fastx_parse_bench.cpp -lz
+//   ./fastx_bench reads.fastq[.gz] [genome.fna]
+//
+// Compares the block-buffered readers in lib/fastx.hpp with the previous
+// getline-based parsing. Run twice to measure from a warm page cache.
+// For gzip/BGZF input only the block reader runs, and GB/s refers to the
+// compressed file size.
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <iomanip>
+#include <filesystem>
+#include <thread>
+#include "../lib/fastx.hpp"
+
+using namespace std;
+
+template<typename F>
+double timeSeconds(F&& f) {
+    auto start = chrono::high_resolution_clock::now();
+    f();
+    auto end = chrono::high_resolution_clock::now();
+    return chrono::duration<double>(end - start).count();
+}
+
+void report(const string& name, double bytes, double seconds, long long items, const string& unit) {
+    cout << "  " << left << setw(22) << name << right << fixed << setprecision(3)
+         << setw(8) << bytes / seconds / 1e9 << " GB/s  "
+         << setprecision(2) << setw(8) << seconds << " s  " << items << " " << unit << endl;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        cerr << "Usage: " << argv[0] << " <reads.fastq> [genome.fna]" << endl;
+        return 1;
+    }
+    
+    string fastq = argv[1];
+    double fastq_bytes = filesystem::file_size(fastq);
+    cout << "FASTQ " << fastq << " (" << fixed << setprecision(1) << fastq_bytes / 1e6 << " MB)" << endl;
+    
+    bool compressed = bio::isGzipFile(fastq);
+    long long getline_reads = 0, getline_bases = 0;
+    if (!compressed) {
+        double t_getline = timeSeconds([&] {
+            ifstream in(fastq);
+            string id, seq, plus, qual;
+            while (getline(in, id) && getline(in, seq) && getline(in, plus) && getline(in, qual)) {
+                getline_reads++;
+                getline_bases += seq.size();
+            }
+        });
+        report("getline", fastq_bytes, t_getline, getline_reads, "reads");
+    }
+    
+    long long chunk_reads = 0, chunk_bases = 0;
+    double t_chunked = timeSeconds([&] {
+        bio::FastqReader reader(fastq, 4 << 20, thread::hardware_concurrency());
+        bio::FastqChunk chunk;
+        while (reader.next(chunk)) {
+            chunk_reads += chunk.records.size();
+            for (const bio::FastqRecord& r : chunk.records) chunk_bases += r.seq.size();
+        }
+    });
+    report("FastqReader", fastq_bytes, t_chunked, chunk_reads, "reads");
+    if (!compressed && chunk_bases != getline_bases) cout << "  (base counts differ: CRLF input?)" << endl;
+    
+    if (argc > 2) {
+        string fasta = argv[2];
+        double fasta_bytes = filesystem::file_size(fasta);
+        cout << "FASTA " << fasta << " (" << fixed << setprecision(1) << fasta_bytes / 1e6 << " MB)" << endl;
+        
+        string genome_getline;
+        double t_fa_getline = timeSeconds([&] {
+            ifstream in(fasta);
+            string line;
+            while (getline(in, line)) {
+                if (line.empty() || line[0] == '>') continue;
+                genome_getline += line;
+            }
+        });
+        report("getline", fasta_bytes, t_fa_getline, genome_getline.size(), "bases");
+        
+        string genome;
+        double t_fa_block = timeSeconds([&] { bio::readFasta(fasta, genome); });
+        report("readFasta", fasta_bytes, t_fa_block, genome.size(), "bases");
+    }
+    return 0;
+}
@@ -0,0 +1,143 @@
+// Microbenchmarks of the core library routines on simulated data
+//
+//   g++ -std=c++23 -O3 -pthread -o micro_bench bench/micro_bench.cpp -lz
+//   ./micro_bench [size_mbp ...]        (default: 5)
+//
+// Inputs come from bench/read_simulator.hpp with fixed seeds, so numbers are
+// comparable between runs and commits. Each line reports the best of three
+// runs; the checksum column must not change between commits.
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <iomanip>
+#include <functional>
+#include "../lib/suffix_array.hpp"
+#include "../lib/edit_distance.hpp"
+#include "../lib/bwt.hpp"
+#include "../lib/kmer.hpp"
+#include "read_simulator.hpp"
+
+using namespace std;
+
+template<typename F>
+double timeSeconds(F&& f) {
+    auto start = chrono::high_resolution_clock::now();
+    f();
+    auto end = chrono::high_resolution_clock::now();
+    return chrono::duration<double>(end - start).count();
+}
+
+// Best of three runs of f, which returns a checksum; prints items/s
+void run(const string& name, double mbp, long long items, const string& unit, const function<long long()>& f) {
+    double best = 1e300;
+    long long checksum = 0;
+    for (int i = 0; i < 3; i++) {
+        best = min(best, timeSeconds([&] { checksum = f(); }));
+    }
+    cout << setw(24) << left << name << right << setw(8) << fixed << setprecision(0) << mbp << " Mb"
+         << setprecision(3) << setw(10) << best << " s" << setprecision(2) << setw(12) << items / best / 1e6
+         << " M " << setw(8) << left << unit << right << setw(22) << checksum << endl;
+}
+
+int main(int argc, char* argv[]) {
+    vector<double> sizes_mbp = {5};
+    if (argc > 1) {
+        sizes_mbp.clear();
+        for (int i = 1; i < argc; i++) sizes_mbp.push_back(stod(argv[i]));
+    }
+    const int num_queries = 1'000'000;
+    const int num_pairs = 200'000;  // editDistance is ~100x slower per call than a lookup
+    
+    cout << setw(24) << left << "benchmark" << right << setw(11) << "size" << setw(12) << "time" << setw(15)
+         << "rate" << setw(31) << "checksum" << endl;
+    for (double mbp : sizes_mbp) {
+        string text = bench::randomGenome(mbp * 1e6, 0.05, 42);
+        long long n = text.size();
+        
+        vector<int> sa;
+        run("buildSuffixArray", mbp, n, "bases/s", [&] {
+            sa = bio::buildSuffixArray(text);
+            return (long long)sa[n / 2];
+        });
+        
+        // Reads simulated from the text (0.5% substitutions, 0.05% indels),
+        // turned to the forward strand; their first 20 bases serve as seeds
+        vector<bio::FastaContig> contigs = {{"sim", 0, text.size()}};
+        bench::ReadSimulator simulator(text, contigs, bench::SimOptions{.seed = 7});
+        vector<string> reads(num_queries);
+        vector<int> origins(num_queries);
+        bench::SimulatedRead read;
+        bench::ReadTruth truth;
+        for (int i = 0; i < num_queries; i++) {
+            simulator.next(read);
+            bench::parseTruth(read.name, truth);
+            reads[i] = read.seq;
+            if (truth.reverse) reads[i] = bio::reverseComplement(reads[i]);
+            origins[i] = truth.pos - 1;
+        }
+        run("suffixArrayLowerBound", mbp, num_queries, "seeds/s", [&] {
+            long long sum = 0;
+            for (const string& r : reads) sum += bio::suffixArrayLowerBound(text, sa, string_view(r).substr(0, 20));
+            return sum;
+        });
+        
+        // The mapper's lookup: packed text with a prefix table, one search per
+        // seed and the same seeds through the lockstep batch (equal checksums)
+        bio::PackedSequence packed(text);
+        vector<uint32_t> prefix_table = bio::buildPrefixTable(packed, bio::defaultPrefixK(n));
+        vector<string_view> seeds(num_queries);
+        for (int i = 0; i < num_queries; i++) seeds[i] = string_view(reads[i]).substr(0, 20);
+        run("suffixArrayRange", mbp, num_queries, "seeds/s", [&] {
+            long long sum = 0;
+            for (string_view seed : seeds) {
+                auto [lo, hi] = bio::suffixArrayRange(packed, sa, prefix_table, seed);
+                sum += lo + 3LL * hi;
+            }
+            return sum;
+        });
+        bio::SuffixArrayBatch batch;
+        vector<pair<int, int>> ranges(num_queries);
+        run("SuffixArrayBatch", mbp, num_queries, "seeds/s", [&] {
+            batch.ranges(packed, sa, prefix_table, seeds, ranges);
+            long long sum = 0;
+            for (auto [lo, hi] : ranges) sum += lo + 3LL * hi;
+            return sum;
+        });
+        
+        // Each read (forward strand) against the window at its true origin
+        auto editDistanceRun = [&](auto distance) {
+            return [&, distance] {
+                long long sum = 0;
+                for (int i = 0; i < num_pairs; i++) {
+                    sum += distance(reads[i], string_view(text).substr(origins[i], reads[i].size()));
+                }
+                return sum;
+            };
+        };
+        run("editDistance<3>", mbp, num_pairs, "pairs/s",
+            editDistanceRun([](string_view a, string_view b) { return bio::editDistance<3>(a, b); }));
+        run("editDistance<8>", mbp, num_pairs, "pairs/s",
+            editDistanceRun([](string_view a, string_view b) { return bio::editDistance<8>(a, b); }));
+        
+        run("computeBWT", mbp, n, "bases/s", [&] {
+            string bwt = bio::computeBWT(text);
+            return (long long)bwt[n / 2] + (long long)bwt.find('$');
+        });
+        run("bwtFromSuffixArray", mbp, n, "bases/s", [&] {
+            string bwt = bio::bwtFromSuffixArray(text, sa);
+            return (long long)bwt[n / 2] + (long long)bwt.find('$');
+        });
+        run("buildBWT", mbp, n, "bases/s", [&] {
+            string bwt = bio::buildBWT(text);
+            return (long long)bwt[n / 2] + (long long)bwt.find('$');
+        });
+        
+        run("countKmers k=21", mbp, n, "bases/s", [&] {
+            bio::KmerCountTable counts = bio::countKmers(text, 21);
+            return (long long)counts.size();
+        });
+    }
+    return 0;
+}
@@ -0,0 +1,256 @@
+#pragma once
+
+// Deterministic synthetic references and reads for the benchmarks
+//
+// Reads are sampled uniformly from the reference (records weighted by
+// length) and carry their origin in the name, so that mapping accuracy can be
+// scored from the mapper's SAM output:
+//
+//   sim<index>:<contig>:<1-based leftmost position>:<+|->:<edits>
+//
+// edits counts the substitutions and inserted/deleted bases applied, an upper
+// bound on the read's edit distance to its origin. Read pairs (nextPair) name
+// both mates after the pair, with both origins, mate 1's first:
+//
+//   sim<index>:<contig>:<pos 1>:<strand 1>:<edits 1>:<pos 2>:<strand 2>:<edits 2>/<1|2>
+//
+// Everything is driven by a seeded mt19937_64, so the same options give the
+// same reads on every run.
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <stdexcept>
+#include <cmath>
+#include "../lib/sequence.hpp"
+#include "../lib/fastx.hpp"
+
+namespace bench {
+
+// Random DNA with repeat_fraction of it overwritten by copies of other
+// stretches of repeat_len bases, to mimic repeats
+inline std::string randomGenome(long long n, double repeat_fraction, uint64_t seed, long long repeat_len = 1000) {
+    std::mt19937_64 rng(seed);
+    std::string s(n, 'A');
+    for (long long i = 0; i < n; i++) s[i] = "ACGT"[rng() & 3];
+    for (long long copied = 0; n > 2 * repeat_len && copied < n * repeat_fraction; copied += repeat_len) {
+        long long src = rng() % (n - repeat_len);
+        long long dst = rng() % (n - repeat_len);
+        s.replace(dst, repeat_len, s, src, repeat_len);
+    }
+    return s;
+}
+
+enum class SimStrand { Both, Forward, Reverse };
+
+struct SimOptions {
+    int read_length = 100;
+    double substitution_rate = 0.005;  // per base
+    double indel_rate = 0.0005;        // per base; single-base insertions and deletions, half each
+    double n_rate = 0;                 // per base, read bases replaced by N (quality '!')
+    SimStrand strand = SimStrand::Both;
+    int insert_mean = 300;             // read pairs: fragment length, normally distributed
+    double insert_sd = 30;
+    uint64_t seed = 1;
+};
+
+struct SimulatedRead {
+    std::string name, seq, qual;
+};
+
+// Where a simulated read came from, parsed back from its name
+struct ReadTruth {
+    std::string contig;
+    long long pos = 0;  // 1-based
+    bool reverse = false;
+    int edits = 0;
+};
+
+class ReadSimulator {
+public:
+    // sequence is the concatenation of the contigs (as from bio::readFasta)
+    ReadSimulator(const std::string& sequence, std::vector<bio::FastaContig> contigs, const SimOptions& options)
+        : sequence_(sequence), contigs_(std::move(contigs)), options_(options), rng_(options.seed) {
+        // Only contigs that can hold a read with some slack for deletions
+        long long total = 0;
+        for (size_t c = 0; c < contigs_.size(); c++) {
+            if (contigs_[c].length >= (size_t)options.read_length * 2) {
+                total += contigs_[c].length;
+                cumulative_.push_back({total, c});
+            }
+        }
+        if (cumulative_.empty()) throw std::runtime_error("no reference record is long enough for the read length");
+    }
+    
+    // Next read; sources that overlap a reference N are redrawn
+    void next(SimulatedRead& read) {
+        const int len = options_.read_length;
+        while (true) {
+            const bio::FastaContig& contig = pickContig();
+            // Room for up to len extra bases consumed by deletions
+            long long start = uniform(contig.length - 2 * len + 1);
+            int edits = 0;
+            if (!sample(contig, start, read, edits)) continue;
+            
+            bool reverse = pickReverse();
+            finish(read, reverse);
+            read.name = "sim" + std::to_string(count_++) + ":" + contig.name + ":" + std::to_string(start + 1) + ":" +
+                        (reverse ? "-" : "+") + ":" + std::to_string(edits);
+            return;
+        }
+    }
+    
+    // Next read pair: the two ends of a fragment facing each other (forward-
+    // reverse), mate 1 from the fragment's strand. Fragments shorter than a
+    // read are lengthened to one read.
+    void nextPair(SimulatedRead& mate1, SimulatedRead& mate2) {
+        const int len = options_.read_length;
+        while (true) {
+            const bio::FastaContig& contig = pickContig();
+            long long fragment = std::max<long long>(len, std::llround(options_.insert_mean + options_.insert_sd * normal()));
+            if (fragment + len > (long long)contig.length) continue;
+            long long left = uniform(contig.length - fragment - len + 1);
+            long long right = left + fragment - len;
+            int left_edits = 0, right_edits = 0;
+            if (!sample(contig, left, mate1, left_edits) || !sample(contig, right, mate2, right_edits)) continue;
+            
+            // mate1 now holds the left end and mate2 the right one, reverse complemented
+            bool reverse = pickReverse();
+            finish(mate1, false);
+            finish(mate2, true);
+            std::string origins = std::to_string(left + 1) + ":+:" + std::to_string(left_edits) + ":" +
+                                  std::to_string(right + 1) + ":-:" + std::to_string(right_edits);
+            if (reverse) {
+                std::swap(mate1, mate2);
+                origins = std::to_string(right + 1) + ":-:" + std::to_string(right_edits) + ":" +
+                          std::to_string(left + 1) + ":+:" + std::to_string(left_edits);
+            }
+            std::string name = "sim" + std::to_string(count_++) + ":" + contig.name + ":" + origins;
+            mate1.name = name + "/1";
+            mate2.name = name + "/2";
+            return;
+        }
+    }
+
+private:
+    const std::string& sequence_;
+    std::vector<bio::FastaContig> contigs_;
+    std::vector<std::pair<long long, size_t>> cumulative_;  // running length -> contig
+    SimOptions options_;
+    std::mt19937_64 rng_;
+    long long count_ = 0;
+    
+    long long uniform(long long n) { return rng_() % n; }
+    double unit() { return (rng_() >> 11) * 0x1.0p-53; }
+    
+    // Standard normal deviate (Box-Muller), the same on every platform
+    double normal() {
+        double u = 1 - unit();
+        return std::sqrt(-2 * std::log(u)) * std::cos(2 * 3.141592653589793 * unit());
+    }
+    
+    bool pickReverse() {
+        return options_.strand == SimStrand::Reverse || (options_.strand == SimStrand::Both && (rng_() & 1));
+    }
+    
+    // Read sequence copied from contig position start on, with substitutions
+    // and indels; false if its source overlaps a non-ACGT base
+    bool sample(const bio::FastaContig& contig, long long start, SimulatedRead& read, int& edits) {
+        const int len = options_.read_length;
+        std::string_view source = std::string_view(sequence_).substr(contig.offset + start, 2 * len);
+        read.seq.clear();
+        edits = 0;
+        size_t used = 0;
+        while ((int)read.seq.size() < len && used < source.size()) {
+            double r = unit();
+            if (r < options_.indel_rate / 2) {  // deletion: skip a reference base
+                used++;
+                edits++;
+                continue;
+            }
+            if (r < options_.indel_rate) {  // insertion: a random base
+                read.seq += "ACGT"[rng_() & 3];
+                edits++;
+                continue;
+            }
+            char base = source[used++] & ~0x20;  // uppercase (non-ACGT sources are rejected below)
+            if (unit() < options_.substitution_rate) {
+                base = "ACGT"[(baseIndex(base) + 1 + rng_() % 3) % 4];
+                edits++;
+            }
+            read.seq += base;
+        }
+        return source.substr(0, used).find_first_not_of("ACGTacgt") == std::string_view::npos;
+    }
+    
+    // Orient a sampled read and add qualities and Ns
+    void finish(SimulatedRead& read, bool reverse) {
+        const int len = options_.read_length;
+        if (reverse) read.seq = bio::reverseComplement(read.seq);
+        read.qual.assign(len, 'I');
+        if (options_.n_rate > 0) {
+            for (int i = 0; i < len; i++) {
+                if (unit() < options_.n_rate) {
+                    read.seq[i] = 'N';
+                    read.qual[i] = '!';
+                }
+            }
+        }
+    }
+    
+    const bio::FastaContig& pickContig() {
+        long long r = uniform(cumulative_.back().first);
+        auto it = std::upper_bound(cumulative_.begin(), cumulative_.end(), r,
+                                   [](long long v, const std::pair<long long, size_t>& e) { return v < e.first; });
+        return contigs_[it->second];
+    }
+    
+    static int baseIndex(char c) {
+        // Index in "ACGT", so that "ACGT"[(i + 1..3) % 4] is another base
+        switch (c) {
+            case 'C': return 1;
+            case 'G': return 2;
+            case 'T': return 3;
+        }
+        return 0;
+    }
+};
+
+// Parse "sim<i>:<contig>:<pos>:<strand>:<edits>"; contig names may hold ':'.
+// For a read pair's name, mate (1 or 2) selects the origin to parse; a name
+// still ending in /1 or /2 selects it by itself.
+inline bool parseTruth(std::string_view name, ReadTruth& truth, int mate = 0) {
+    size_t first = name.find(':');
+    if (first == std::string_view::npos) return false;
+    if (name.size() >= 2 && name[name.size() - 2] == '/' && (name.back() == '1' || name.back() == '2')) {
+        if (!mate) mate = name.back() - '0';
+        name.remove_suffix(2);
+    }
+    // Origins are three fields each, at the end of the name
+    std::string_view origin;
+    size_t end = name.size();
+    for (int o = mate ? 2 : 1; o > 0; o--) {
+        size_t cut = end;
+        for (int f = 0; f < 3; f++) {
+            cut = name.rfind(':', cut - 1);
+            if (cut == std::string_view::npos || cut <= first) return false;
+        }
+        if (o == (mate == 2 ? 2 : 1)) origin = name.substr(cut + 1, end - cut - 1);
+        end = cut;
+    }
+    truth.contig = std::string(name.substr(first + 1, end - first - 1));
+    size_t strand = origin.find(':'), edits = origin.rfind(':');
+    if (strand == 0) return false;
+    try {
+        truth.pos = std::stoll(std::string(origin.substr(0, strand)));
+        truth.edits = std::stoi(std::string(origin.substr(edits + 1)));
+    } catch (const std::exception&) {
+        return false;
+    }
+    truth.reverse = origin.substr(strand + 1, edits - strand - 1) == "-";
+    return true;
+}
+
+} // namespace bench
@@ -0,0 +1,67 @@
+#!/bin/sh
+# Reproducible benchmark suite: builds the mapper and the bench tools,
+# simulates fixed read sets, and reports end-to-end reads/s with mapping
+# accuracy for each, then the library microbenchmarks
+#
+#   bench/run_suite.sh [genome_mbp] [reads] [threads]    (default: 30 500000 1)
+#
+# Data sets (all from one simulated genome with 10% repeats, fixed seeds):
+#   clean     0.1% substitutions, no indels
+#   default   0.5% substitutions, 0.05% indels
+#   noisy     1.5% substitutions, 0.2% indels, 0.5% N
+# Each set is mapped with fixed, minimizer and MEM seeding; reads/s covers the
+# mapping phase only (the "Mapping throughput" line), not index construction.
+# Work files go to $BENCH_DIR (default: bench_out/) and are reused if present.
+
+set -e
+mbp=${1:-30}
+reads=${2:-500000}
+threads=${3:-1}
+dir=${BENCH_DIR:-bench_out}
+cxx=${CXX:-g++}
+flags="-std=c++23 -O3 -pthread"
+
+mkdir -p "$dir"
+echo "Building..."
+$cxx $flags -o "$dir/mapper" mapper.cpp -lz
+for tool in simulate_reads eval_sam micro_bench; do
+    $cxx $flags -o "$dir/$tool" "bench/$tool.cpp" -lz
+done
+
+genome="$dir/sim_${mbp}mb.fa"
+[ -f "$genome" ] || "$dir/simulate_reads" --random-genome "$mbp" --repeat-fraction 0.1 --genome-out "$genome" \
+    -n 1 -o /dev/null
+
+simulate() {
+    name=$1
+    shift
+    out="$dir/${name}_${mbp}mb_${reads}.fq"
+    [ -f "$out" ] || "$dir/simulate_reads" -g "$genome" -n "$reads" -o "$out" "$@"
+    echo "$out"
+}
+clean=$(simulate clean --sub 0.001 --indel 0 --seed 11)
+default=$(simulate default --sub 0.005 --indel 0.0005 --seed 12)
+noisy=$(simulate noisy --sub 0.015 --indel 0.002 --n-rate 0.005 --seed 13)
+
+echo
+echo "End to end: ${mbp} Mbp genome, $reads reads, $threads thread(s)"
+printf "%-8s %-10s %12s %10s %13s %11s %13s\n" "reads" "seeding" "reads/s" "mapped" "sensitivity" "precision" "prec. MAPQ60"
+for set in clean default noisy; do
+    eval fq=\$$set
+    for seeding in fixed minimizer smem; do
+        "$dir/mapper" -g "$genome" -r "$fq" -t "$threads" -x "$seeding" -o "$dir/out.sam" \
+            --stats-json "$dir/${set}_${seeding}.json" > "$dir/report.txt" 2> /dev/null
+        rate=$(sed -n 's/^Mapping throughput: \([0-9]*\) reads\/s$/\1/p' "$dir/report.txt")
+        mapped=$(sed -n 's/^  Mapped reads: [0-9]* (\(.*\))$/\1/p' "$dir/report.txt")
+        "$dir/eval_sam" "$dir/out.sam" > "$dir/eval.txt"
+        sens=$(awk '$1 == "0" { print $4 }' "$dir/eval.txt")
+        prec=$(awk '$1 == "0" { print $5 }' "$dir/eval.txt")
+        prec60=$(awk '$1 == "60" { print $5 }' "$dir/eval.txt")
+        printf "%-8s %-10s %12s %10s %13s %11s %13s\n" "$set" "$seeding" "$rate" "$mapped" "$sens" "$prec" "$prec60"
+    done
+done
+rm -f "$dir/out.sam"
+
+echo
+echo "Microbenchmarks"
+"$dir/micro_bench" 5
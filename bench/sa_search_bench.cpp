@@ -0,0 +1,115 @@
+// Suffix array lookup benchmark: lower/upper bound pair vs one-pass LCP-LR
+// search vs k-mer prefix tables of increasing k
+//
+//   g++ -std=c++23 -O3 -o sa_search_bench bench/sa_search_bench.cpp
+//   ./sa_search_bench [size_mbp ...]        (default: 5 100)
+//
+// Texts are random DNA from bench::randomGenome, without repeats. Queries are
+// 20-mer seeds and 100 bp reads taken from the text; a third of them get one
+// substitution so that some lookups miss. Lookups are run on the plain text
+// and on its 2-bit packed form.
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <iomanip>
+#include "../lib/suffix_array.hpp"
+#include "read_simulator.hpp"
+
+using namespace std;
+
+vector<string> sampleQueries(const string& text, int len, int count, unsigned seed) {
+    mt19937_64 rng(seed);
+    vector<string> queries;
+    for (int i = 0; i < count; i++) {
+        string q = text.substr(rng() % (text.size() - len), len);
+        if (i % 3 == 0) q[rng() % len] = "ACGT"[rng() & 3];
+        queries.push_back(q);
+    }
+    return queries;
+}
+
+template<typename F>
+double timeSeconds(F&& f) {
+    auto start = chrono::high_resolution_clock::now();
+    f();
+    auto end = chrono::high_resolution_clock::now();
+    return chrono::duration<double>(end - start).count();
+}
+
+int main(int argc, char* argv[]) {
+    vector<long long> sizes_mbp = {5, 100};
+    if (argc > 1) {
+        sizes_mbp.clear();
+        for (int i = 1; i < argc; i++) sizes_mbp.push_back(stoll(argv[i]));
+    }
+    const int num_queries = 1'000'000;
+    
+    const vector<int> prefix_ks = {8, 10, 12, 14};
+    
+    cout << setw(10) << "size" << setw(8) << "query" << setw(10) << "text" << setw(16) << "method"
+         << setw(14) << "memory (MB)" << setw(12) << "M lookups/s" << setw(10) << "speedup" << endl;
+    for (long long mbp : sizes_mbp) {
+        long long n = mbp * 1'000'000;
+        string text = bench::randomGenome(n, 0, 42);
+        vector<int> sa = bio::buildSuffixArray(text);
+        bio::LcpLrTables lcp_lr = bio::buildLcpLrTables(bio::buildLcpArray(text, sa));
+        bio::PackedSequence packed(text);
+        vector<vector<uint32_t>> prefix_tables;
+        for (int k : prefix_ks) prefix_tables.push_back(bio::buildPrefixTable(packed, k));
+        
+        for (int len : {20, 100}) {
+            vector<string> queries = sampleQueries(text, len, num_queries, 7);
+            vector<bio::PackedSequence> packed_queries;
+            for (const string& q : queries) packed_queries.emplace_back(q);
+            
+            for (int use_packed = 0; use_packed < 2; use_packed++) {
+                // Time one method; all must find the same intervals as the pair of searches
+                double t_pair = 0;
+                long long expected = 0;
+                auto run = [&](const string& method, double memory_mb, auto&& find) {
+                    long long sum = 0;
+                    double t = timeSeconds([&] {
+                        for (int i = 0; i < num_queries; i++) {
+                            auto [lo, hi] = find(i);
+                            sum += lo + (long long)hi * 3;
+                        }
+                    });
+                    if (method == "pair") {
+                        t_pair = t;
+                        expected = sum;
+                    }
+                    cout << setw(7) << mbp << " Mb" << setw(8) << len << setw(10) << (use_packed ? "packed" : "string")
+                         << setw(16) << method << fixed << setprecision(1) << setw(14) << memory_mb
+                         << setprecision(2) << setw(12) << num_queries / t / 1e6 << setw(9) << t_pair / t << "x"
+                         << (sum == expected ? "" : "  MISMATCH") << endl;
+                    return sum == expected;
+                };
+                
+                bool ok = run("pair", 0, [&](int i) {
+                    if (use_packed) {
+                        return pair<int, int>{bio::suffixArrayLowerBound(packed, sa, packed_queries[i]),
+                                              bio::suffixArrayUpperBound(packed, sa, packed_queries[i])};
+                    }
+                    return pair<int, int>{bio::suffixArrayLowerBound(text, sa, queries[i]),
+                                          bio::suffixArrayUpperBound(text, sa, queries[i])};
+                });
+                ok &= run("LCP-LR", 2.0 * n / 1048576, [&](int i) {
+                    return use_packed ? bio::suffixArrayRange(packed, sa, lcp_lr.left, lcp_lr.right, packed_queries[i])
+                                      : bio::suffixArrayRange(text, sa, lcp_lr.left, lcp_lr.right, queries[i]);
+                });
+                for (size_t t = 0; t < prefix_ks.size(); t++) {
+                    span<const uint32_t> table = prefix_tables[t];
+                    ok &= run("prefix k=" + to_string(prefix_ks[t]), table.size_bytes() / 1048576.0, [&](int i) {
+                        return use_packed ? bio::suffixArrayRange(packed, sa, table, packed_queries[i])
+                                          : bio::suffixArrayRange(text, sa, table, queries[i]);
+                    });
+                }
+                if (!ok) return 1;
+            }
+        }
+    }
+    return 0;
+}
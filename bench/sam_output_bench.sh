@@ -0,0 +1,44 @@
+#!/bin/sh
+# Mapping throughput with SAM output off, written to /dev/null and written to a
+# file, from the "Mapping throughput" line of the mapper's report
+#
+#   g++ -std=c++23 -O3 -pthread -o mapper mapper.cpp -lz
+#   bench/sam_output_bench.sh [genome.fa] [reads.fq] [threads] [runs]
+#
+# Each setting is run `runs` times (default 3) and the best is reported. The
+# index is built once up front so that only the mapping phase is compared.
+
+genome=${1:-data/GCF_000005845.2_ASM584v2_genomic.fna}
+reads=${2:-data/ERR022075_1.fastq}
+threads=${3:-1}
+runs=${4:-3}
+mapper=${MAPPER:-./mapper}
+tmp=${TMPDIR:-/tmp}/sam_output_bench.$$
+mkdir -p "$tmp" || exit 1
+trap 'rm -rf "$tmp"' EXIT
+
+"$mapper" index -g "$genome" -i "$tmp/ref.idx" > /dev/null 2>&1 || { echo "index build failed" >&2; exit 1; }
+
+best() {
+    b=0
+    i=0
+    while [ "$i" -lt "$runs" ]; do
+        r=$("$mapper" -i "$tmp/ref.idx" -r "$reads" -t "$threads" "$@" 2>/dev/null |
+            sed -n 's/^Mapping throughput: \([0-9]*\) reads\/s$/\1/p')
+        [ -n "$r" ] || { echo "mapper failed" >&2; exit 1; }
+        [ "$r" -gt "$b" ] && b=$r
+        i=$((i + 1))
+    done
+    echo "$b"
+}
+
+off=$(best) || exit 1
+null=$(best -o /dev/null) || exit 1
+file=$(best -o "$tmp/out.sam") || exit 1
+size=$(wc -c < "$tmp/out.sam")
+
+printf "%-16s %14s %10s\n" "output" "reads/s" "relative"
+printf "%-16s %14d %10s\n" "off" "$off" "1.00"
+printf "%-16s %14d %10s\n" "-o /dev/null" "$null" "$(awk "BEGIN { printf \"%.2f\", $null / $off }")"
+printf "%-16s %14d %10s\n" "-o file" "$file" "$(awk "BEGIN { printf \"%.2f\", $file / $off }")"
+echo "SAM size: $((size / 1048576)) MB"
@@ -0,0 +1,121 @@
+// Deterministic FASTQ read simulator with the true origin in each read name
+//
+//   g++ -std=c++23 -O3 -pthread -o simulate_reads bench/simulate_reads.cpp -lz
+//   ./simulate_reads -g genome.fa -n 1000000 -o reads.fq
+//   ./simulate_reads --random-genome 30 --repeat-fraction 0.1 --genome-out sim.fa -n 500000 -o reads.fq
+//   ./simulate_reads -g genome.fa -n 500000 -o reads_1.fq --pair-out reads_2.fq --insert 300 --insert-sd 30
+//
+// See bench/read_simulator.hpp for the read name format; bench/eval_sam.cpp
+// scores a mapper's SAM output against it.
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "read_simulator.hpp"
+
+using namespace std;
+
+int main(int argc, char* argv[]) {
+    string genome_file, genome_out, reads_out, pair_out;
+    double random_mbp = 0, repeat_fraction = 0.05;
+    long long num_reads = 100000;
+    bench::SimOptions options;
+    
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        auto value = [&]() -> string {
+            if (i + 1 >= argc) throw runtime_error(arg + " needs a value");
+            return argv[++i];
+        };
+        try {
+            if (arg == "-g") genome_file = value();
+            else if (arg == "--random-genome") random_mbp = stod(value());
+            else if (arg == "--repeat-fraction") repeat_fraction = stod(value());
+            else if (arg == "--genome-out") genome_out = value();
+            else if (arg == "-o") reads_out = value();
+            else if (arg == "--pair-out") pair_out = value();
+            else if (arg == "--insert") options.insert_mean = stoi(value());
+            else if (arg == "--insert-sd") options.insert_sd = stod(value());
+            else if (arg == "-n") num_reads = stoll(value());
+            else if (arg == "-l") options.read_length = stoi(value());
+            else if (arg == "--sub") options.substitution_rate = stod(value());
+            else if (arg == "--indel") options.indel_rate = stod(value());
+            else if (arg == "--n-rate") options.n_rate = stod(value());
+            else if (arg == "--seed") options.seed = stoull(value());
+            else if (arg == "--strand") {
+                string s = value();
+                if (s == "both") options.strand = bench::SimStrand::Both;
+                else if (s == "forward") options.strand = bench::SimStrand::Forward;
+                else if (s == "reverse") options.strand = bench::SimStrand::Reverse;
+                else throw runtime_error("--strand must be both, forward or reverse");
+            } else {
+                cerr << "Usage: " << argv[0] << " (-g <genome.fa> | --random-genome <Mbp>) -o <reads.fq> [options]\n"
+                     << "  --repeat-fraction <f>  Share of a random genome made of 1 kbp copies (default: 0.05)\n"
+                     << "  --genome-out <file>    Write the random genome as FASTA\n"
+                     << "  --pair-out <file>      Simulate read pairs: first mates to -o, second mates here\n"
+                     << "  --insert <len>         Fragment length of read pairs (default: 300)\n"
+                     << "  --insert-sd <sd>       Its standard deviation (default: 30)\n"
+                     << "  -n <num>               Reads or read pairs (default: 100000)\n"
+                     << "  -l <len>               Read length (default: 100)\n"
+                     << "  --sub <rate>           Substitutions per base (default: 0.005)\n"
+                     << "  --indel <rate>         Single-base indels per base (default: 0.0005)\n"
+                     << "  --n-rate <rate>        Read bases turned into N (default: 0)\n"
+                     << "  --strand <s>           both, forward or reverse (default: both)\n"
+                     << "  --seed <n>             Random seed (default: 1)\n";
+                return arg == "-h" ? 0 : 1;
+            }
+        } catch (const exception& e) {
+            cerr << "Error: " << e.what() << endl;
+            return 1;
+        }
+    }
+    if (reads_out.empty() || genome_file.empty() == (random_mbp <= 0)) {
+        cerr << "Error: need -o and exactly one of -g and --random-genome" << endl;
+        return 1;
+    }
+    
+    try {
+        string genome;
+        vector<bio::FastaContig> contigs;
+        if (random_mbp > 0) {
+            genome = bench::randomGenome(random_mbp * 1e6, repeat_fraction, options.seed);
+            contigs.push_back({"sim", 0, genome.size()});
+            if (!genome_out.empty()) {
+                ofstream out(genome_out);
+                out << ">sim random genome, repeat fraction " << repeat_fraction << "\n";
+                for (size_t i = 0; i < genome.size(); i += 80) out << string_view(genome).substr(i, 80) << "\n";
+                if (!out) throw runtime_error("Failed writing " + genome_out);
+            }
+        } else {
+            contigs = bio::readFasta(genome_file, genome);
+        }
+        
+        bench::ReadSimulator simulator(genome, contigs, options);
+        ofstream out(reads_out), mates_out;
+        if (!out) throw runtime_error("Cannot create " + reads_out);
+        if (!pair_out.empty()) {
+            mates_out.open(pair_out);
+            if (!mates_out) throw runtime_error("Cannot create " + pair_out);
+        }
+        auto write = [](ofstream& out, const bench::SimulatedRead& read) {
+            out << '@' << read.name << '\n' << read.seq << "\n+\n" << read.qual << '\n';
+        };
+        bench::SimulatedRead read, mate;
+        for (long long i = 0; i < num_reads; i++) {
+            if (pair_out.empty()) {
+                simulator.next(read);
+            } else {
+                simulator.nextPair(read, mate);
+                write(mates_out, mate);
+            }
+            write(out, read);
+        }
+        if (!out.flush()) throw runtime_error("Failed writing " + reads_out);
+        if (!pair_out.empty() && !mates_out.flush()) throw runtime_error("Failed writing " + pair_out);
+    } catch (const exception& e) {
+        cerr << "Error: " << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,64 @@
+// Suffix array construction benchmark: SA-IS vs prefix doubling
+//
+//   g++ -std=c++23 -O3 -o sa_bench bench/suffix_array_bench.cpp
+//   ./sa_bench [size_mbp ...]        (default: 5 100 1000)
+//
+// Texts are random DNA from bench::randomGenome, without repeats. Prefix
+// doubling is only run up to 100 Mbp.
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <iomanip>
+#include "../lib/suffix_array.hpp"
+#include "read_simulator.hpp"
+
+using namespace std;
+
+template<typename F>
+double timeSeconds(F&& f) {
+    auto start = chrono::high_resolution_clock::now();
+    f();
+    auto end = chrono::high_resolution_clock::now();
+    return chrono::duration<double>(end - start).count();
+}
+
+int main(int argc, char* argv[]) {
+    vector<long long> sizes_mbp = {5, 100, 1000};
+    if (argc > 1) {
+        sizes_mbp.clear();
+        for (int i = 1; i < argc; i++) sizes_mbp.push_back(stoll(argv[i]));
+    }
+    const long long max_doubling = 100'000'000;
+    
+    cout << setw(10) << "size" << setw(14) << "SA-IS (s)" << setw(14) << "doubling (s)" << setw(10) << "speedup" << endl;
+    for (long long mbp : sizes_mbp) {
+        long long n = mbp * 1'000'000;
+        string text = bench::randomGenome(n, 0, 42);
+        
+        double t_sais, t_doubling = -1;
+        bool match = true;
+        if (n < (1LL << 31)) {
+            vector<int> sa;
+            t_sais = timeSeconds([&] { sa = bio::buildSuffixArray(text); });
+            if (n <= max_doubling) {
+                vector<int> ref;
+                t_doubling = timeSeconds([&] { ref = bio::buildSuffixArrayDoubling(text); });
+                match = sa == ref;
+            }
+        } else {
+            t_sais = timeSeconds([&] { bio::buildSuffixArray64(text); });
+        }
+        
+        cout << setw(7) << mbp << " Mb" << fixed << setprecision(2) << setw(14) << t_sais;
+        if (t_doubling >= 0) {
+            cout << setw(14) << t_doubling << setw(9) << t_doubling / t_sais << "x";
+        } else {
+            cout << setw(14) << "-" << setw(10) << "-";
+        }
+        cout << (match ? "" : "  MISMATCH") << endl;
+        if (!match) return 1;
+    }
+    return 0;
+}
@@ -3,36 +3,133 @@
 // Genome Mapping Library
 // Algorithms for DNA sequence analysis
 
+#include "sequence.hpp"
+#include "packed_sequence.hpp"
 #include "suffix_array.hpp"
 #include "bwt.hpp"
 #include "kmer.hpp"
+#include "kmer_counter.hpp"
+#include "minimizer.hpp"
 #include "edit_distance.hpp"
+#include "index_file.hpp"
+#include "gzip.hpp"
+#include "fastx.hpp"
+#include "contig_table.hpp"
+#include "sam.hpp"
+#include "coverage.hpp"
+#include "result_cache.hpp"
+#include "profile.hpp"
 
 // Library namespace: bio
 //
 // Available functions:
 //
+// sequence.hpp:
+//   - complementBase(c)                : Watson-Crick complement, upper case (N for non-ACGT)
+//   - reverseComplement(s)             : reverse complement of a sequence
+//
+// packed_sequence.hpp:
+//   - PackedSequence(s)                : 2-bit bases + ambiguity bitmap; word-at-a-time
+//                                        compare, commonPrefix, extract/substr, reverseComplement
+//
 // suffix_array.hpp:
-//   - buildSuffixArray(s)              : O(n log² n) suffix array construction
+//   - buildSuffixArray(s)              : O(n) SA-IS suffix array construction
+//   - buildSuffixArray64(s)            : SA-IS with 64-bit indices (texts >= 2^31)
+//   - buildSuffixArrayDoubling(s)      : O(n log² n) prefix-doubling construction
 //   - suffixArrayLowerBound(s, sa, p)  : binary search lower bound
 //   - suffixArrayUpperBound(s, sa, p)  : binary search upper bound  
 //   - findAllOccurrences(s, sa, p)     : find all pattern occurrences
 //   - hasUniqueMatch(s, sa, p)         : check for unique match
 //   - getUniqueMatchPosition(s, sa, p) : get position of unique match
+//     (build, lower/upper bound and findAllOccurrences also take a PackedSequence text)
+//   - buildLcpArray(s, sa)             : O(n) Kasai LCP array
+//   - buildLcpLrTables(lcp)            : 2-byte/base LCP-LR tables for suffixArrayRange
+//   - suffixArrayRange(s, sa, l, r, p) : one-pass O(m + log n) [lo, hi) search
+//   - buildPrefixTable(s, k)           : 4^k-bucket k-mer -> suffix-array range table
+//   - defaultPrefixK(n)                : k of the prefix table for a text of n, <= MAX_PREFIX_K
+//   - suffixArrayRange(s, sa, table, p): [lo, hi) searched within the k-mer's bucket
+//   - SuffixArrayBatch::ranges(...)    : suffixArrayRange of many patterns in lockstep, prefetched
 //
 // bwt.hpp:
-//   - computeBWT(s)                    : Burrows-Wheeler Transform
+//   - computeBWT(s)                    : Burrows-Wheeler Transform (via buildSuffixArray)
+//   - bwtFromSuffixArray(s, sa)        : BWT from an existing suffix array, no copy
+//   - buildBWT(s, options)             : blockwise BWT in a memory budget, multithreaded,
+//                                        spilling to a temporary file (no suffix array)
+//   - writeBWT(s, path, options)       : buildBWT streamed to a file
 //   - inverseBWT(bwt)                  : inverse BWT
 //   - buildOccurrenceTable(bwt)        : FM-index occurrence table
 //   - buildCumulativeCounts(bwt)       : FM-index C array
+//   - FMIndex(text, sa)                : compact FM-index (backwardSearch, locate);
+//                                        text may be a PackedSequence
 //
 // kmer.hpp:
-//   - computeKmerHash(kmer)            : rolling hash for k-mer
-//   - countKmers(s, k)                 : count all k-mer frequencies
+//   - encodeKmer(kmer, code), decodeKmer(code, k) : exact 2-bit k-mer codes (k <= 32)
+//   - reverseComplementKmer(code, k)   : reverse complement of a k-mer code
+//   - canonicalKmer(code, k)           : strand-neutral code (min of both strands)
+//   - forEachKmer(s, k, canonical, f)  : rolling 2-bit k-mers, skipping non-ACGT
+//   - KmerCountTable                   : open-addressing k-mer -> count table
+//   - countKmers(s, k, canonical)      : count all k-mers into a KmerCountTable
 //   - findMostFrequentKmer(s, k)       : find most frequent k-mer
 //   - extractKmers(s, k)               : extract all k-mers as strings
+//     (each also takes a PackedSequence)
+//   - computeMinimizers(s, k, w, out)  : canonical (w,k)-minimizers (hash, position, strand)
+//
+// kmer_counter.hpp:
+//   - PartitionedKmerCounter(k, canonical) : multithreaded counter, one Writer per thread
+//
+// minimizer.hpp:
+//   - MinimizerIndex(s, k, w)          : minimizer hash -> reference positions (find)
 //
 // edit_distance.hpp:
 //   - editDistance<maxDist>(s, t)      : band-limited edit distance
 //   - editDistanceFull(s, t)           : standard edit distance
 //   - withinEditDistance<maxDist>(s, t, threshold) : check distance threshold
+//   - BitParallelPattern(p).distance(t, k) : Myers/Hyyrö bit-vector distance, capped at k+1
+//   - BitParallelPattern(p).distances(text, starts, len, k, out) : batch of windows,
+//                                        AVX2/SSE4.1 across candidates (runtime dispatch);
+//                                        text may be a PackedSequence
+//   - BitParallelPattern::assign(p)    : switch pattern, reusing the buffers
+//   - editDistanceBitParallel(s, t, k) : one-shot bit-parallel distance
+//   - alignBanded(p, t, k)             : banded alignment of p to a prefix of t with CIGAR
+//   - BandedAligner().align(p, t, k)   : the same, reusing its DP and CIGAR buffers
+//
+// index_file.hpp:
+//   - IndexWriter                      : write sections to a checksummed index file
+//   - MappedIndex                      : mmap an index file and view its sections
+//
+// gzip.hpp:
+//   - isGzipFile(path)                 : check for gzip magic bytes
+//   - GzipReader(path, threads)        : background gzip / parallel BGZF decompression
+//
+// fastx.hpp:
+//   - FastqReader(path).next(chunk)    : block-buffered FASTQ (plain or gzip), string_view records
+//   - PairedFastqReader(path1, path2)  : both mate files in lockstep, equal record counts per chunk
+//   - readFasta(path, sequence)        : multi-record FASTA into one sequence + contig table
+//
+// contig_table.hpp:
+//   - ContigTable::separate(seq, records) : records spaced GAP 'N' bases apart, with their table
+//   - ContigTable::find(pos), contains(pos, len) : binary-searched record of a position
+//
+// sam.hpp:
+//   - appendSamRecord(out, record)     : format one SAM line into a string buffer (with mate
+//                                        fields RNEXT, PNEXT, TLEN)
+//   - SamWriter(path, header)          : background writer of numbered text batches, in order
+//
+// coverage.hpp:
+//   - CoverageCounter(n)               : sharded 16-bit saturating per-base depth, one Writer
+//                                        per thread (difference-array flushes); histogram, runs
+//   - writeBedGraph(path, name, cov)   : stream nonzero depth runs as bedGraph
+//   - writeBedGraph(path, contigs, cov) : the same per record of a ContigTable
+//   - writeDepthHistogram(path, hist)  : depth, bases, fraction lines
+//
+// result_cache.hpp:
+//   - sequenceKey(s)                   : 128-bit hash of a sequence
+//   - ResultCache<V>(max_bytes)        : bounded concurrent cache by sequence key, CLOCK
+//                                        eviction in 8-way sets (prefetch, find, insert)
+//
+// profile.hpp:
+//   - PROFILE_ENABLED                  : false when built with -DBIO_PROFILE=0
+//   - profileTicks(), profileTicksPerSecond() : cheap CPU tick clock and its rate
+//   - LogHistogram                     : log-linear mergeable histogram with quantiles
+//   - BIO_COUNT_ALLOCATIONS(), thread_allocations : per-thread heap allocation counter
+//                                        (with -DBIO_PROFILE_ALLOCATIONS=1)
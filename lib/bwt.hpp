@@ -2,45 +2,64 @@
 
 #include <vector>
 #include <string>
+#include <string_view>
+#include <span>
+#include <utility>
+#include <cstdint>
+#include <bit>
 #include <algorithm>
+#include <numeric>
+#include <type_traits>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <unistd.h>
+#include "suffix_array.hpp"
 
 namespace bio {
 
-// Compute Burrows-Wheeler Transform of a string
-// Appends '$' as sentinel and returns BWT
-inline std::string computeBWT(const std::string& input) {
-    std::string s = input + '$';
-    int n = s.size();
-    
-    std::vector<int> sa(n), rk(n), tmp(n), cnt(std::max(256, n));
-    
-    for (int i = 0; i < n; i++) rk[i] = (unsigned char)s[i];
-    
-    for (int k = 1; k < n; k *= 2) {
-        std::fill(cnt.begin(), cnt.end(), 0);
-        for (int i = 0; i < n; i++) cnt[(i + k < n) ? rk[i + k] + 1 : 0]++;
-        for (int i = 1; i < (int)cnt.size(); i++) cnt[i] += cnt[i - 1];
-        for (int i = n - 1; i >= 0; i--) tmp[--cnt[(i + k < n) ? rk[i + k] + 1 : 0]] = i;
-        
-        std::fill(cnt.begin(), cnt.end(), 0);
-        for (int i = 0; i < n; i++) cnt[rk[i] + 1]++;
-        for (int i = 1; i < (int)cnt.size(); i++) cnt[i] += cnt[i - 1];
-        for (int i = 0; i < n; i++) sa[cnt[rk[tmp[i]]]++] = tmp[i];
-        
-        tmp[sa[0]] = 0;
-        for (int i = 1; i < n; i++) {
-            int a = sa[i - 1], b = sa[i];
-            bool eq = rk[a] == rk[b] && ((a + k < n ? rk[a + k] : -1) == (b + k < n ? rk[b + k] : -1));
-            tmp[sa[i]] = tmp[sa[i - 1]] + !eq;
+namespace detail {
+    template<typename Text, typename Index>
+    std::string bwtFromSuffixArray(const Text& text, std::span<const Index> sa) {
+        size_t n = text.size();
+        std::string bwt(n + 1, '$');
+        if (n > 0) bwt[0] = text[n - 1];  // the '$' suffix sorts first
+        for (size_t i = 0; i < n; i++) {
+            // Reads the text in suffix order; prefetch ahead of the misses
+            if (i + 32 < n && sa[i + 32] > 0) {
+                if constexpr (std::is_same_v<Text, PackedSequence>) text.prefetch(sa[i + 32] - 1);
+                else __builtin_prefetch(&text[sa[i + 32] - 1]);
+            }
+            if (sa[i] > 0) bwt[i + 1] = text[sa[i] - 1];
         }
-        rk = tmp;
-        if (rk[sa[n - 1]] == n - 1) break;
+        return bwt;
     }
-    
-    std::string bwt(n, ' ');
-    for (int i = 0; i < n; i++) bwt[i] = s[(sa[i] + n - 1) % n];
-    
-    return bwt;
+}
+
+// BWT of text + '$' from the suffix array of text, writing nothing but the
+// n + 1 output characters (the '$' row first, as computeBWT returns it). The
+// characters of text must sort after '$', like DNA.
+inline std::string bwtFromSuffixArray(std::string_view text, std::span<const int> sa) {
+    return detail::bwtFromSuffixArray(text, sa);
+}
+
+inline std::string bwtFromSuffixArray(std::string_view text, std::span<const long long> sa) {
+    return detail::bwtFromSuffixArray(text, sa);
+}
+
+inline std::string bwtFromSuffixArray(const PackedSequence& text, std::span<const int> sa) {
+    return detail::bwtFromSuffixArray(text, sa);
+}
+
+// Burrows-Wheeler Transform of input + '$', through buildSuffixArray (SA-IS).
+// The characters of input must sort after '$', like DNA. For texts that do
+// not fit its suffix array in memory, see buildBWT.
+inline std::string computeBWT(const std::string& input) {
+    return bwtFromSuffixArray(input, buildSuffixArray(input));
 }
 
 namespace detail {
@@ -121,4 +140,809 @@ inline std::vector<int> buildCumulativeCounts(const std::string& bwt) {
     return C;
 }
 
+// Compact FM-index over the DNA alphabet
+//
+// The BWT of text+'$' is stored 2 bits per base in blocks of 128 rows, each
+// block interleaving the occurrence counts at its start with its two bit
+// planes, so occ() is one block fetch plus popcounts. Every SA value that is a
+// multiple of the sample rate is kept for locate(). With the default rate of 32
+// the index takes ~0.7 bytes per base.
+//
+// Rows are numbered like the suffix array of the text itself (the '$' row is
+// hidden), so backwardSearch() returns the same [lo, hi) as
+// suffixArrayLowerBound/UpperBound. Non-ACGT characters in the text (e.g. N
+// between contigs) keep their place in that order: C_ counts every character
+// below each base, their BWT rows are stored as 'A' but listed apart and left
+// out of occ(), and they are sampled so locate() never steps through them.
+// Patterns containing them never match. Texts must be shorter than 2^31.
+class FMIndex {
+public:
+    FMIndex() = default;
+    
+    explicit FMIndex(std::string_view text, int sa_sample_rate = 32)
+        : FMIndex(text, buildSuffixArray(std::string(text)), sa_sample_rate) {}
+    
+    // Build from the text and its suffix array (no BWT string is materialized)
+    FMIndex(std::string_view text, std::span<const int> sa, int sa_sample_rate = 32)
+        : n_(text.size()), sample_rate_(sa_sample_rate) {
+        build(text, sa);
+    }
+    
+    FMIndex(const PackedSequence& text, std::span<const int> sa, int sa_sample_rate = 32)
+        : n_(text.size()), sample_rate_(sa_sample_rate) {
+        build(text, sa);
+    }
+    
+    // Number of occurrences of base code c (0..3 = ACGT) in bwt[0, i)
+    uint64_t occ(int c, uint64_t i) const {
+        const Block& b = blocks_[i / BLOCK];
+        uint64_t count = b.counts[c];
+        int off = i % BLOCK;
+        for (int w = 0; w < 2 && off > 0; w++, off -= 64) {
+            uint64_t match = (c & 1 ? b.lo[w] : ~b.lo[w]) & (c & 2 ? b.hi[w] : ~b.hi[w]);
+            if (off < 64) match &= (1ULL << off) - 1;
+            count += std::popcount(match);
+        }
+        // '$' and non-ACGT rows are stored as 'A' in the bit planes (block
+        // counts already exclude them)
+        if (c == 0 && dollar_row_ < i && dollar_row_ >= i - i % BLOCK) count--;
+        if (c == 0 && !other_first_.empty()) {
+            auto first = other_rows_.begin() + other_first_[i / BLOCK];
+            count -= std::lower_bound(first, other_rows_.end(), i) - first;
+        }
+        return count;
+    }
+    
+    // Suffix-array interval [lo, hi) of suffixes starting with pattern
+    std::pair<int, int> backwardSearch(std::string_view pattern) const {
+        uint64_t lo = 0, hi = n_ + 1;
+        for (size_t k = pattern.size(); k-- > 0 && lo < hi; ) {
+            int c = code(pattern[k]);
+            if (c < 0) return {0, 0};
+            lo = C_[c] + occ(c, lo);
+            hi = C_[c] + occ(c, hi);
+        }
+        if (lo >= hi) return {0, 0};
+        // Drop the hidden '$' row
+        if (lo == 0) lo = 1;
+        return {(int)(lo - 1), (int)(hi - 1)};
+    }
+    
+    // Text position of the suffix at suffix-array row `row`
+    int locate(int row) const {
+        uint64_t r = row + 1;
+        int steps = 0;
+        while (!(sampled_[r / 64] >> (r % 64) & 1)) {
+            r = lf(r);
+            steps++;
+        }
+        return samples_[sampled_rank_[r / 64] + std::popcount(sampled_[r / 64] & ((1ULL << (r % 64)) - 1))] + steps;
+    }
+    
+    size_t size() const { return n_; }
+    
+    size_t memoryBytes() const {
+        return blocks_.size() * sizeof(Block) + sampled_.size() * sizeof(uint64_t)
+             + sampled_rank_.size() * sizeof(uint32_t) + samples_.size() * sizeof(uint32_t)
+             + other_rows_.size() * sizeof(uint32_t) + other_first_.size() * sizeof(uint32_t);
+    }
+    
+private:
+    static constexpr uint64_t BLOCK = 128;
+    
+    struct Block {
+        uint32_t counts[4];  // occurrences of A, C, G, T before this block
+        uint64_t lo[2];      // low bit of each row's base code
+        uint64_t hi[2];      // high bit of each row's base code
+    };
+    
+    uint64_t n_ = 0;
+    uint64_t dollar_row_ = 0;
+    uint64_t C_[4] = {0, 0, 0, 0};         // first row of the suffixes starting with each base
+    int sample_rate_ = 32;
+    std::vector<Block> blocks_;
+    std::vector<uint64_t> sampled_;        // rows whose SA value is sampled
+    std::vector<uint32_t> sampled_rank_;   // sampled rows before each word of sampled_
+    std::vector<uint32_t> samples_;        // SA values of sampled rows, in row order
+    std::vector<uint32_t> other_rows_;     // rows whose BWT character is not ACGT (or '$')
+    std::vector<uint32_t> other_first_;    // first of other_rows_ in each block; empty if none
+    
+    static int code(char ch) {
+        switch (ch) {
+            case 'A': return 0;
+            case 'C': return 1;
+            case 'G': return 2;
+            case 'T': return 3;
+        }
+        return -1;
+    }
+    
+    // Text is a std::string_view or PackedSequence (non-ACGT bases read as 'N')
+    template<typename Text>
+    void build(const Text& text, std::span<const int> sa) {
+        uint64_t rows = n_ + 1;
+        blocks_.assign(rows / BLOCK + 1, Block{});
+        sampled_.assign(rows / 64 + 1, 0);
+        sampled_rank_.assign(rows / 64 + 1, 0);
+        
+        uint32_t counts[4] = {0, 0, 0, 0};
+        uint64_t below[256] = {};  // text characters, to place each base's rows
+        for (uint64_t row = 0; row < rows; row++) {
+            if (row % BLOCK == 0) std::copy(counts, counts + 4, blocks_[row / BLOCK].counts);
+            
+            // Row 0 is the '$' suffix; row r > 0 is text suffix sa[r - 1]
+            uint64_t pos = row == 0 ? n_ : sa[row - 1];
+            bool other = false;
+            if (pos == 0) {
+                dollar_row_ = row;
+            } else if (int c = code(text[pos - 1]); c < 0) {
+                other = true;
+                other_rows_.push_back(row);
+                below[(unsigned char)text[pos - 1]]++;
+            } else {
+                below[(unsigned char)text[pos - 1]]++;
+                Block& b = blocks_[row / BLOCK];
+                uint64_t bit = 1ULL << (row % 64);
+                int w = (row % BLOCK) / 64;
+                if (c & 1) b.lo[w] |= bit;
+                if (c & 2) b.hi[w] |= bit;
+                counts[c]++;
+            }
+            
+            if (pos % sample_rate_ == 0 || other) {
+                sampled_[row / 64] |= 1ULL << (row % 64);
+                samples_.push_back(pos);
+            }
+        }
+        if (rows % BLOCK == 0) std::copy(counts, counts + 4, blocks_[rows / BLOCK].counts);
+        
+        for (size_t w = 1; w < sampled_.size(); w++) {
+            sampled_rank_[w] = sampled_rank_[w - 1] + std::popcount(sampled_[w - 1]);
+        }
+        
+        if (!other_rows_.empty()) {
+            other_first_.resize(blocks_.size());
+            for (size_t k = 0, b = 0; b < blocks_.size(); b++) {
+                while (k < other_rows_.size() && other_rows_[k] < b * BLOCK) k++;
+                other_first_[b] = k;
+            }
+        }
+        // The '$' row sorts first, then the suffixes by first character
+        for (int c = 0; c < 4; c++) {
+            C_[c] = 1;
+            for (int ch = 0; ch < (unsigned char)"ACGT"[c]; ch++) C_[c] += below[ch];
+        }
+    }
+    
+    // LF mapping: row of the suffix one position to the left (row must not be
+    // the '$' row or a non-ACGT one, which are all sampled)
+    uint64_t lf(uint64_t row) const {
+        const Block& b = blocks_[row / BLOCK];
+        int w = (row % BLOCK) / 64;
+        int c = (b.lo[w] >> (row % 64) & 1) | (b.hi[w] >> (row % 64) & 1) << 1;
+        return C_[c] + occ(c, row);
+    }
+};
+
+// Options of buildBWT and writeBWT
+struct BwtBuildOptions {
+    int threads = 1;
+    size_t memory_bytes = size_t(1) << 30;  // working memory, on top of the packed text
+    std::string temp_dir;                   // where blocks spill; empty: the system's temporary directory
+};
+
+namespace detail {
+    // Blockwise suffix sorting for buildBWT (after Kärkkäinen 2007, "Fast BWT
+    // in small space by blockwise suffix sorting")
+    //
+    // Suffixes are bucketed by their first K bases over the alphabet end of
+    // text < A < C < G < N < T, and consecutive buckets are grouped into
+    // blocks of at most blockBytes() / BYTES_PER_SUFFIX suffixes. A block is
+    // gathered, sorted bucket by bucket on all threads, and its BWT characters
+    // emitted before the next one is gathered. With more than one block, the
+    // positions are first spilled to one temporary file in one pass over the
+    // text, each block to its own region, and read back block by block.
+    //
+    // Within a bucket, suffixes are sorted by multikey quicksort on 32-base
+    // keys (2-bit codes plus ambiguity bits), comparing up to v bases. Those
+    // still tied are ordered by the ranks of a difference-cover sample: for
+    // any two suffixes, some offset d < v puts both i + d and j + d in the
+    // sample, whose ranks are computed up front (the sample sorted the same
+    // way by its first v + 1 bases, and positions still tied then ordered by
+    // prefix doubling). So a suffix in a long repeat or N run costs up to v
+    // bases to sort, however long the repeat. v is the smallest power of two
+    // from 256 to 4096 whose sample ranks fit a quarter of memory_bytes.
+    class BlockwiseBwt {
+    public:
+        static constexpr int K = 8;
+        static constexpr uint32_t BUCKETS = 1679616;     // 6^K
+        static constexpr size_t BYTES_PER_SUFFIX = 24;   // position, sort key (the key's storage is also scratch)
+        static constexpr size_t SPILL_BUFFER = 1 << 16;  // most bytes staged per thread and block
+        static constexpr uint64_t MIN_COVER = 256;       // smallest v: a larger sample costs more than it saves
+        static constexpr uint64_t MAX_COVER = 4096;      // largest v: each tied suffix is compared this far first
+        static constexpr size_t INSERTION_SORT = 16;     // keys sorted by insertion, not partitioned
+        
+        BlockwiseBwt(const PackedSequence& text, const BwtBuildOptions& options)
+            : text_(text), n_(text.size()), threads_(std::max(1, options.threads)),
+              memory_bytes_(options.memory_bytes), temp_dir_(options.temp_dir) {
+            kmer_buckets_.resize(1 << (2 * K));
+            for (uint32_t x = 0; x < kmer_buckets_.size(); x++) {
+                SortKey key{(uint64_t)x << (64 - 2 * K), 0, K};
+                for (int i = 0; i < K; i++) kmer_buckets_[x] = 6 * kmer_buckets_[x] + symbol(key, i);
+            }
+        }
+        
+        // Calls emit(std::string_view) with the BWT of text + '$', in order
+        template<typename Emit>
+        void run(Emit&& emit) {
+            char last = n_ ? text_[n_ - 1] : '$';  // the '$' row
+            emit(std::string_view(&last, 1));
+            if (n_ == 0) return;
+            rankSample();
+            
+            auto bySample = [&](uint64_t* p, size_t count) {
+                std::sort(p, p + count, [&](uint64_t a, uint64_t b) {
+                    uint64_t d = sampleOffset(a, b);
+                    return sampleRank(a + d) < sampleRank(b + d);
+                });
+            };
+            auto eachSuffix = [&](int t, auto&& f) {
+                for (uint64_t p = chunkBegin(t); p < chunkBegin(t + 1); p++) f(p);
+            };
+            sortBlocks(eachSuffix, v_, bySample, [&](std::span<const uint64_t> pos, std::span<SortKey> keys) {
+                // The keys are done with: their storage holds the block's BWT
+                char* chars = reinterpret_cast<char*>(keys.data());
+                parallel([&](int t) {
+                    size_t from = pos.size() * t / threads_, to = pos.size() * (t + 1) / threads_;
+                    for (size_t i = from; i < to; i++) {
+                        if (i + 32 < to && pos[i + 32] > 0) text_.prefetch(pos[i + 32] - 1);
+                        chars[i] = pos[i] > 0 ? text_[pos[i] - 1] : '$';
+                    }
+                });
+                emit(std::string_view(chars, pos.size()));
+            });
+        }
+    
+    private:
+        // Up to 32 bases of a suffix, as compared by multikey quicksort
+        struct SortKey {
+            uint64_t bases;      // 2-bit codes, first base in the top bits
+            uint32_t ambiguous;  // bit i: base i is ambiguous (stored as A)
+            uint32_t len;        // bases in the key, fewer at the end of the text
+        };
+        
+        // Positions of every block in one temporary file, block k from byte offset[k]
+        struct Spill {
+            std::unique_ptr<std::FILE, int (*)(std::FILE*)> file{nullptr, std::fclose};
+            std::vector<uint64_t> offset;  // then the file size
+        };
+        
+        const PackedSequence& text_;
+        uint64_t n_;
+        int threads_;
+        size_t memory_bytes_;
+        std::string temp_dir_;
+        std::vector<uint32_t> kmer_buckets_;  // bucket of each ACGT K-mer
+        
+        // Difference cover of the residues mod v_ and the sample's ranks
+        uint64_t v_ = 0;
+        int v_shift_ = 0;
+        std::vector<uint64_t> cover_pair_;   // per difference (j - i) mod v: a in the cover with a + (j - i) too
+        std::vector<bool> in_cover_;
+        std::vector<uint64_t> sample_base_;  // per residue in the cover: index of its first sample position, then the sample size
+        std::vector<uint32_t> ranks_;        // rank of each sample position, by index
+        bool ranked_ = false;                // ranks_ is complete: ties can be broken by it
+        
+        uint64_t chunkBegin(int t) const { return n_ * t / threads_; }
+        
+        template<typename F>
+        void parallel(F&& f) const {
+            std::vector<std::thread> workers;
+            for (int t = 1; t < threads_; t++) workers.emplace_back(f, t);
+            f(0);
+            for (std::thread& w : workers) w.join();
+        }
+        
+        // Ambiguity bits of bases [pos, pos + 32), base pos in bit 0
+        uint32_t ambiguousBits(uint64_t pos) const {
+            std::span<const uint64_t> bits = text_.ambiguityBits();
+            uint64_t w = pos / 64, off = pos % 64;
+            if (w >= bits.size()) return 0;
+            uint64_t x = bits[w] >> off;
+            if (off > 32 && w + 1 < bits.size()) x |= bits[w + 1] << (64 - off);
+            return (uint32_t)x;
+        }
+        
+        SortKey keyAt(uint64_t pos, uint32_t width) const {
+            uint32_t len = std::min<uint64_t>(width, n_ - std::min(pos, n_));
+            if (len == 0) return {0, 0, 0};
+            uint32_t ambiguous = ambiguousBits(pos);
+            if (len < 32) ambiguous &= (1u << len) - 1;
+            return {text_.word(pos) & ~0ULL << (64 - 2 * len), ambiguous, len};
+        }
+        
+        // Rank of base i of a key in A < C < G < N < T, from 1
+        static int symbol(const SortKey& key, int i) {
+            if (key.ambiguous >> i & 1) return 4;
+            int code = key.bases >> (62 - 2 * i) & 3;
+            return code == 3 ? 5 : code + 1;
+        }
+        
+        static int compareKeys(const SortKey& a, const SortKey& b) {
+            if (a.len == b.len && !(a.ambiguous | b.ambiguous)) return a.bases < b.bases ? -1 : a.bases > b.bases;
+            uint64_t diff = a.bases ^ b.bases;
+            uint32_t i = std::min<uint32_t>(diff ? std::countl_zero(diff) / 2 : 32, std::countr_zero(a.ambiguous ^ b.ambiguous));
+            if (i >= std::min(a.len, b.len)) return a.len < b.len ? -1 : a.len > b.len;
+            return symbol(a, i) < symbol(b, i) ? -1 : 1;
+        }
+        
+        // Bucket of the suffix at pos: its first K bases in base 6, 0 past the end
+        uint32_t bucket(uint64_t pos) const {
+            if (pos + K <= n_ && !(ambiguousBits(pos) & ((1u << K) - 1))) {
+                return kmer_buckets_[text_.word(pos) >> (64 - 2 * K)];
+            }
+            SortKey key = keyAt(pos, K);
+            uint32_t b = 0;
+            for (int i = 0; i < K; i++) b = 6 * b + (i < (int)key.len ? symbol(key, i) : 0);
+            return b;
+        }
+        
+        // Sorts the suffixes at pos[0, n), whose first `depth` bases are
+        // equal, by their first `cap` bases; calls tie(pos, count) on each run
+        // sharing all of them
+        template<typename Tie>
+        void sortSuffixes(uint64_t* pos, SortKey* keys, size_t n, uint64_t depth, uint64_t cap, Tie& tie) const {
+            if (n < 2) return;
+            if (depth >= cap) {
+                tie(pos, n);
+                return;
+            }
+            if (n == 2) {
+                // A pair (as in a repeat with two copies) is compared directly:
+                // a level of recursion per key costs more than the key. Once
+                // the sample is ranked, only up to the pair's sample offset d
+                // (through base d, so that both suffixes reach the sample).
+                uint64_t d = ranked_ ? sampleOffset(pos[0], pos[1]) : cap;
+                uint64_t stop = std::min(cap, std::max(depth, d + 1));
+                int order = 0;
+                for (uint64_t at = depth; at < stop && order == 0; at += 32) {
+                    uint32_t width = std::min<uint64_t>(32, stop - at);
+                    SortKey a = keyAt(pos[0] + at, width), b = keyAt(pos[1] + at, width);
+                    order = compareKeys(a, b);
+                    if (a.len < width) break;  // the text ends
+                }
+                if (order == 0 && ranked_) order = sampleRank(pos[0] + d) < sampleRank(pos[1] + d) ? -1 : 1;
+                if (order > 0) std::swap(pos[0], pos[1]);
+                if (order == 0) tie(pos, n);
+                return;
+            }
+            uint32_t width = std::min<uint64_t>(32, cap - depth);
+            for (size_t i = 0; i < n; i++) {
+                if (i + 8 < n) text_.prefetch(pos[i + 8] + depth);
+                keys[i] = keyAt(pos[i] + depth, width);
+            }
+            sortByKeys(pos, keys, n, depth, width, cap, tie);
+        }
+        
+        // Ternary quicksort of pos[0, n) by keys (insertion sort below
+        // INSERTION_SORT), recursing into runs of equal keys with the next ones
+        template<typename Tie>
+        void sortByKeys(uint64_t* pos, SortKey* keys, size_t n, uint64_t depth, uint32_t width, uint64_t cap,
+                        Tie& tie) const {
+            while (n > INSERTION_SORT) {
+                const SortKey &a = keys[0], &b = keys[n / 2], &c = keys[n - 1];
+                SortKey pivot = compareKeys(a, b) < 0
+                    ? (compareKeys(b, c) < 0 ? b : compareKeys(a, c) < 0 ? c : a)
+                    : (compareKeys(a, c) < 0 ? a : compareKeys(b, c) < 0 ? c : b);
+                size_t lt = 0, i = 0, gt = n;
+                while (i < gt) {
+                    int order = compareKeys(keys[i], pivot);
+                    if (order < 0) {
+                        std::swap(pos[lt], pos[i]);
+                        std::swap(keys[lt++], keys[i++]);
+                    } else if (order > 0) {
+                        gt--;
+                        std::swap(pos[gt], pos[i]);
+                        std::swap(keys[gt], keys[i]);
+                    } else {
+                        i++;
+                    }
+                }
+                // Keys shorter than width end the text: equal ones are one suffix
+                if (pivot.len == width) sortSuffixes(pos + lt, keys + lt, gt - lt, depth + width, cap, tie);
+                if (lt < n - gt) {
+                    sortByKeys(pos, keys, lt, depth, width, cap, tie);
+                    pos += gt;
+                    keys += gt;
+                    n -= gt;
+                } else {
+                    sortByKeys(pos + gt, keys + gt, n - gt, depth, width, cap, tie);
+                    n = lt;
+                }
+            }
+            for (size_t i = 1; i < n; i++) {
+                for (size_t j = i; j > 0 && compareKeys(keys[j], keys[j - 1]) < 0; j--) {
+                    std::swap(pos[j], pos[j - 1]);
+                    std::swap(keys[j], keys[j - 1]);
+                }
+            }
+            for (size_t i = 0, j; i < n; i = j) {
+                for (j = i + 1; j < n && compareKeys(keys[i], keys[j]) == 0; j++) {}
+                if (keys[i].len == width) sortSuffixes(pos + i, keys + i, j - i, depth + width, cap, tie);
+            }
+        }
+        
+        // Sorts each bucket of pos (bucket b at [first[b], first[b + 1])) on all threads
+        template<typename Tie>
+        void sortBuckets(uint64_t* pos, SortKey* keys, std::span<const uint64_t> first, uint64_t cap, Tie& tie) const {
+            std::atomic<size_t> next = 0;
+            parallel([&](int) {
+                for (size_t b; (b = next++) + 1 < first.size();) {
+                    sortSuffixes(pos + first[b], keys + first[b], first[b + 1] - first[b], K, cap, tie);
+                }
+            });
+        }
+        
+        // Memory for a block: memory_bytes less the sample ranks (at most a quarter of it)
+        size_t blockBytes() const {
+            return memory_bytes_ - std::min<size_t>(ranks_.size() * sizeof(uint32_t), memory_bytes_ / 4);
+        }
+        
+        // Sorts the suffixes at the positions each(t, f) passes to f (those in
+        // chunk t of the text) by their first cap bases, then by tie(pos,
+        // count) on runs sharing all of them. Calls done(pos, keys) on each
+        // block in order; the keys are scratch memory of the block's size.
+        template<typename Each, typename Tie, typename Done>
+        void sortBlocks(Each&& each, uint64_t cap, Tie& tie, Done&& done) {
+            // Bucket sizes, per chunk of the text (a chunk per thread)
+            std::vector<std::vector<uint64_t>> counts(threads_);
+            parallel([&](int t) {
+                counts[t].assign(BUCKETS, 0);
+                each(t, [&](uint64_t p) { counts[t][bucket(p)]++; });
+            });
+            std::vector<uint64_t> sizes(BUCKETS, 0);
+            for (const auto& c : counts) {
+                for (uint32_t b = 0; b < BUCKETS; b++) sizes[b] += c[b];
+            }
+            std::vector<uint32_t> block_first(1, 0);  // first bucket of each block, then BUCKETS
+            size_t max_block = std::max<size_t>(1, blockBytes() / BYTES_PER_SUFFIX), size = 0;
+            for (uint32_t b = 0; b < BUCKETS; b++) {
+                if (size > 0 && size + sizes[b] > max_block) {
+                    block_first.push_back(b);
+                    size = 0;
+                }
+                size += sizes[b];
+            }
+            block_first.push_back(BUCKETS);
+            size_t blocks = block_first.size() - 1;
+            
+            // Sized for the largest block up front: growing would double them
+            size_t largest = 0;
+            for (size_t k = 0; k < blocks; k++) {
+                largest = std::max<size_t>(largest, std::reduce(sizes.begin() + block_first[k],
+                                                               sizes.begin() + block_first[k + 1], uint64_t(0)));
+            }
+            std::vector<uint64_t> pos, first;
+            std::vector<SortKey> keys(largest);
+            pos.reserve(largest);
+            
+            Spill spill;
+            if (blocks == 1) {
+                // Each chunk's suffixes go after those of the chunks before
+                uint64_t start = 0;
+                for (uint32_t b = 0; b < BUCKETS; b++) {
+                    for (auto& c : counts) {
+                        uint64_t count = c[b];
+                        c[b] = start;
+                        start += count;
+                    }
+                }
+            } else {
+                spill = spillBlocks(each, counts, block_first, keys);
+                counts = {};
+            }
+            
+            for (size_t k = 0; k < blocks; k++) {
+                uint32_t lo = block_first[k], hi = block_first[k + 1];
+                first.assign(hi - lo + 1, 0);
+                for (uint32_t b = lo; b < hi; b++) first[b - lo + 1] = first[b - lo] + sizes[b];
+                pos.resize(first.back());
+                keys.resize(pos.size());
+                if (blocks == 1) {
+                    parallel([&](int t) {
+                        each(t, [&](uint64_t p) { pos[counts[t][bucket(p)]++] = p; });
+                    });
+                    counts = {};
+                } else {
+                    readBlock(spill, k, lo, first, keys, pos);
+                }
+                sortBuckets(pos.data(), keys.data(), first, cap, tie);
+                done(std::span<const uint64_t>(pos), std::span<SortKey>(keys));
+            }
+        }
+        
+        // Cover {0, ..., r - 1} plus the multiples of r, r = ceil(sqrt(v)): every
+        // difference a * r + b (b < r) is (a + 1) * r - (r - b), or a * r - 0
+        void chooseCover(uint64_t v) {
+            v_ = v;
+            v_shift_ = std::countr_zero(v);
+            uint64_t r = 1;
+            while (r * r < v) r++;
+            in_cover_.assign(v, false);
+            for (uint64_t a = 0; a < r; a++) in_cover_[a] = true;
+            for (uint64_t a = r; a < v + r; a += r) in_cover_[a % v] = true;
+            cover_pair_.assign(v, v);
+            sample_base_.assign(v, 0);
+            uint64_t index = 0;
+            for (uint64_t a = 0; a < v; a++) {
+                if (!in_cover_[a]) continue;
+                for (uint64_t b = 0; b < v; b++) {
+                    if (in_cover_[b]) cover_pair_[(b - a) & (v - 1)] = a;
+                }
+                sample_base_[a] = index;
+                if (a < n_) index += (n_ - a + v - 1) / v;
+            }
+            sample_base_.push_back(index);  // sample size
+        }
+        
+        uint64_t sampleSize() const { return sample_base_.back(); }
+        
+        // Offset d < v putting both i + d and j + d in the sample
+        uint64_t sampleOffset(uint64_t i, uint64_t j) const {
+            return (cover_pair_[(j - i) & (v_ - 1)] - i) & (v_ - 1);
+        }
+        
+        uint64_t sampleIndex(uint64_t pos) const { return sample_base_[pos & (v_ - 1)] + (pos >> v_shift_); }
+        
+        uint32_t sampleRank(uint64_t pos) const { return ranks_[sampleIndex(pos)]; }
+        
+        // Calls f(pos) on each sample position in chunk t of the text
+        template<typename F>
+        void forEachSample(int t, F&& f) const {
+            uint64_t begin = chunkBegin(t), end = chunkBegin(t + 1);
+            for (uint64_t a = 0; a < v_; a++) {
+                if (!in_cover_[a]) continue;
+                for (uint64_t p = begin + ((a - begin) & (v_ - 1)); p < end; p += v_) f(p);
+            }
+        }
+        
+        // Picks v and ranks the sample by its suffixes
+        void rankSample() {
+            for (uint64_t v = MIN_COVER;; v *= 2) {
+                chooseCover(v);
+                if (sampleSize() * sizeof(uint32_t) <= memory_bytes_ / 4 || v >= std::min(n_, MAX_COVER)) break;
+            }
+            uint64_t m = sampleSize();
+            if (m >= UINT32_MAX) throw std::length_error("buildBWT: text too long");
+            ranks_.resize(m);
+            
+            // Sort the sample by its first v + 1 bases, in blocks like the
+            // suffixes. A position's rank is its index in that order, or that
+            // of the first position sharing all v + 1 bases; those groups are
+            // listed for refining.
+            struct Group {
+                uint32_t rank;  // of its first member, in the sample
+                uint32_t size;
+            };
+            std::vector<Group> groups;
+            std::vector<uint32_t> members;  // sample indices of each group in turn
+            std::vector<std::pair<const uint64_t*, size_t>> runs;  // ties in the block being sorted
+            std::mutex lock;
+            auto addRun = [&](uint64_t* p, size_t count) {
+                std::lock_guard guard(lock);
+                runs.emplace_back(p, count);
+            };
+            auto eachSample = [&](int t, auto&& f) { forEachSample(t, f); };
+            uint64_t sorted = 0;
+            sortBlocks(eachSample, v_ + 1, addRun, [&](std::span<const uint64_t> pos, std::span<SortKey>) {
+                std::sort(runs.begin(), runs.end());
+                auto run = runs.begin();
+                for (size_t i = 0; i < pos.size();) {
+                    size_t count = 1;
+                    if (run != runs.end() && run->first == pos.data() + i) {
+                        count = run++->second;
+                        groups.push_back({uint32_t(sorted + i), uint32_t(count)});
+                        for (size_t j = i; j < i + count; j++) members.push_back(sampleIndex(pos[j]));
+                    }
+                    for (size_t j = i; j < i + count; j++) ranks_[sampleIndex(pos[j])] = sorted + i;
+                    i += count;
+                }
+                sorted += pos.size();
+                runs.clear();
+            });
+            
+            // Order each group by prefix doubling (after Larsson and Sadakane
+            // 2007): sample index x + h is the position h * v bases after x's,
+            // in the same residue, so sorting a group by the ranks at x + h
+            // doubles the bases its ranks account for. Members of a group share
+            // more than h * v bases, so x + h never leaves the residue. Ranks
+            // are updated in place, which only refines what later groups read.
+            std::vector<std::pair<uint32_t, uint32_t>> keyed;  // rank at x + h, x
+            for (uint64_t h = 1; !groups.empty(); h *= 2) {
+                std::vector<Group> next_groups;
+                std::vector<uint32_t> next_members;
+                const uint32_t* x = members.data();
+                for (Group g : groups) {
+                    keyed.clear();
+                    for (uint32_t i = 0; i < g.size; i++) keyed.emplace_back(ranks_[x[i] + h], x[i]);
+                    x += g.size;
+                    std::sort(keyed.begin(), keyed.end());
+                    for (uint32_t i = 0, j; i < g.size; i = j) {
+                        for (j = i + 1; j < g.size && keyed[j].first == keyed[i].first; j++) {}
+                        for (uint32_t k = i; k < j; k++) ranks_[keyed[k].second] = g.rank + i;
+                        if (j - i < 2) continue;
+                        next_groups.push_back({g.rank + i, j - i});
+                        for (uint32_t k = i; k < j; k++) next_members.push_back(keyed[k].second);
+                    }
+                }
+                groups.swap(next_groups);
+                members.swap(next_members);
+            }
+            ranked_ = true;
+        }
+        
+        // An anonymous file in dir (empty: the system's temporary directory)
+        static std::FILE* openTempFile(const std::string& dir) {
+            std::FILE* f = nullptr;
+            if (dir.empty()) {
+                f = std::tmpfile();
+            } else {
+                std::string path = dir + "/bwt-XXXXXX";
+                int fd = ::mkstemp(path.data());
+                if (fd >= 0) {
+                    ::unlink(path.c_str());
+                    f = ::fdopen(fd, "w+b");
+                    if (!f) ::close(fd);
+                }
+            }
+            if (!f) throw std::runtime_error("Cannot create a temporary file" + (dir.empty() ? "" : " in " + dir));
+            return f;
+        }
+        
+        // Positions are spilled in 4 bytes if they fit, else 8
+        size_t positionBytes() const { return n_ <= UINT32_MAX ? 4 : 8; }
+        
+        // Writes the positions of each block to its region of one file, in
+        // one pass over the text. Each thread stages its chunk's positions per
+        // block in an equal share of scratch (the keys, not in use yet; at
+        // least one position per thread and block) and writes them at its own
+        // offset in the region, after those of the chunks before.
+        template<typename Each>
+        Spill spillBlocks(Each& each, const std::vector<std::vector<uint64_t>>& counts,
+                          const std::vector<uint32_t>& block_first, std::vector<SortKey>& scratch) {
+            size_t blocks = block_first.size() - 1, width = positionBytes();
+            Spill spill;
+            spill.file.reset(openTempFile(temp_dir_));
+            int fd = ::fileno(spill.file.get());
+            std::vector<std::vector<uint64_t>> at(threads_, std::vector<uint64_t>(blocks));  // next write offset
+            spill.offset.assign(blocks + 1, 0);
+            for (size_t k = 0; k < blocks; k++) {
+                uint64_t offset = spill.offset[k];
+                for (int t = 0; t < threads_; t++) {
+                    at[t][k] = offset;
+                    offset += width * std::reduce(counts[t].begin() + block_first[k],
+                                                  counts[t].begin() + block_first[k + 1], uint64_t(0));
+                }
+                spill.offset[k + 1] = offset;
+            }
+            std::vector<uint32_t> block_of(BUCKETS);
+            for (size_t k = 0; k < blocks; k++) {
+                std::fill(block_of.begin() + block_first[k], block_of.begin() + block_first[k + 1], k);
+            }
+            size_t slot = std::clamp(scratch.size() * sizeof(SortKey) / (threads_ * blocks) / width * width,
+                                     width, SPILL_BUFFER);
+            if (slot * threads_ * blocks > scratch.size() * sizeof(SortKey)) {
+                scratch.resize((slot * threads_ * blocks + sizeof(SortKey) - 1) / sizeof(SortKey));
+            }
+            std::atomic<bool> failed = false;
+            parallel([&](int t) {
+                char* staged = reinterpret_cast<char*>(scratch.data()) + t * blocks * slot;
+                std::vector<size_t> used(blocks, 0);
+                auto flush = [&](size_t k) {
+                    if (!writeAt(fd, staged + k * slot, used[k], at[t][k])) failed = true;
+                    at[t][k] += used[k];
+                    used[k] = 0;
+                };
+                each(t, [&](uint64_t p) {
+                    size_t k = block_of[bucket(p)];
+                    char* bytes = staged + k * slot + used[k];
+                    if (width == 4) {
+                        uint32_t p32 = p;
+                        std::memcpy(bytes, &p32, 4);
+                    } else {
+                        std::memcpy(bytes, &p, 8);
+                    }
+                    used[k] += width;
+                    if (used[k] == slot) flush(k);
+                });
+                for (size_t k = 0; k < blocks; k++) flush(k);
+            });
+            if (failed) throw std::runtime_error("Failed writing a temporary file");
+            return spill;
+        }
+        
+        static bool writeAt(int fd, const char* data, size_t size, uint64_t offset) {
+            while (size > 0) {
+                ssize_t written = ::pwrite(fd, data, size, offset);
+                if (written <= 0) return false;
+                data += written;
+                size -= written;
+                offset += written;
+            }
+            return true;
+        }
+        
+        static bool readAt(int fd, char* data, size_t size, uint64_t offset) {
+            while (size > 0) {
+                ssize_t got = ::pread(fd, data, size, offset);
+                if (got <= 0) return false;
+                data += got;
+                size -= got;
+                offset += got;
+            }
+            return true;
+        }
+        
+        // Reads block k's positions back into pos, by bucket, through scratch
+        // (the block's keys, at least as large)
+        void readBlock(const Spill& spill, size_t k, uint32_t lo, std::span<const uint64_t> first,
+                       std::vector<SortKey>& scratch, std::vector<uint64_t>& pos) const {
+            size_t width = positionBytes();
+            uint64_t bytes = spill.offset[k + 1] - spill.offset[k];
+            char* buffer = reinterpret_cast<char*>(scratch.data());
+            if (!readAt(::fileno(spill.file.get()), buffer, bytes, spill.offset[k])) {
+                throw std::runtime_error("Failed reading a temporary file");
+            }
+            std::vector<uint64_t> next(first.begin(), first.end() - 1);
+            for (uint64_t i = 0; i < bytes / width; i++) {
+                uint64_t p = 0;
+                if (width == 4) {
+                    uint32_t p32;
+                    std::memcpy(&p32, buffer + i * 4, 4);
+                    p = p32;
+                } else {
+                    std::memcpy(&p, buffer + i * 8, 8);
+                }
+                pos[next[bucket(p) - lo]++] = p;
+            }
+        }
+    };
+}
+
+// BWT of text + '$' (as computeBWT returns it) without a suffix array, by
+// blockwise suffix sorting on options.threads threads (see
+// detail::BlockwiseBwt). Besides the packed text (n/4 bytes) and the result,
+// it works in about options.memory_bytes, plus 13 MB per thread and up to 50
+// MB more of bucket tables. Of the budget, the difference-cover sample's ranks
+// take at most a quarter, or up to n/8 bytes where even v = 4096 needs more;
+// while the sample is ranked, its positions in repeats longer than v take up
+// to 16 bytes more each. Blocks take the rest at 24 bytes per suffix. Past one
+// block, positions spill to a temporary file (4 bytes per base for texts under
+// 2^32), staged in the same memory. A single K-mer bucket larger than a block
+// is still sorted in one piece.
+inline std::string buildBWT(const PackedSequence& text, const BwtBuildOptions& options = {}) {
+    std::string bwt;
+    bwt.reserve(text.size() + 1);
+    detail::BlockwiseBwt(text, options).run([&](std::string_view block) { bwt += block; });
+    return bwt;
+}
+
+inline std::string buildBWT(std::string_view text, const BwtBuildOptions& options = {}) {
+    return buildBWT(PackedSequence(text), options);
+}
+
+// buildBWT written to a file block by block, so the result does not have to
+// fit in memory either
+inline void writeBWT(const PackedSequence& text, const std::string& path, const BwtBuildOptions& options = {}) {
+    std::unique_ptr<std::FILE, int (*)(std::FILE*)> out(std::fopen(path.c_str(), "wb"), std::fclose);
+    if (!out) throw std::runtime_error("Cannot create " + path);
+    detail::BlockwiseBwt(text, options).run([&](std::string_view block) {
+        if (std::fwrite(block.data(), 1, block.size(), out.get()) != block.size()) {
+            throw std::runtime_error("Failed writing " + path);
+        }
+    });
+    if (std::fclose(out.release()) != 0) throw std::runtime_error("Failed writing " + path);
+}
+
 } // namespace bio
+
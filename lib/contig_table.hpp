@@ -0,0 +1,136 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <span>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <bit>
+#include <stdexcept>
+#include "fastx.hpp"
+
+namespace bio {
+
+// Records of a multi-sequence reference, concatenated into one sequence
+//
+// Consecutive records are GAP 'N' bases apart, so no seed or exact match of
+// ACGT bases spans two of them; alignments that still cross a gap (through
+// errors or N in the read) are caught with contains(). The table keeps one
+// 8-byte start per record plus the names. A position is translated to its
+// record by binary search over the starts, narrowed first by a lookup table
+// of the record at every 2^shift-th base (about one entry per record, like
+// the k-mer prefix table of the suffix array), so a lookup touches a couple
+// of cache lines even with 100k+ records.
+//
+// Stored as offsets(): the start of each record, then the end of the
+// concatenated sequence + GAP (so record i ends at offsets[i + 1] - GAP), and
+// names(): each name followed by '\n'. A ContigTable either owns them or views
+// external memory (e.g. a memory-mapped index); it can be moved but not copied.
+class ContigTable {
+public:
+    static constexpr size_t GAP = 1;
+    
+    ContigTable() = default;
+    
+    // Spread the records read by readFasta (back to back in sequence) GAP
+    // bases apart, in place, and return their table
+    static ContigTable separate(std::string& sequence, const std::vector<FastaContig>& records) {
+        ContigTable t;
+        if (records.empty()) return t;
+        size_t n = records.size();
+        sequence.resize(sequence.size() + (n - 1) * GAP, 'N');
+        t.starts_storage_.resize(n + 1);
+        t.starts_storage_[n] = sequence.size() + GAP;
+        // Last record first: each moves right, over space already vacated
+        for (size_t i = n; i-- > 0;) {
+            size_t to = records[i].offset + i * GAP;
+            std::memmove(sequence.data() + to, sequence.data() + records[i].offset, records[i].length);
+            if (i > 0) std::fill_n(sequence.data() + to - GAP, GAP, 'N');
+            t.starts_storage_[i] = to;
+        }
+        for (const FastaContig& r : records) {
+            t.names_storage_.insert(t.names_storage_.end(), r.name.begin(), r.name.end());
+            t.names_storage_.push_back('\n');
+        }
+        t.starts_ = t.starts_storage_;
+        t.names_ = {t.names_storage_.data(), t.names_storage_.size()};
+        t.indexRecords();
+        return t;
+    }
+    
+    // Non-owning view of a table stored as offsets() and names()
+    static ContigTable view(std::span<const uint64_t> offsets, std::string_view names) {
+        ContigTable t;
+        t.starts_ = offsets;
+        t.names_ = names;
+        bool ok = offsets.size() >= 2 && offsets[0] == 0;
+        for (size_t i = 0; ok && i + 1 < offsets.size(); i++) ok = offsets[i] + GAP <= offsets[i + 1];
+        if (!ok) throw std::runtime_error("malformed contig table");
+        t.indexRecords();
+        if (t.name_starts_.size() != offsets.size()) throw std::runtime_error("malformed contig table");
+        return t;
+    }
+    
+    ContigTable(ContigTable&&) = default;
+    ContigTable& operator=(ContigTable&&) = default;
+    ContigTable(const ContigTable&) = delete;
+    ContigTable& operator=(const ContigTable&) = delete;
+    
+    size_t size() const { return starts_.empty() ? 0 : starts_.size() - 1; }
+    
+    std::string_view name(size_t i) const {
+        return names_.substr(name_starts_[i], name_starts_[i + 1] - name_starts_[i] - 1);
+    }
+    
+    uint64_t start(size_t i) const { return starts_[i]; }
+    uint64_t end(size_t i) const { return starts_[i + 1] - GAP; }
+    uint64_t length(size_t i) const { return end(i) - start(i); }
+    
+    // Bases in records, without the gaps
+    uint64_t totalLength() const {
+        return starts_.empty() ? 0 : starts_.back() - starts_.front() - size() * GAP;
+    }
+    
+    // Record holding position pos, or the one before the gap holding it
+    size_t find(uint64_t pos) const {
+        size_t b = std::min<size_t>(pos >> shift_, buckets_.size() - 2);
+        return std::upper_bound(starts_.begin() + buckets_[b] + 1, starts_.begin() + buckets_[b + 1] + 1, pos)
+             - starts_.begin() - 1;
+    }
+    
+    // True if [pos, pos + len) lies within one record
+    bool contains(uint64_t pos, uint64_t len) const {
+        return pos + len <= end(find(pos));
+    }
+    
+    std::span<const uint64_t> offsets() const { return starts_; }
+    std::string_view names() const { return names_; }
+
+private:
+    std::vector<uint64_t> starts_storage_;
+    std::vector<char> names_storage_;  // not a string: a view must survive moves
+    std::span<const uint64_t> starts_;
+    std::string_view names_;
+    std::vector<size_t> name_starts_;  // where each name starts in names_, then names_.size()
+    std::vector<uint32_t> buckets_;    // record holding base b << shift_, for b up to past the end
+    int shift_ = 0;
+    
+    void indexRecords() {
+        name_starts_.assign(1, 0);
+        for (size_t i = 0; i < names_.size(); i++) {
+            if (names_[i] == '\n') name_starts_.push_back(i + 1);
+        }
+        uint64_t total = starts_.back();
+        shift_ = std::bit_width(total / size());
+        buckets_.resize((total >> shift_) + 2);
+        size_t record = 0;
+        for (size_t b = 0; b < buckets_.size(); b++) {
+            while (record + 1 < size() && starts_[record + 1] <= (uint64_t)b << shift_) record++;
+            buckets_[b] = record;
+        }
+    }
+};
+
+} // namespace bio
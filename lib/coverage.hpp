@@ -0,0 +1,264 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <span>
+#include <mutex>
+#include <algorithm>
+#include <cstdio>
+#include <cstdint>
+#include <charconv>
+#include <stdexcept>
+#include "contig_table.hpp"
+
+namespace bio {
+
+// Per-base read depth, 2 bytes per base
+//
+// Depth saturates at MAX_DEPTH. The genome is split into contiguous shards,
+// each behind its own mutex. Every mapping thread owns a Writer that stages
+// read intervals per shard and applies a full buffer under the shard's lock:
+// densely packed intervals go through a difference array (+1 at each start,
+// -1 at each end, then one running-sum pass), sparse ones are added directly,
+// whichever touches fewer bases. Threads keep no per-base state of their own,
+// so nothing is merged at the end.
+class CoverageCounter {
+public:
+    static constexpr uint16_t MAX_DEPTH = UINT16_MAX;
+    
+    explicit CoverageCounter(size_t genome_size, size_t max_shards = 256)
+        : depth_(genome_size, 0) {
+        // Shards of at least 64 kbp, so a flush has some density to exploit
+        size_t shards = std::clamp<size_t>(genome_size >> 16, 1, std::max<size_t>(1, max_shards));
+        shard_len_ = std::max<size_t>(1, (genome_size + shards - 1) / shards);
+        shards_ = std::vector<Shard>((genome_size + shard_len_ - 1) / shard_len_);
+    }
+    
+    // Per-thread staging buffers; flushed on destruction
+    class Writer {
+    public:
+        explicit Writer(CoverageCounter& counter) : counter_(counter), buffers_(counter.shards_.size()) {}
+        
+        ~Writer() { flush(); }
+        
+        Writer(const Writer&) = delete;
+        Writer& operator=(const Writer&) = delete;
+        
+        // Count one read over [start, end), clamped to the genome; returns
+        // the number of bases counted
+        size_t add(size_t start, size_t end) {
+            end = std::min(end, counter_.depth_.size());
+            size_t counted = end > start ? end - start : 0;
+            while (start < end) {
+                size_t s = start / counter_.shard_len_;
+                size_t base = s * counter_.shard_len_;
+                size_t stop = std::min(end, base + counter_.shard_len_);
+                buffers_[s].push_back({uint32_t(start - base), uint32_t(stop - base)});
+                if (buffers_[s].size() == FLUSH_INTERVALS) flush(s);
+                start = stop;
+            }
+            return counted;
+        }
+        
+        void flush() {
+            for (size_t s = 0; s < buffers_.size(); s++) flush(s);
+        }
+    
+    private:
+        static constexpr size_t FLUSH_INTERVALS = 4096;
+        
+        struct Interval {
+            uint32_t begin, end;  // offsets within the shard
+        };
+        
+        CoverageCounter& counter_;
+        std::vector<std::vector<Interval>> buffers_;
+        std::vector<int32_t> diff_;
+        
+        void flush(size_t s) {
+            std::vector<Interval>& buffer = buffers_[s];
+            if (buffer.empty()) return;
+            uint32_t lo = UINT32_MAX, hi = 0;
+            size_t bases = 0;
+            for (const Interval& iv : buffer) {
+                lo = std::min(lo, iv.begin);
+                hi = std::max(hi, iv.end);
+                bases += iv.end - iv.begin;
+            }
+            
+            uint16_t* depth = counter_.depth_.data() + s * counter_.shard_len_;
+            if (hi - lo < bases) {
+                // Overlapping intervals: one pass over their span
+                diff_.assign(hi - lo + 1, 0);
+                for (const Interval& iv : buffer) {
+                    diff_[iv.begin - lo]++;
+                    diff_[iv.end - lo]--;
+                }
+                std::lock_guard<std::mutex> lock(counter_.shards_[s].m);
+                int32_t d = 0;
+                for (uint32_t i = lo; i < hi; i++) {
+                    d += diff_[i - lo];
+                    depth[i] = saturatingAdd(depth[i], d);
+                }
+            } else {
+                std::lock_guard<std::mutex> lock(counter_.shards_[s].m);
+                for (const Interval& iv : buffer) {
+                    for (uint32_t i = iv.begin; i < iv.end; i++) depth[i] = saturatingAdd(depth[i], 1);
+                }
+            }
+            buffer.clear();
+        }
+        
+        static uint16_t saturatingAdd(uint16_t depth, int32_t d) {
+            return uint16_t(std::min<int32_t>(MAX_DEPTH, depth + d));
+        }
+    };
+    
+    // Queries below are meant for after all Writers are gone
+    size_t size() const { return depth_.size(); }
+    uint16_t depth(size_t i) const { return depth_[i]; }
+    std::span<const uint16_t> depths() const { return depth_; }
+    
+    // Bases at each depth: histogram[d] for d = 0 .. highest depth seen
+    // (the last bin of a saturated counter holds depths >= MAX_DEPTH)
+    std::vector<long long> histogram() const {
+        std::vector<long long> hist(1, 0);
+        for (uint16_t d : depth_) {
+            if (d >= hist.size()) hist.resize(d + 1, 0);
+            hist[d]++;
+        }
+        return hist;
+    }
+    
+    // Call f(begin, end, depth) for each maximal run of equal, nonzero depth
+    // within [from, to), in order
+    template<typename F>
+    void forEachRun(size_t from, size_t to, F&& f) const {
+        to = std::min(to, depth_.size());
+        size_t i = from;
+        while (i < to) {
+            uint16_t d = depth_[i];
+            size_t j = i + 1;
+            while (j < to && depth_[j] == d) j++;
+            if (d > 0) f(i, j, d);
+            i = j;
+        }
+    }
+    
+    size_t memoryBytes() const { return depth_.size() * sizeof(uint16_t); }
+
+private:
+    // Aligned so that neighbouring shards' locks do not share a cache line
+    struct alignas(64) Shard {
+        std::mutex m;
+    };
+    
+    std::vector<uint16_t> depth_;
+    size_t shard_len_ = 1;
+    std::vector<Shard> shards_;
+};
+
+namespace detail {
+    // Buffered text output for the coverage writers below
+    class TextFile {
+    public:
+        explicit TextFile(const std::string& path) : path_(path) {
+            file_ = std::fopen(path.c_str(), "wb");
+            if (!file_) throw std::runtime_error("Cannot create " + path);
+        }
+        
+        ~TextFile() {
+            if (file_) std::fclose(file_);
+        }
+        
+        TextFile(const TextFile&) = delete;
+        TextFile& operator=(const TextFile&) = delete;
+        
+        void append(std::string_view s) {
+            buf_.append(s);
+            if (buf_.size() >= (1 << 20)) write();
+        }
+        
+        void append(long long value) {
+            char digits[24];
+            auto [end, ec] = std::to_chars(digits, digits + sizeof(digits), value);
+            buf_.append(digits, end);
+        }
+        
+        void close() {
+            write();
+            bool failed = std::fclose(file_) != 0;
+            file_ = nullptr;
+            if (failed) throw std::runtime_error("Failed writing " + path_);
+        }
+    
+    private:
+        std::string path_;
+        std::FILE* file_ = nullptr;
+        std::string buf_;
+        
+        void write() {
+            if (std::fwrite(buf_.data(), 1, buf_.size(), file_) != buf_.size()) {
+                throw std::runtime_error("Failed writing " + path_);
+            }
+            buf_.clear();
+        }
+    };
+}
+
+namespace detail {
+    inline void appendBedGraph(TextFile& out, std::string_view name, const CoverageCounter& coverage, size_t offset,
+                               size_t length) {
+        length = std::min(length, coverage.size() - std::min(offset, coverage.size()));
+        coverage.forEachRun(offset, offset + length, [&](size_t begin, size_t end, uint16_t depth) {
+            out.append(name);
+            out.append("\t");
+            out.append((long long)(begin - offset));
+            out.append("\t");
+            out.append((long long)(end - offset));
+            out.append("\t");
+            out.append((long long)depth);
+            out.append("\n");
+        });
+    }
+}
+
+// Write nonzero depth runs of [offset, offset + length) as bedGraph lines
+// "name <tab> begin <tab> end <tab> depth" with 0-based, half-open coordinates
+// relative to offset, streaming from the depth array
+inline void writeBedGraph(const std::string& path, std::string_view name, const CoverageCounter& coverage,
+                          size_t offset = 0, size_t length = SIZE_MAX) {
+    detail::TextFile out(path);
+    detail::appendBedGraph(out, name, coverage, offset, length);
+    out.close();
+}
+
+// The same for each record of a concatenated reference, named and
+// positioned as in its FASTA file
+inline void writeBedGraph(const std::string& path, const ContigTable& contigs, const CoverageCounter& coverage) {
+    detail::TextFile out(path);
+    for (size_t i = 0; i < contigs.size(); i++) {
+        detail::appendBedGraph(out, contigs.name(i), coverage, contigs.start(i), contigs.length(i));
+    }
+    out.close();
+}
+
+// Write "depth <tab> bases <tab> fraction" lines for every depth with bases
+inline void writeDepthHistogram(const std::string& path, std::span<const long long> histogram) {
+    detail::TextFile out(path);
+    long long total = 0;
+    for (long long n : histogram) total += n;
+    char fraction[32];
+    for (size_t d = 0; d < histogram.size(); d++) {
+        if (histogram[d] == 0) continue;
+        out.append((long long)d);
+        out.append("\t");
+        out.append(histogram[d]);
+        std::snprintf(fraction, sizeof(fraction), "\t%.6g\n", (double)histogram[d] / total);
+        out.append(fraction);
+    }
+    out.close();
+}
+
+} // namespace bio
@@ -1,9 +1,15 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <algorithm>
 #include <cmath>
+#include <cstdint>
+#include <span>
+#include <charconv>
+#include <bit>
+#include "packed_sequence.hpp"
 
 namespace bio {
 
@@ -11,7 +17,7 @@ namespace bio {
 // Optimized for cases where edit distance is guaranteed to be small (≤ maxDist)
 // Returns edit distance, or maxDist+1 if distance exceeds maxDist
 template<int maxDist = 100>
-inline int editDistance(const std::string& s, const std::string& t) {
+inline int editDistance(std::string_view s, std::string_view t) {
     int n = s.size();
     int m = t.size();
     
@@ -66,7 +72,7 @@ inline int editDistance(const std::string& s, const std::string& t) {
 
 // Standard edit distance without band limitation
 // Use for general cases where distance may be large
-inline int editDistanceFull(const std::string& s, const std::string& t) {
+inline int editDistanceFull(std::string_view s, std::string_view t) {
     int n = s.size();
     int m = t.size();
     
@@ -90,9 +96,363 @@ inline int editDistanceFull(const std::string& s, const std::string& t) {
 
 // Check if two strings are within a given edit distance
 template<int maxDist = 100>
-inline bool withinEditDistance(const std::string& s, const std::string& t, int threshold) {
+inline bool withinEditDistance(std::string_view s, std::string_view t, int threshold) {
     if (std::abs((int)s.size() - (int)t.size()) > threshold) return false;
     return editDistance<maxDist>(s, t) <= threshold;
 }
 
+// Alignment of a pattern to the start of a text, from alignBanded
+struct Alignment {
+    int distance = 0;     // edit distance; max_errors + 1 if there is none within max_errors
+    int text_begin = 0;   // first aligned text base
+    int text_end = 0;     // one past the last aligned text base
+    std::string cigar;    // SAM CIGAR: M (match or mismatch), I (pattern only), D (text only)
+};
+
+// Band-limited (|i - j| <= max_errors) DP aligning all of pattern against
+// text from text[0], with a traceback to a CIGAR string. The end in the text
+// is free, so pass max_errors bases of text past the pattern's length; of
+// equally good ends the one nearest the pattern length is used. The traceback
+// prefers match/mismatch, then insertion, then deletion. Leading deletions
+// advance text_begin instead of appearing in the CIGAR and are not counted.
+//
+// A BandedAligner keeps the DP matrix and the result between calls, so
+// aligning read after read allocates nothing once the buffers have grown.
+class BandedAligner {
+public:
+    // Valid until the next call
+    const Alignment& align(std::string_view pattern, std::string_view text, int max_errors) {
+        int m = pattern.size(), n = text.size(), e = std::max(0, max_errors);
+        int w = 2 * e + 1;
+        const int INF = 1 << 20;
+        dp_.assign((size_t)(m + 1) * w, INF);
+        // Cell (i, j): pattern prefix i against text prefix j, stored at diagonal j - i + e
+        auto at = [&](int i, int j) -> int& { return dp_[(size_t)i * w + (j - i + e)]; };
+        auto inBand = [&](int i, int j) { return j >= 0 && j <= n && std::abs(j - i) <= e; };
+        
+        for (int j = 0; j <= std::min(n, e); j++) at(0, j) = j;
+        for (int i = 1; i <= m; i++) {
+            for (int j = std::max(0, i - e); j <= std::min(n, i + e); j++) {
+                int d = INF;
+                if (j > 0) d = at(i - 1, j - 1) + (pattern[i - 1] != text[j - 1]);
+                if (inBand(i - 1, j)) d = std::min(d, at(i - 1, j) + 1);
+                if (j > 0 && inBand(i, j - 1)) d = std::min(d, at(i, j - 1) + 1);
+                at(i, j) = d;
+            }
+        }
+        
+        Alignment& result = result_;
+        result.text_begin = result.text_end = 0;
+        result.cigar.clear();
+        int end = -1;
+        for (int j = std::max(0, m - e); j <= std::min(n, m + e); j++) {
+            if (end < 0 || at(m, j) < at(m, end) || (at(m, j) == at(m, end) && std::abs(j - m) < std::abs(end - m))) end = j;
+        }
+        if (end < 0 || at(m, end) > e) {
+            result.distance = e + 1;
+            return result;
+        }
+        result.distance = at(m, end);
+        result.text_end = end;
+        
+        // Trace back, collecting operations in reverse
+        std::string& ops = ops_;
+        ops.clear();
+        int i = m, j = end;
+        while (i > 0 || j > 0) {
+            if (i > 0 && j > 0 && at(i, j) == at(i - 1, j - 1) + (pattern[i - 1] != text[j - 1])) {
+                ops += 'M';
+                i--, j--;
+            } else if (i > 0 && inBand(i - 1, j) && at(i, j) == at(i - 1, j) + 1) {
+                ops += 'I';
+                i--;
+            } else {
+                ops += 'D';
+                j--;
+            }
+        }
+        while (!ops.empty() && ops.back() == 'D') {
+            ops.pop_back();
+            result.text_begin++;
+            result.distance--;
+        }
+        
+        for (size_t k = ops.size(); k > 0;) {
+            char op = ops[k - 1];
+            size_t run = 0;
+            while (k > 0 && ops[k - 1] == op) k--, run++;
+            char digits[20];
+            result.cigar.append(digits, std::to_chars(digits, digits + sizeof(digits), run).ptr);
+            result.cigar += op;
+        }
+        return result;
+    }
+
+private:
+    std::vector<int> dp_;
+    std::string ops_;
+    Alignment result_;
+};
+
+inline Alignment alignBanded(std::string_view pattern, std::string_view text, int max_errors) {
+    BandedAligner aligner;
+    return aligner.align(pattern, text, max_errors);
+}
+
+// SIMD instruction sets usable by batch kernels, detected at runtime
+enum class SimdLevel { Scalar, SSE41, AVX2 };
+
+inline SimdLevel detectSimdLevel() {
+#if defined(__x86_64__) || defined(__i386__)
+    static const SimdLevel level = [] {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) return SimdLevel::AVX2;
+        if (__builtin_cpu_supports("sse4.1")) return SimdLevel::SSE41;
+        return SimdLevel::Scalar;
+    }();
+    return level;
+#else
+    return SimdLevel::Scalar;
+#endif
+}
+
+namespace detail {
+    constexpr int SIMD_MAX_WORDS = 4;  // batch kernels handle patterns up to 256 bases
+    
+    typedef uint64_t U64x2 __attribute__((vector_size(16)));
+    typedef uint64_t U64x4 __attribute__((vector_size(32)));
+    
+    // Inter-sequence bit-parallel kernel: each 64-bit lane runs the block
+    // recurrence of BitParallelPattern against its own text window, so one
+    // pattern is verified against `Lanes` candidate loci per instruction.
+    // Inlined into per-ISA wrappers so the vector ops use that ISA.
+    template<typename V, int Lanes>
+    __attribute__((always_inline)) inline void bitParallelLanes(
+            const uint64_t* peq, int m, int words, std::string_view text,
+            const int* starts, int len, int max_errors, int* out) {
+        const char* windows[Lanes];
+        for (int l = 0; l < Lanes; l++) windows[l] = text.data() + starts[l];
+        
+        V pv[SIMD_MAX_WORDS], mv[SIMD_MAX_WORDS];
+        for (int w = 0; w < words; w++) {
+            pv[w] = ~V{};
+            mv[w] = V{};
+        }
+        V score = V{} + m;  // two's complement; read back as int64_t
+        int last_shift = (m - 1) % 64;
+        
+        for (int j = 0; j < len; j++) {
+            // Global alignment: the top row grows by one per column
+            V hp = V{} + 1, hm = V{};
+            for (int w = 0; w < words; w++) {
+                V eq{};
+                for (int l = 0; l < Lanes; l++) eq[l] = peq[(unsigned char)windows[l][j] * words + w];
+                V xv = eq | mv[w];
+                eq |= hm;
+                V xh = (((eq & pv[w]) + pv[w]) ^ pv[w]) | eq;
+                V ph = mv[w] | ~(xh | pv[w]);
+                V mh = pv[w] & xh;
+                int shift = w == words - 1 ? last_shift : 63;
+                V hp_out = (ph >> shift) & 1;
+                V hm_out = (mh >> shift) & 1;
+                ph = (ph << 1) | hp;
+                mh = (mh << 1) | hm;
+                pv[w] = mh | ~(xv | ph);
+                mv[w] = ph & xv;
+                hp = hp_out;
+                hm = hm_out;
+            }
+            score += hp - hm;
+            
+            // Stop once no lane can get back down to max_errors
+            bool all_done = true;
+            for (int l = 0; l < Lanes; l++) all_done &= (int64_t)score[l] - (len - 1 - j) > max_errors;
+            if (all_done) break;
+        }
+        for (int l = 0; l < Lanes; l++) out[l] = std::min<int64_t>((int64_t)score[l], max_errors + 1);
+    }
+
+#if defined(__x86_64__) || defined(__i386__)
+    __attribute__((target("avx2")))
+    inline void bitParallelAvx2(const uint64_t* peq, int m, int words, std::string_view text,
+                                const int* starts, int len, int max_errors, int* out) {
+        bitParallelLanes<U64x4, 4>(peq, m, words, text, starts, len, max_errors, out);
+    }
+    
+    __attribute__((target("sse4.1")))
+    inline void bitParallelSse41(const uint64_t* peq, int m, int words, std::string_view text,
+                                 const int* starts, int len, int max_errors, int* out) {
+        bitParallelLanes<U64x2, 2>(peq, m, words, text, starts, len, max_errors, out);
+    }
+#endif
+}
+
+// Bit-parallel global edit distance (Myers 1999, Hyyrö's global variant)
+// The pattern is preprocessed once into per-character match masks, so one
+// pattern (e.g. a read) can be checked against many texts (candidate loci).
+// Patterns up to 64 bases use a single-word kernel; longer ones are processed
+// in 64-row blocks that pass horizontal deltas down the column.
+class BitParallelPattern {
+public:
+    BitParallelPattern() = default;
+    
+    explicit BitParallelPattern(std::string_view pattern) {
+        assign(pattern);
+    }
+    
+    // Switch to another pattern, reusing the buffers: only the match masks of
+    // the previous pattern's characters are cleared, so a mapper can keep one
+    // pattern per thread without allocating per read
+    void assign(std::string_view pattern) {
+        for (int b = 0; b < 4; b++) {
+            for (uint64_t bits = used_[b]; bits; bits &= bits - 1) {
+                std::fill_n(peq_.begin() + (64 * b + std::countr_zero(bits)) * words_, words_, 0);
+            }
+            used_[b] = 0;
+        }
+        m_ = pattern.size();
+        int words = std::max<int>(1, (m_ + 63) / 64);
+        if (words != words_) {
+            words_ = words;
+            peq_.assign(256 * words_, 0);
+            pv_.resize(words_);
+            mv_.resize(words_);
+        }
+        for (int i = 0; i < m_; i++) {
+            unsigned char c = pattern[i];
+            peq_[c * words_ + i / 64] |= 1ULL << (i % 64);
+            used_[c / 64] |= 1ULL << (c % 64);
+        }
+    }
+    
+    // Edit distance between the pattern and text, or max_errors+1 if it exceeds
+    // max_errors. Stops early once the distance can no longer drop to max_errors.
+    // Not thread-safe: reuses per-pattern column state.
+    int distance(std::string_view text, int max_errors) {
+        int n = text.size();
+        if (std::abs(m_ - n) > max_errors) return max_errors + 1;
+        if (m_ == 0) return n;
+        return words_ == 1 ? distance64(text, max_errors) : distanceBlocks(text, max_errors);
+    }
+    
+    // Distances to many equal-length windows: out[i] = distance(text.substr(starts[i], len)).
+    // Windows must lie inside text. Vectorized across windows (AVX2: 4 lanes,
+    // SSE4.1: 2 lanes) when the CPU supports it, scalar otherwise.
+    void distances(std::string_view text, std::span<const int> starts, int len, int max_errors,
+                   std::span<int> out, SimdLevel level = detectSimdLevel()) {
+        size_t count = starts.size();
+        if (std::abs(m_ - len) > max_errors || m_ == 0 || words_ > detail::SIMD_MAX_WORDS) {
+            level = SimdLevel::Scalar;
+        }
+        
+        size_t i = 0;
+#if defined(__x86_64__) || defined(__i386__)
+        int lanes = level == SimdLevel::AVX2 ? 4 : level == SimdLevel::SSE41 ? 2 : 1;
+        if (lanes > 1) {
+            // A lone trailing window is cheaper on the scalar path
+            for (; i + 1 < count; i += lanes) {
+                // Pad the final group by repeating its last window
+                int group_starts[4], group_out[4];
+                for (int l = 0; l < lanes; l++) group_starts[l] = starts[std::min(i + l, count - 1)];
+                if (lanes == 4) {
+                    detail::bitParallelAvx2(peq_.data(), m_, words_, text, group_starts, len, max_errors, group_out);
+                } else {
+                    detail::bitParallelSse41(peq_.data(), m_, words_, text, group_starts, len, max_errors, group_out);
+                }
+                for (int l = 0; l < lanes && i + l < count; l++) out[i + l] = group_out[l];
+            }
+        }
+#endif
+        for (; i < count; i++) {
+            out[i] = distance(text.substr(starts[i], len), max_errors);
+        }
+    }
+    
+    // Same for windows of a packed text: the windows are unpacked side by side
+    // into a scratch buffer first
+    void distances(const PackedSequence& text, std::span<const int> starts, int len, int max_errors,
+                   std::span<int> out, SimdLevel level = detectSimdLevel()) {
+        window_text_.resize(starts.size() * len);
+        window_starts_.resize(starts.size());
+        for (size_t i = 0; i < starts.size(); i++) {
+            text.extract(starts[i], len, window_text_.data() + i * len);
+            window_starts_[i] = i * len;
+        }
+        distances(std::string_view(window_text_.data(), window_text_.size()), window_starts_, len, max_errors, out, level);
+    }
+    
+    int size() const { return m_; }
+
+private:
+    int m_ = 0;
+    int words_ = 0;
+    uint64_t used_[4] = {};  // characters with match masks set in peq_
+    std::vector<uint64_t> peq_;  // peq_[c * words_ + w]: bit i set where pattern[64w + i] == c
+    std::vector<uint64_t> pv_, mv_;  // column state of the block kernel
+    std::vector<char> window_text_;  // unpacked windows of a packed text
+    std::vector<int> window_starts_;
+    
+    int distance64(std::string_view text, int max_errors) {
+        int n = text.size();
+        uint64_t high = 1ULL << (m_ - 1);
+        uint64_t pv = ~0ULL, mv = 0;
+        int score = m_;
+        for (int j = 0; j < n; j++) {
+            uint64_t eq = peq_[(unsigned char)text[j]];
+            uint64_t xv = eq | mv;
+            uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+            uint64_t ph = mv | ~(xh | pv);
+            uint64_t mh = pv & xh;
+            if (ph & high) score++;
+            else if (mh & high) score--;
+            // Global alignment: the top row grows by one per column
+            ph = (ph << 1) | 1;
+            mh <<= 1;
+            pv = mh | ~(xv | ph);
+            mv = ph & xv;
+            // Each remaining column lowers the last row by at most one
+            if (score - (n - 1 - j) > max_errors) return max_errors + 1;
+        }
+        return std::min(score, max_errors + 1);
+    }
+    
+    int distanceBlocks(std::string_view text, int max_errors) {
+        int n = text.size();
+        uint64_t last_high = 1ULL << ((m_ - 1) % 64);
+        std::fill(pv_.begin(), pv_.end(), ~0ULL);
+        std::fill(mv_.begin(), mv_.end(), 0);
+        int score = m_;
+        for (int j = 0; j < n; j++) {
+            const uint64_t* eqs = &peq_[(unsigned char)text[j] * words_];
+            int hin = 1;
+            for (int w = 0; w < words_; w++) {
+                uint64_t pv = pv_[w], mv = mv_[w], eq = eqs[w];
+                uint64_t xv = eq | mv;
+                if (hin < 0) eq |= 1;
+                uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+                uint64_t ph = mv | ~(xh | pv);
+                uint64_t mh = pv & xh;
+                uint64_t high = w == words_ - 1 ? last_high : 1ULL << 63;
+                int hout = (ph & high) ? 1 : (mh & high) ? -1 : 0;
+                ph <<= 1;
+                mh <<= 1;
+                if (hin < 0) mh |= 1;
+                else if (hin > 0) ph |= 1;
+                pv_[w] = mh | ~(xv | ph);
+                mv_[w] = ph & xv;
+                hin = hout;
+            }
+            score += hin;
+            if (score - (n - 1 - j) > max_errors) return max_errors + 1;
+        }
+        return std::min(score, max_errors + 1);
+    }
+};
+
+// Bit-parallel edit distance of s and t, capped at max_errors+1
+// Equals min(editDistance<maxDist>(s, t), max_errors + 1) for max_errors <= maxDist
+inline int editDistanceBitParallel(std::string_view s, std::string_view t, int max_errors) {
+    return BitParallelPattern(t).distance(s, max_errors);
+}
+
 } // namespace bio
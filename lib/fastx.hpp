@@ -0,0 +1,279 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <algorithm>
+#include <filesystem>
+#include <memory>
+#include "gzip.hpp"
+
+namespace bio {
+
+// Block-buffered FASTA/FASTQ parsing
+//
+// Files are read in large blocks, gzip/BGZF input is decompressed transparently
+// on background threads (see gzip.hpp); FASTQ records are handed out as string_views
+// into a chunk buffer, so parsing does no per-read allocation. Lines may end in
+// LF or CRLF, the last line may lack a newline, and malformed records raise
+// std::runtime_error naming the file and record.
+
+struct FastqRecord {
+    std::string_view id;    // header line without the leading '@'
+    std::string_view seq;
+    std::string_view qual;
+};
+
+// A block of complete FASTQ records; the views point into data[0, size).
+// Reuse chunks across calls to keep their buffers allocated.
+struct FastqChunk {
+    std::vector<char> data;
+    size_t size = 0;
+    std::vector<FastqRecord> records;
+};
+
+namespace detail {
+    // Sequential file input in large blocks, gzip-compressed or not
+    class BlockFile {
+    public:
+        explicit BlockFile(const std::string& path, int decompress_threads = 1) : path_(path) {
+            if (isGzipFile(path)) {
+                gzip_ = std::make_unique<GzipReader>(path, decompress_threads);
+                return;
+            }
+            file_ = std::fopen(path.c_str(), "rb");
+            if (!file_) throw std::runtime_error("Cannot open " + path);
+        }
+        
+        ~BlockFile() {
+            if (file_) std::fclose(file_);
+        }
+        
+        BlockFile(const BlockFile&) = delete;
+        BlockFile& operator=(const BlockFile&) = delete;
+        
+        // Read up to len bytes; returns 0 only at end of file
+        size_t read(char* buf, size_t len) {
+            if (gzip_) return gzip_->read(buf, len);
+            size_t got = std::fread(buf, 1, len, file_);
+            if (got == 0 && std::ferror(file_)) throw std::runtime_error("Error reading " + path_);
+            return got;
+        }
+        
+        const std::string& path() const { return path_; }
+    
+    private:
+        std::string path_;
+        std::FILE* file_ = nullptr;
+        std::unique_ptr<GzipReader> gzip_;
+    };
+    
+    // Next line in [p, end) without its line terminator (LF or CRLF). Returns
+    // false if no complete line is available; at end of file the rest counts as one.
+    inline bool nextLine(const char*& p, const char* end, bool at_eof, std::string_view& line) {
+        if (p >= end) return false;
+        const char* nl = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        const char* line_end = nl ? nl : end;
+        if (!nl && !at_eof) return false;
+        line = std::string_view(p, line_end - p);
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        p = nl ? nl + 1 : end;
+        return true;
+    }
+}
+
+class FastqReader {
+public:
+    explicit FastqReader(const std::string& path, size_t block_bytes = 4 << 20, int decompress_threads = 1)
+        : file_(path, decompress_threads), block_bytes_(block_bytes) {}
+    
+    // Fill chunk with the next complete records (at most max_records).
+    // Returns false once the input is exhausted.
+    bool next(FastqChunk& chunk, size_t max_records = SIZE_MAX) {
+        chunk.records.clear();
+        chunk.size = carry_.size();
+        // Buffers only ever grow, so a reused chunk is not re-zeroed
+        if (chunk.data.size() < chunk.size + block_bytes_) chunk.data.resize(chunk.size + block_bytes_);
+        std::copy(carry_.begin(), carry_.end(), chunk.data.begin());
+        carry_.clear();
+        if (max_records == 0) return false;
+        
+        while (true) {
+            if (!eof_) {
+                if (chunk.data.size() < chunk.size + block_bytes_) chunk.data.resize(chunk.size + block_bytes_);
+                size_t got = file_.read(chunk.data.data() + chunk.size, block_bytes_);
+                chunk.size += got;
+                if (got == 0) eof_ = true;
+            }
+            
+            const char* begin = chunk.data.data();
+            const char* end = begin + chunk.size;
+            const char* p = parse(begin, end, chunk.records, max_records);
+            
+            // Keep the unparsed tail for the next chunk; if no record fit, read more
+            if (!chunk.records.empty() || eof_) {
+                carry_.assign(p, end);
+                if (eof_ && chunk.records.empty() && !carry_.empty()) {
+                    throw std::runtime_error(file_.path() + ": truncated FASTQ record " + std::to_string(record_index_ + 1));
+                }
+                return !chunk.records.empty();
+            }
+        }
+    }
+    
+    // Give back the records of chunk from index keep on: they are returned
+    // again by the next call. Only valid right after next() filled chunk.
+    void unread(FastqChunk& chunk, size_t keep) {
+        if (keep >= chunk.records.size()) return;
+        const char* from = chunk.records[keep].id.data() - 1;  // the '@'
+        const char* end = chunk.data.data() + chunk.size;
+        carry_.assign(from, end);
+        record_index_ -= chunk.records.size() - keep;
+        chunk.records.resize(keep);
+    }
+    
+    const std::string& path() const { return file_.path(); }
+
+private:
+    detail::BlockFile file_;
+    size_t block_bytes_;
+    std::vector<char> carry_;
+    bool eof_ = false;
+    long long record_index_ = 0;
+    
+    // Parse complete records from [p, end); returns where parsing stopped
+    const char* parse(const char* p, const char* end, std::vector<FastqRecord>& out, size_t max_records) {
+        while (out.size() < max_records) {
+            // Skip blank lines between records
+            while (p < end && (*p == '\n' || *p == '\r')) p++;
+            
+            const char* start = p;
+            std::string_view header, seq, plus, qual;
+            if (!detail::nextLine(p, end, eof_, header) || !detail::nextLine(p, end, eof_, seq) ||
+                !detail::nextLine(p, end, eof_, plus) || !detail::nextLine(p, end, eof_, qual)) {
+                return start;
+            }
+            
+            record_index_++;
+            if (header.empty() || header[0] != '@') malformed("header does not start with '@'");
+            if (plus.empty() || plus[0] != '+') malformed("separator line does not start with '+'");
+            if (qual.size() != seq.size()) malformed("sequence and quality lengths differ");
+            
+            out.push_back({header.substr(1), seq, qual});
+        }
+        return p;
+    }
+    
+    [[noreturn]] void malformed(const char* what) const {
+        throw std::runtime_error(file_.path() + ": malformed FASTQ record " + std::to_string(record_index_) + " (" + what + ")");
+    }
+};
+
+// Two FASTQ files of mates read in lockstep: record i of one file is the mate
+// of record i of the other. Names must agree up to a trailing /1 or /2 (and
+// any comment); a mismatch or a file running out first raises an error.
+class PairedFastqReader {
+public:
+    PairedFastqReader(const std::string& path1, const std::string& path2, size_t block_bytes = 4 << 20,
+                      int decompress_threads = 1)
+        : first_(path1, block_bytes, decompress_threads), second_(path2, block_bytes, decompress_threads) {}
+    
+    // Fill the chunks with the next pairs, as many in each (at most max_pairs).
+    // Returns false once both inputs are exhausted.
+    bool next(FastqChunk& chunk1, FastqChunk& chunk2, size_t max_pairs = SIZE_MAX) {
+        if (max_pairs == 0) {
+            chunk1.records.clear();
+            chunk2.records.clear();
+            return false;
+        }
+        bool more1 = first_.next(chunk1, max_pairs);
+        bool more2 = second_.next(chunk2, more1 ? chunk1.records.size() : 1);
+        if (more1 != more2) {
+            throw std::runtime_error((more1 ? second_ : first_).path() + " has fewer reads than " +
+                                     (more1 ? first_ : second_).path());
+        }
+        if (!more1) return false;
+        // A chunk boundary may fall earlier in the second file
+        first_.unread(chunk1, chunk2.records.size());
+        for (size_t i = 0; i < chunk1.records.size(); i++) {
+            if (mateName(chunk1.records[i].id) != mateName(chunk2.records[i].id)) {
+                throw std::runtime_error("mate names differ: " + std::string(chunk1.records[i].id) + " in " +
+                                         first_.path() + ", " + std::string(chunk2.records[i].id) + " in " +
+                                         second_.path());
+            }
+        }
+        return true;
+    }
+    
+    // Read name without its comment and /1 or /2 mate suffix
+    static std::string_view mateName(std::string_view id) {
+        id = id.substr(0, id.find_first_of(" \t"));
+        if (id.size() >= 2 && id[id.size() - 2] == '/' && (id.back() == '1' || id.back() == '2')) {
+            id.remove_suffix(2);
+        }
+        return id;
+    }
+
+private:
+    FastqReader first_, second_;
+};
+
+// A FASTA record located in a concatenated sequence
+struct FastaContig {
+    std::string name;    // header up to the first whitespace
+    size_t offset;       // start in the concatenated sequence
+    size_t length;
+};
+
+// Read all records of a (multi-line, multi-record) FASTA file, appending their
+// bases to `sequence` with line breaks and trailing blanks removed. Returns one
+// entry per record; sequence before the first header is an unnamed record.
+inline std::vector<FastaContig> readFasta(const std::string& path, std::string& sequence,
+                                          size_t block_bytes = 4 << 20, int decompress_threads = 1) {
+    detail::BlockFile file(path, decompress_threads);
+    // The file size bounds the sequence length (for uncompressed input); reserving
+    // avoids regrowing a huge string
+    std::error_code ec;
+    auto file_bytes = std::filesystem::file_size(path, ec);
+    if (!ec) sequence.reserve(sequence.size() + file_bytes);
+    
+    std::vector<FastaContig> contigs;
+    std::vector<char> buf(block_bytes);
+    size_t filled = 0;
+    std::string_view line;
+    bool eof = false;
+    
+    while (!eof) {
+        // Leftover partial lines are at the front; grow only for very long lines
+        if (buf.size() < filled + block_bytes) buf.resize(filled + block_bytes);
+        size_t got = file.read(buf.data() + filled, block_bytes);
+        filled += got;
+        eof = got == 0;
+        
+        const char* p = buf.data();
+        const char* end = p + filled;
+        while (detail::nextLine(p, end, eof, line)) {
+            if (line.empty()) continue;
+            if (line[0] == '>') {
+                if (!contigs.empty()) contigs.back().length = sequence.size() - contigs.back().offset;
+                std::string_view name = line.substr(1);
+                name = name.substr(0, name.find_first_of(" \t"));
+                contigs.push_back({std::string(name), sequence.size(), 0});
+                continue;
+            }
+            if (line[0] == ';') continue;  // legacy comment line
+            if (contigs.empty()) contigs.push_back({std::string(), sequence.size(), 0});  // headerless
+            while (!line.empty() && (line.back() == ' ' || line.back() == '\t')) line.remove_suffix(1);
+            sequence.append(line);
+        }
+        filled = end - p;
+        std::memmove(buf.data(), p, filled);
+    }
+    if (!contigs.empty()) contigs.back().length = sequence.size() - contigs.back().offset;
+    return contigs;
+}
+
+} // namespace bio
@@ -0,0 +1,276 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <stdexcept>
+#include <zlib.h>
+
+namespace bio {
+
+// True if the file starts with the gzip magic bytes
+inline bool isGzipFile(const std::string& path) {
+    std::FILE* f = std::fopen(path.c_str(), "rb");
+    if (!f) return false;
+    unsigned char magic[2] = {0, 0};
+    size_t got = std::fread(magic, 1, 2, f);
+    std::fclose(f);
+    return got == 2 && magic[0] == 0x1f && magic[1] == 0x8b;
+}
+
+namespace detail {
+    // Inflate one or more concatenated gzip members, appending to out
+    inline void inflateMembers(const unsigned char* in, size_t len, std::vector<char>& out) {
+        z_stream zs{};
+        if (inflateInit2(&zs, 15 + 16) != Z_OK) throw std::runtime_error("zlib initialisation failed");
+        zs.next_in = const_cast<unsigned char*>(in);
+        zs.avail_in = len;
+        size_t produced = out.size();
+        int ret = Z_STREAM_END;
+        while (zs.avail_in > 0) {
+            if (out.size() - produced < 65536) out.resize(produced + std::max<size_t>(65536, out.size() / 2));
+            zs.next_out = reinterpret_cast<unsigned char*>(out.data() + produced);
+            zs.avail_out = out.size() - produced;
+            ret = inflate(&zs, Z_NO_FLUSH);
+            produced = out.size() - zs.avail_out;
+            if (ret == Z_STREAM_END) {
+                inflateReset(&zs);
+            } else if (ret != Z_OK && ret != Z_BUF_ERROR) {
+                inflateEnd(&zs);
+                throw std::runtime_error("corrupt gzip data");
+            }
+        }
+        inflateEnd(&zs);
+        if (ret != Z_STREAM_END) throw std::runtime_error("truncated gzip data");
+        out.resize(produced);
+    }
+}
+
+// Streams the decompressed contents of a gzip file, decompressing on
+// background threads ahead of the consumer. Plain (possibly multi-member) gzip
+// is inflated sequentially by one thread; BGZF files (bgzip/samtools output)
+// consist of independent blocks that `threads` workers inflate in parallel,
+// with the output handed out in file order.
+class GzipReader {
+public:
+    explicit GzipReader(const std::string& path, int threads = 1) : path_(path) {
+        file_ = std::fopen(path.c_str(), "rb");
+        if (!file_) throw std::runtime_error("Cannot open " + path);
+        
+        if (isBgzf()) {
+            threads = std::max(1, threads);
+            max_in_flight_ = 2 * threads + 2;
+            producer_ = std::thread([this] { readBgzfBlocks(); });
+            for (int t = 0; t < threads; t++) workers_.emplace_back([this] { inflateBlocks(); });
+        } else {
+            max_in_flight_ = 4;
+            producer_ = std::thread([this] { inflateStream(); });
+        }
+    }
+    
+    ~GzipReader() {
+        {
+            std::lock_guard<std::mutex> lock(m_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        producer_.join();
+        for (std::thread& w : workers_) w.join();
+        std::fclose(file_);
+    }
+    
+    GzipReader(const GzipReader&) = delete;
+    GzipReader& operator=(const GzipReader&) = delete;
+    
+    // Read up to len decompressed bytes; returns 0 only at end of data
+    size_t read(char* buf, size_t len) {
+        size_t copied = 0;
+        while (copied < len) {
+            if (!current_ || current_pos_ == current_->out.size()) {
+                if (copied > 0 || !nextBlock()) break;
+                continue;
+            }
+            size_t n = std::min(len - copied, current_->out.size() - current_pos_);
+            std::memcpy(buf + copied, current_->out.data() + current_pos_, n);
+            current_pos_ += n;
+            copied += n;
+        }
+        return copied;
+    }
+
+private:
+    struct Block {
+        std::vector<unsigned char> in;  // compressed BGZF blocks
+        std::vector<char> out;          // decompressed data
+        bool ready = false;
+        std::string error;
+    };
+    
+    static constexpr size_t BGZF_BATCH_BYTES = 1 << 20;  // compressed bytes per worker job
+    static constexpr size_t STREAM_BLOCK_BYTES = 4 << 20;
+    
+    std::string path_;
+    std::FILE* file_ = nullptr;
+    size_t max_in_flight_;
+    
+    std::mutex m_;
+    std::condition_variable cv_;
+    std::deque<std::shared_ptr<Block>> ordered_;  // in file order, consumed by read()
+    std::deque<std::shared_ptr<Block>> pending_;  // awaiting a BGZF worker
+    bool input_done_ = false;
+    bool stop_ = false;
+    std::thread producer_;
+    std::vector<std::thread> workers_;
+    
+    std::shared_ptr<Block> current_;
+    size_t current_pos_ = 0;
+    
+    // BGZF: gzip header with FEXTRA whose first subfield is 'BC' (block size)
+    bool isBgzf() {
+        unsigned char h[14];
+        size_t got = std::fread(h, 1, sizeof(h), file_);
+        std::rewind(file_);
+        return got == sizeof(h) && h[0] == 0x1f && h[1] == 0x8b && h[2] == 8 && (h[3] & 4) &&
+               h[12] == 'B' && h[13] == 'C';
+    }
+    
+    bool nextBlock() {
+        std::unique_lock<std::mutex> lock(m_);
+        cv_.wait(lock, [&] { return (!ordered_.empty() && ordered_.front()->ready) || (ordered_.empty() && input_done_); });
+        if (ordered_.empty()) return false;
+        current_ = ordered_.front();
+        ordered_.pop_front();
+        current_pos_ = 0;
+        cv_.notify_all();
+        if (!current_->error.empty()) throw std::runtime_error(path_ + ": " + current_->error);
+        return true;
+    }
+    
+    // Queue a block in file order once fewer than max_in_flight_ are outstanding
+    bool enqueue(const std::shared_ptr<Block>& block, bool needs_worker) {
+        std::unique_lock<std::mutex> lock(m_);
+        cv_.wait(lock, [&] { return ordered_.size() < max_in_flight_ || stop_; });
+        if (stop_) return false;
+        ordered_.push_back(block);
+        if (needs_worker) pending_.push_back(block);
+        cv_.notify_all();
+        return true;
+    }
+    
+    void finishInput(const std::string& error = "") {
+        std::lock_guard<std::mutex> lock(m_);
+        if (!error.empty()) {
+            auto block = std::make_shared<Block>();
+            block->error = error;
+            block->ready = true;
+            ordered_.push_back(block);
+        }
+        input_done_ = true;
+        cv_.notify_all();
+    }
+    
+    // Producer for plain gzip: inflate the whole stream sequentially
+    void inflateStream() {
+        z_stream zs{};
+        if (inflateInit2(&zs, 15 + 16) != Z_OK) return finishInput("zlib initialisation failed");
+        std::vector<unsigned char> in(1 << 16);
+        bool at_eof = false;
+        bool in_member = false;
+        std::string error;
+        
+        while (!at_eof && error.empty()) {
+            auto block = std::make_shared<Block>();
+            block->out.resize(STREAM_BLOCK_BYTES);
+            zs.next_out = reinterpret_cast<unsigned char*>(block->out.data());
+            zs.avail_out = STREAM_BLOCK_BYTES;
+            while (zs.avail_out > 0) {
+                if (zs.avail_in == 0) {
+                    zs.avail_in = std::fread(in.data(), 1, in.size(), file_);
+                    zs.next_in = in.data();
+                    if (zs.avail_in == 0) {
+                        if (std::ferror(file_)) error = "read error";
+                        else if (in_member) error = "truncated gzip data";
+                        at_eof = true;
+                        break;
+                    }
+                }
+                int ret = inflate(&zs, Z_NO_FLUSH);
+                in_member = ret != Z_STREAM_END;
+                if (ret == Z_STREAM_END) {
+                    inflateReset(&zs);  // concatenated members
+                } else if (ret != Z_OK && ret != Z_BUF_ERROR) {
+                    error = "corrupt gzip data";
+                    break;
+                }
+            }
+            block->out.resize(STREAM_BLOCK_BYTES - zs.avail_out);
+            block->ready = true;
+            if (!block->out.empty() && !enqueue(block, false)) break;
+        }
+        inflateEnd(&zs);
+        finishInput(error);
+    }
+    
+    // Producer for BGZF: split the file into batches of whole blocks for the workers
+    void readBgzfBlocks() {
+        std::string error;
+        while (error.empty()) {
+            auto block = std::make_shared<Block>();
+            while (block->in.size() < BGZF_BATCH_BYTES) {
+                unsigned char h[18];
+                size_t got = std::fread(h, 1, sizeof(h), file_);
+                if (got == 0) break;
+                if (got < sizeof(h) || h[0] != 0x1f || h[1] != 0x8b || h[12] != 'B' || h[13] != 'C') {
+                    error = "malformed BGZF block";
+                    break;
+                }
+                size_t bsize = (h[16] | h[17] << 8) + 1;
+                size_t start = block->in.size();
+                block->in.resize(start + bsize);
+                std::memcpy(block->in.data() + start, h, sizeof(h));
+                if (bsize < sizeof(h) || std::fread(block->in.data() + start + sizeof(h), 1, bsize - sizeof(h), file_) != bsize - sizeof(h)) {
+                    error = "truncated BGZF block";
+                    break;
+                }
+            }
+            if (block->in.empty() || !error.empty()) break;
+            if (!enqueue(block, true)) break;
+        }
+        finishInput(error);
+    }
+    
+    // Worker for BGZF: inflate pending batches independently
+    void inflateBlocks() {
+        while (true) {
+            std::shared_ptr<Block> block;
+            {
+                std::unique_lock<std::mutex> lock(m_);
+                cv_.wait(lock, [&] { return !pending_.empty() || input_done_ || stop_; });
+                if (stop_ || pending_.empty()) return;
+                block = pending_.front();
+                pending_.pop_front();
+            }
+            try {
+                block->out.reserve(block->in.size() * 4);
+                detail::inflateMembers(block->in.data(), block->in.size(), block->out);
+            } catch (const std::exception& e) {
+                block->error = e.what();
+            }
+            block->in = std::vector<unsigned char>();
+            {
+                std::lock_guard<std::mutex> lock(m_);
+                block->ready = true;
+            }
+            cv_.notify_all();
+        }
+    }
+};
+
+} // namespace bio
@@ -0,0 +1,258 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <span>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace bio {
+
+// On-disk index file
+//
+// Layout (little-endian, every section aligned to 64 bytes):
+//   IndexHeader
+//   IndexSectionEntry[section_count]
+//   section payloads
+//
+// The header carries a checksum of itself and the section table, which is
+// always checked on load; each section carries a checksum of its payload,
+// checked on demand by MappedIndex::verify().
+
+enum class IndexSection : uint32_t {
+    // 1 held the unpacked genome (1 byte per base) in version 1
+    SuffixArray = 2,     // int32 suffix array of the genome; its length is the genome length
+    PackedGenome = 3,    // reference bases, 2 bits per base (PackedSequence::words)
+    AmbiguousBases = 4,  // bitmap of non-ACGT bases (PackedSequence::ambiguityBits), may be empty
+    LcpLeft = 5,         // uint8 LCP-LR tables of the suffix array (LcpLrTables::left/right)
+    LcpRight = 6,
+    PrefixTable = 7,     // uint32 k-mer prefix table (buildPrefixTable), optional
+    ContigOffsets = 8,   // uint64 record starts in the genome, then its end + gap (ContigTable::offsets)
+    ContigNames = 9,     // record names, each followed by '\n' (ContigTable::names)
+};
+
+constexpr char INDEX_MAGIC[8] = {'B', 'I', 'O', 'I', 'D', 'X', '\0', '\0'};
+constexpr uint32_t INDEX_VERSION = 3;  // 3: genome records separated by gaps, contig table
+
+struct IndexHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t section_count;
+    uint64_t file_size;
+    uint64_t table_checksum;  // over the header (with this field zeroed) and section table
+};
+
+struct IndexSectionEntry {
+    uint32_t id;
+    uint32_t reserved;
+    uint64_t offset;
+    uint64_t size;
+    uint64_t checksum;
+};
+
+namespace detail {
+    // 64-bit multiply-xorshift hash over 8-byte words, for corruption detection
+    inline uint64_t checksum64(const void* data, size_t len, uint64_t seed = 0) {
+        constexpr uint64_t K = 0x9E3779B97F4A7C15ULL;
+        const unsigned char* p = static_cast<const unsigned char*>(data);
+        uint64_t h = seed ^ (len * K);
+        size_t i = 0;
+        for (; i + 8 <= len; i += 8) {
+            uint64_t w;
+            std::memcpy(&w, p + i, 8);
+            h = (h ^ w) * K;
+            h ^= h >> 29;
+        }
+        uint64_t tail = 0;
+        std::memcpy(&tail, p + i, len - i);
+        h = (h ^ tail) * K;
+        return h ^ (h >> 32);
+    }
+    
+    constexpr uint64_t INDEX_ALIGN = 64;
+    
+    inline uint64_t alignUp(uint64_t x) {
+        return (x + INDEX_ALIGN - 1) / INDEX_ALIGN * INDEX_ALIGN;
+    }
+    
+    inline uint64_t tableChecksum(IndexHeader header, const IndexSectionEntry* entries) {
+        header.table_checksum = 0;
+        uint64_t h = checksum64(&header, sizeof(header));
+        return checksum64(entries, header.section_count * sizeof(IndexSectionEntry), h);
+    }
+}
+
+// Collects sections and writes them as one index file.
+// Section data is referenced, not copied, and must outlive write().
+class IndexWriter {
+public:
+    void add(IndexSection id, const void* data, size_t bytes) {
+        sections_.push_back({id, data, bytes});
+    }
+    
+    template<typename T>
+    void add(IndexSection id, std::span<const T> data) {
+        add(id, data.data(), data.size_bytes());
+    }
+    
+    void write(const std::string& path) const {
+        IndexHeader header{};
+        std::memcpy(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+        header.version = INDEX_VERSION;
+        header.section_count = sections_.size();
+        
+        std::vector<IndexSectionEntry> entries(sections_.size());
+        uint64_t offset = detail::alignUp(sizeof(IndexHeader) + entries.size() * sizeof(IndexSectionEntry));
+        for (size_t i = 0; i < sections_.size(); i++) {
+            entries[i].id = static_cast<uint32_t>(sections_[i].id);
+            entries[i].offset = offset;
+            entries[i].size = sections_[i].bytes;
+            entries[i].checksum = detail::checksum64(sections_[i].data, sections_[i].bytes);
+            offset = detail::alignUp(offset + sections_[i].bytes);
+        }
+        header.file_size = offset;
+        header.table_checksum = detail::tableChecksum(header, entries.data());
+        
+        // Written beside the target and renamed into place, so an interrupted or
+        // failed write never leaves a truncated index at path
+        std::string tmp = path + ".tmp";
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        if (!out) throw std::runtime_error("Cannot create " + tmp);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(IndexSectionEntry));
+        
+        static const char zeros[detail::INDEX_ALIGN] = {};
+        uint64_t pos = sizeof(header) + entries.size() * sizeof(IndexSectionEntry);
+        for (size_t i = 0; i < sections_.size(); i++) {
+            out.write(zeros, entries[i].offset - pos);
+            out.write(static_cast<const char*>(sections_[i].data), sections_[i].bytes);
+            pos = entries[i].offset + sections_[i].bytes;
+        }
+        out.write(zeros, header.file_size - pos);
+        out.close();
+        if (!out) {
+            std::remove(tmp.c_str());
+            throw std::runtime_error("Failed writing " + tmp);
+        }
+        if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+            std::remove(tmp.c_str());
+            throw std::runtime_error("Cannot rename " + tmp + " to " + path);
+        }
+    }
+    
+private:
+    struct Pending {
+        IndexSection id;
+        const void* data;
+        size_t bytes;
+    };
+    std::vector<Pending> sections_;
+};
+
+// Read-only memory-mapped view of an index file. Pages are shared through
+// the page cache, so concurrent processes mapping the same index share memory.
+class MappedIndex {
+public:
+    explicit MappedIndex(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw std::runtime_error("Cannot open " + path);
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(IndexHeader)) {
+            ::close(fd);
+            throw std::runtime_error(path + " is not an index file");
+        }
+        size_ = st.st_size;
+        void* p = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) throw std::runtime_error("Cannot mmap " + path);
+        base_ = static_cast<const char*>(p);
+        ::madvise(p, size_, MADV_WILLNEED);
+        
+        try {
+            validate(path);
+        } catch (...) {
+            ::munmap(p, size_);
+            throw;
+        }
+    }
+    
+    ~MappedIndex() {
+        if (base_) ::munmap(const_cast<char*>(base_), size_);
+    }
+    
+    MappedIndex(const MappedIndex&) = delete;
+    MappedIndex& operator=(const MappedIndex&) = delete;
+    
+    bool has(IndexSection id) const {
+        return find(id) != nullptr;
+    }
+    
+    std::string_view bytes(IndexSection id) const {
+        const IndexSectionEntry* e = find(id);
+        if (!e) throw std::runtime_error("Index is missing section " + std::to_string((uint32_t)id));
+        return {base_ + e->offset, e->size};
+    }
+    
+    template<typename T>
+    std::span<const T> array(IndexSection id) const {
+        std::string_view b = bytes(id);
+        return {reinterpret_cast<const T*>(b.data()), b.size() / sizeof(T)};
+    }
+    
+    // Check every section payload against its stored checksum (reads the whole file)
+    bool verify() const {
+        for (const IndexSectionEntry& e : entries()) {
+            if (detail::checksum64(base_ + e.offset, e.size) != e.checksum) return false;
+        }
+        return true;
+    }
+    
+private:
+    const char* base_ = nullptr;
+    size_t size_ = 0;
+    
+    const IndexHeader& header() const {
+        return *reinterpret_cast<const IndexHeader*>(base_);
+    }
+    
+    std::span<const IndexSectionEntry> entries() const {
+        return {reinterpret_cast<const IndexSectionEntry*>(base_ + sizeof(IndexHeader)), header().section_count};
+    }
+    
+    const IndexSectionEntry* find(IndexSection id) const {
+        for (const IndexSectionEntry& e : entries()) {
+            if (e.id == static_cast<uint32_t>(id)) return &e;
+        }
+        return nullptr;
+    }
+    
+    void validate(const std::string& path) const {
+        const IndexHeader& h = header();
+        if (std::memcmp(h.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0) {
+            throw std::runtime_error(path + " is not an index file");
+        }
+        if (h.version != INDEX_VERSION) {
+            throw std::runtime_error(path + " has index version " + std::to_string(h.version)
+                                     + ", expected " + std::to_string(INDEX_VERSION) + " (rebuild it)");
+        }
+        if (h.file_size != size_ || sizeof(IndexHeader) + h.section_count * sizeof(IndexSectionEntry) > size_) {
+            throw std::runtime_error(path + " is truncated");
+        }
+        if (detail::tableChecksum(h, entries().data()) != h.table_checksum) {
+            throw std::runtime_error(path + " has a corrupt header");
+        }
+        for (const IndexSectionEntry& e : entries()) {
+            if (e.offset > size_ || e.size > size_ - e.offset) throw std::runtime_error(path + " is truncated");
+        }
+    }
+};
+
+} // namespace bio
@@ -1,128 +1,368 @@
 #pragma once
 
 #include <string>
-#include <unordered_map>
+#include <string_view>
 #include <vector>
 #include <utility>
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+#include "packed_sequence.hpp"
 
 namespace bio {
 
+// 2-bit k-mer kernels
+//
+// A k-mer with k <= 32 is held exactly in a uint64_t as 2-bit codes (A=0,
+// C=1, G=2, T=3), first base in the most significant used bits, so codes of
+// equal k order like the k-mers. Sliding to the next k-mer is a shift, an OR
+// and a mask. K-mers containing N or any other non-ACGT base have no code and
+// are skipped by every function below.
+constexpr int MAX_KMER_K = 32;
+
 namespace detail {
-    inline unsigned long long dnaCharValue(char c) {
-        switch(c) {
-            case 'A': return 0;
-            case 'C': return 1;
-            case 'G': return 2;
-            case 'T': return 3;
-        }
-        return 0;
+    // Invertible integer hash of a key within mask (Thomas Wang's 64-bit mix)
+    inline uint64_t mixHash64(uint64_t key, uint64_t mask) {
+        key = (~key + (key << 21)) & mask;
+        key = key ^ key >> 24;
+        key = (key + (key << 3) + (key << 8)) & mask;
+        key = key ^ key >> 14;
+        key = (key + (key << 2) + (key << 4)) & mask;
+        key = key ^ key >> 28;
+        key = (key + (key << 31)) & mask;
+        return key;
     }
     
-    constexpr unsigned long long KMER_HASH_BASE = 5;
-    constexpr unsigned long long KMER_HASH_MOD = 1000000000000000003ULL;
+    // PackedSequence::baseCode as a table, avoiding a mispredicted branch per base
+    inline constexpr auto BASE_CODE_TABLE = [] {
+        std::array<int8_t, 256> t{};
+        for (int c = 0; c < 256; c++) t[c] = PackedSequence::baseCode(char(c));
+        return t;
+    }();
+    
+    // 2-bit code of base i, -1 if it is not ACGT
+    inline int baseCodeAt(std::string_view s, size_t i) { return BASE_CODE_TABLE[(unsigned char)s[i]]; }
+    inline int baseCodeAt(const PackedSequence& s, size_t i) { return s.isAmbiguous(i) ? -1 : s.code(i); }
+    
+    inline uint64_t kmerMask(int k) {
+        return k >= 32 ? ~uint64_t(0) : (uint64_t(1) << (2 * k)) - 1;
+    }
+    
+    inline void checkKmerSize(int k) {
+        if (k < 1 || k > MAX_KMER_K) {
+            throw std::runtime_error("k-mer size " + std::to_string(k) + " is outside 1.." + std::to_string(MAX_KMER_K));
+        }
+    }
 }
 
-// Compute rolling hash for a k-mer
-inline unsigned long long computeKmerHash(const std::string& kmer) {
-    unsigned long long hash = 0;
+// Code of an ACGT string of up to 32 bases (either case); false if it has
+// another character or is too long
+inline bool encodeKmer(std::string_view kmer, uint64_t& code) {
+    if (kmer.size() > (size_t)MAX_KMER_K) return false;
+    code = 0;
     for (char c : kmer) {
-        hash = (hash * detail::KMER_HASH_BASE + detail::dnaCharValue(c)) % detail::KMER_HASH_MOD;
+        int b = detail::BASE_CODE_TABLE[(unsigned char)c];
+        if (b < 0) return false;
+        code = code << 2 | b;
     }
-    return hash;
+    return true;
 }
 
-// Count frequency of all k-mers in a string
-// Returns map from k-mer hash to (frequency, first_position)
-inline std::unordered_map<unsigned long long, std::pair<int, int>> countKmers(const std::string& s, int k) {
-    std::unordered_map<unsigned long long, std::pair<int, int>> result;
-    
-    int n = s.size();
-    if (k > n) return result;
-    
-    unsigned long long base_pow = 1;
-    for (int i = 0; i < k - 1; i++) {
-        base_pow = (base_pow * detail::KMER_HASH_BASE) % detail::KMER_HASH_MOD;
+inline std::string decodeKmer(uint64_t code, int k) {
+    std::string kmer(k, 'A');
+    for (int i = k - 1; i >= 0; i--, code >>= 2) kmer[i] = "ACGT"[code & 3];
+    return kmer;
+}
+
+inline uint64_t reverseComplementKmer(uint64_t code, int k) {
+    // Complement all bases, then reverse the order of the 2-bit groups
+    uint64_t x = ~code;
+    x = ((x >> 2) & 0x3333333333333333ULL) | ((x & 0x3333333333333333ULL) << 2);
+    x = ((x >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((x & 0x0F0F0F0F0F0F0F0FULL) << 4);
+    return __builtin_bswap64(x) >> (64 - 2 * k);
+}
+
+// The smaller of a k-mer and its reverse complement, the same for both strands
+inline uint64_t canonicalKmer(uint64_t code, int k) {
+    return std::min(code, reverseComplementKmer(code, k));
+}
+
+namespace detail {
+    template<typename Sequence, typename F>
+    void forEachKmer(const Sequence& s, int k, bool canonical, F&& f) {
+        checkKmerSize(k);
+        uint64_t mask = kmerMask(k);
+        int shift = 2 * (k - 1);
+        uint64_t fwd = 0, rev = 0;
+        int valid = 0;  // consecutive ACGT bases ending at i
+        for (size_t i = 0; i < s.size(); i++) {
+            int c = baseCodeAt(s, i);
+            if (c < 0) {
+                valid = 0;
+                continue;
+            }
+            fwd = (fwd << 2 | c) & mask;
+            rev = rev >> 2 | uint64_t(3 - c) << shift;
+            if (++valid >= k) f(canonical ? std::min(fwd, rev) : fwd, i + 1 - k);
+        }
     }
-    
-    // Initial hash
-    unsigned long long hash = 0;
-    for (int i = 0; i < k; i++) {
-        hash = (hash * detail::KMER_HASH_BASE + detail::dnaCharValue(s[i])) % detail::KMER_HASH_MOD;
+}
+
+// Call f(code, pos) for every k-mer of s without non-ACGT bases, in order;
+// with canonical, code is canonicalKmer() of the k-mer. Throws for k outside 1..32.
+template<typename F>
+void forEachKmer(std::string_view s, int k, bool canonical, F&& f) {
+    detail::forEachKmer(s, k, canonical, f);
+}
+
+template<typename F>
+void forEachKmer(const PackedSequence& s, int k, bool canonical, F&& f) {
+    detail::forEachKmer(s, k, canonical, f);
+}
+
+// K-mer counts in an open-addressing table
+//
+// Slots hold a k-mer code and its count (0 = empty slot, so every code
+// including all-T k = 32 is a valid key) and are probed linearly from a
+// multiplicative hash of the code. The table doubles at 70% load, so it is
+// 35-70% full; one slot is 16 bytes, so a distinct k-mer takes 23-46 bytes.
+class KmerCountTable {
+public:
+    explicit KmerCountTable(size_t expected = 0) {
+        int bits = 4;
+        while ((size_t(1) << bits) * 7 / 10 < expected) bits++;
+        allocate(bits);
     }
-    result[hash] = {1, 0};
     
-    // Rolling hash
-    for (int i = 1; i <= n - k; i++) {
-        hash = (hash + detail::KMER_HASH_MOD - (detail::dnaCharValue(s[i-1]) * base_pow) % detail::KMER_HASH_MOD) % detail::KMER_HASH_MOD;
-        hash = (hash * detail::KMER_HASH_BASE + detail::dnaCharValue(s[i+k-1])) % detail::KMER_HASH_MOD;
-        
-        auto it = result.find(hash);
-        if (it == result.end()) {
-            result[hash] = {1, i};
-        } else {
-            it->second.first++;
+    // Add n occurrences of kmer; returns its new count
+    uint32_t add(uint64_t kmer, uint32_t n = 1) {
+        if (size_ + 1 > limit_) allocate(bits_ + 1);
+        Slot& slot = slots_[slotOf(kmer)];
+        if (slot.count == 0) {
+            slot.kmer = kmer;
+            size_++;
         }
+        slot.count += n;
+        return slot.count;
     }
     
-    return result;
-}
-
-// Find the most frequent k-mer in a string
-// Returns pair of (k-mer string, frequency)
-inline std::pair<std::string, int> findMostFrequentKmer(const std::string& s, int k) {
-    int n = s.size();
-    if (k > n) return {s, 1};
+    uint32_t count(uint64_t kmer) const {
+        return slots_[slotOf(kmer)].count;
+    }
+    
+    // Distinct k-mers
+    size_t size() const { return size_; }
     
-    unsigned long long base_pow = 1;
-    for (int i = 0; i < k - 1; i++) {
-        base_pow = (base_pow * detail::KMER_HASH_BASE) % detail::KMER_HASH_MOD;
+    // Call f(kmer, count) for every distinct k-mer, in no particular order
+    template<typename F>
+    void forEach(F&& f) const {
+        for (const Slot& slot : slots_) {
+            if (slot.count) f(slot.kmer, slot.count);
+        }
     }
     
-    unsigned long long hash = 0;
-    for (int i = 0; i < k; i++) {
-        hash = (hash * detail::KMER_HASH_BASE + detail::dnaCharValue(s[i])) % detail::KMER_HASH_MOD;
+    void merge(const KmerCountTable& other) {
+        other.forEach([&](uint64_t kmer, uint32_t n) { add(kmer, n); });
     }
     
-    std::unordered_map<unsigned long long, int> freq;
-    std::unordered_map<unsigned long long, int> first_pos;
+    size_t memoryBytes() const { return slots_.size() * sizeof(Slot); }
+
+private:
+    struct Slot {
+        uint64_t kmer;
+        uint32_t count;
+    };
     
-    freq[hash] = 1;
-    first_pos[hash] = 0;
+    std::vector<Slot> slots_;
+    size_t size_ = 0, limit_ = 0;
+    int bits_ = 0;
     
-    int max_freq = 1;
-    unsigned long long best_hash = hash;
-    int best_pos = 0;
+    // Slot holding kmer, or the empty slot where it belongs
+    size_t slotOf(uint64_t kmer) const {
+        size_t mask = slots_.size() - 1;
+        size_t i = (kmer * 0x9E3779B97F4A7C15ULL) >> (64 - bits_);
+        while (slots_[i].count && slots_[i].kmer != kmer) i = (i + 1) & mask;
+        return i;
+    }
     
-    for (int i = 1; i <= n - k; i++) {
-        hash = (hash + detail::KMER_HASH_MOD - (detail::dnaCharValue(s[i-1]) * base_pow) % detail::KMER_HASH_MOD) % detail::KMER_HASH_MOD;
-        hash = (hash * detail::KMER_HASH_BASE + detail::dnaCharValue(s[i+k-1])) % detail::KMER_HASH_MOD;
-        freq[hash]++;
-        
-        if (first_pos.find(hash) == first_pos.end()) {
-            first_pos[hash] = i;
+    void allocate(int bits) {
+        std::vector<Slot> old = std::move(slots_);
+        slots_.assign(size_t(1) << bits, Slot{0, 0});
+        bits_ = bits;
+        limit_ = slots_.size() * 7 / 10;
+        for (const Slot& slot : old) {
+            if (slot.count) slots_[slotOf(slot.kmer)] = slot;
         }
+    }
+};
+
+namespace detail {
+    template<typename Sequence>
+    KmerCountTable countKmers(const Sequence& s, int k, bool canonical) {
+        checkKmerSize(k);
+        size_t kmers = s.size() >= (size_t)k ? s.size() - k + 1 : 0;
+        // No more distinct k-mers than positions or than 4^k
+        if (k < 32) kmers = std::min<size_t>(kmers, size_t(1) << std::min(2 * k, 40));
+        KmerCountTable table(kmers);
+        forEachKmer(s, k, canonical, [&](uint64_t code, size_t) { table.add(code); });
+        return table;
+    }
+    
+    template<typename Sequence>
+    std::pair<std::string, int> findMostFrequentKmer(const Sequence& s, int k, bool canonical) {
+        int n = s.size();
+        if (k > n) return {std::string(s.substr(0, n)), 1};
         
-        if (freq[hash] > max_freq) {
-            max_freq = freq[hash];
-            best_hash = hash;
-            best_pos = first_pos[hash];
+        KmerCountTable table(n - k + 1);
+        uint32_t max_freq = 0;
+        uint64_t best = 0;
+        // The first k-mer to reach the highest count wins ties
+        forEachKmer(s, k, canonical, [&](uint64_t code, size_t) {
+            uint32_t freq = table.add(code);
+            if (freq > max_freq) {
+                max_freq = freq;
+                best = code;
+            }
+        });
+        if (max_freq == 0) return {"", 0};
+        return {decodeKmer(best, k), (int)max_freq};
+    }
+}
+
+// Count all k-mers (k <= 32) of a sequence, optionally canonical
+inline KmerCountTable countKmers(std::string_view s, int k, bool canonical = false) {
+    return detail::countKmers(s, k, canonical);
+}
+
+inline KmerCountTable countKmers(const PackedSequence& s, int k, bool canonical = false) {
+    return detail::countKmers(s, k, canonical);
+}
+
+// Find the most frequent k-mer in a string
+// Returns pair of (k-mer string, frequency); with canonical, the k-mer is the
+// canonical form and the frequency counts both strands
+inline std::pair<std::string, int> findMostFrequentKmer(std::string_view s, int k, bool canonical = false) {
+    return detail::findMostFrequentKmer(s, k, canonical);
+}
+
+inline std::pair<std::string, int> findMostFrequentKmer(const PackedSequence& s, int k, bool canonical = false) {
+    return detail::findMostFrequentKmer(s, k, canonical);
+}
+
+namespace detail {
+    template<typename Sequence>
+    std::vector<std::string> extractKmers(const Sequence& s, int k) {
+        std::vector<std::string> result;
+        int n = s.size();
+        if (k > n) return result;
+        
+        result.reserve(n - k + 1);
+        for (int i = 0; i <= n - k; i++) {
+            result.push_back(s.substr(i, k));
         }
+        return result;
     }
-    
-    return {s.substr(best_pos, k), max_freq};
 }
 
 // Get all k-mers from a string as vector of strings
 inline std::vector<std::string> extractKmers(const std::string& s, int k) {
-    std::vector<std::string> result;
-    int n = s.size();
-    if (k > n) return result;
-    
-    result.reserve(n - k + 1);
-    for (int i = 0; i <= n - k; i++) {
-        result.push_back(s.substr(i, k));
+    return detail::extractKmers(s, k);
+}
+
+inline std::vector<std::string> extractKmers(const PackedSequence& s, int k) {
+    return detail::extractKmers(s, k);
+}
+
+// (w,k)-minimizers
+//
+// Of every w consecutive k-mers (k <= 31), the one with the smallest hash is
+// selected. K-mers are rolled as 2-bit codes on both strands and hashed in
+// canonical form (the smaller of the k-mer and its reverse complement), so a
+// sequence and its reverse complement select the same minimizers. The hash is
+// an invertible integer mix of the code rather than the code itself, so
+// low-complexity k-mers (poly-A) are not systematically selected.
+// K-mers containing non-ACGT bases are skipped and restart the window;
+// palindromic k-mers (strand undefined) are skipped.
+struct Minimizer {
+    uint64_t hash;
+    uint32_t pos;   // start of the k-mer in the sequence
+    bool reverse;   // the canonical k-mer is the reverse complement of the sequence's
+};
+
+namespace detail {
+    template<typename Sequence>
+    void computeMinimizers(const Sequence& s, int k, int w, std::vector<Minimizer>& out) {
+        out.clear();
+        size_t n = s.size();
+        if (k <= 0 || k > 31 || w <= 0 || n < (size_t)k) return;
+        
+        uint64_t mask = (uint64_t(1) << (2 * k)) - 1;
+        int shift = 2 * (k - 1);
+        uint64_t fwd = 0, rev = 0;
+        int valid = 0;       // consecutive ACGT bases ending at i
+        long long kmers = 0; // k-mers since the last restart
+        // The last w k-mers in a ring buffer (no allocation per call) and the
+        // leftmost smallest among them; the ring is rescanned only when that
+        // one leaves the window, which keeps the loop nearly branch-free.
+        // Palindromes are kept as NONE so that the ring stays in step.
+        const uint64_t NONE = ~uint64_t(0);
+        w = std::min(w, 256);
+        Minimizer window[256];
+        int slot = 0;        // oldest entry once the ring is full
+        Minimizer best{NONE, 0, false};
+        
+        uint32_t last_pos = UINT32_MAX;
+        auto emit = [&](const Minimizer& m) {
+            if (m.pos != last_pos) out.push_back(m);
+            last_pos = m.pos;
+        };
+        auto restart = [&] {
+            // A run shorter than one window still contributes its minimum
+            if (kmers > 0 && kmers < w && best.hash != NONE) emit(best);
+            best = {NONE, 0, false};
+            slot = 0;
+            kmers = 0;
+        };
+        
+        for (size_t i = 0; i < n; i++) {
+            int c = baseCodeAt(s, i);
+            if (c < 0) {
+                valid = 0;
+                restart();
+                continue;
+            }
+            fwd = (fwd << 2 | c) & mask;
+            rev = rev >> 2 | uint64_t(3 - c) << shift;
+            if (++valid < k) continue;
+            
+            uint32_t pos = i + 1 - k;
+            kmers++;
+            Minimizer m{fwd != rev ? mixHash64(std::min(fwd, rev), mask) : NONE, pos, rev < fwd};
+            window[slot] = m;
+            slot = slot + 1 == w ? 0 : slot + 1;
+            if (m.hash < best.hash) {
+                best = m;
+            } else if (best.hash != NONE && best.pos + w <= pos) {
+                // The minimum left the window [pos - w + 1, pos]; scan oldest first
+                best = {NONE, 0, false};
+                for (int j = 0, idx = slot; j < w; j++, idx = idx + 1 == w ? 0 : idx + 1) {
+                    if (window[idx].hash < best.hash) best = window[idx];
+                }
+            }
+            if (kmers >= w && best.hash != NONE) emit(best);
+        }
+        restart();
     }
-    return result;
+}
+
+// Minimizers of s in order of position (overwrites out)
+inline void computeMinimizers(std::string_view s, int k, int w, std::vector<Minimizer>& out) {
+    detail::computeMinimizers(s, k, w, out);
+}
+
+inline void computeMinimizers(const PackedSequence& s, int k, int w, std::vector<Minimizer>& out) {
+    detail::computeMinimizers(s, k, w, out);
 }
 
 } // namespace bio
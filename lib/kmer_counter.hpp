@@ -0,0 +1,110 @@
+#pragma once
+
+#include <string_view>
+#include <vector>
+#include <mutex>
+#include <cstdint>
+#include "kmer.hpp"
+
+namespace bio {
+
+// Multithreaded k-mer counter for large read sets
+//
+// K-mers are split by hash into independent partitions, each a KmerCountTable
+// behind its own mutex. Every counting thread owns a Writer that stages k-mers
+// per partition and flushes a partition's buffer under its lock once it fills,
+// so threads rarely contend and never share a cache line while counting. The
+// partition tables grow independently; nothing is merged at the end.
+class PartitionedKmerCounter {
+public:
+    PartitionedKmerCounter(int k, bool canonical, int partition_bits = 8)
+        : k_(k), canonical_(canonical), partitions_(size_t(1) << partition_bits) {
+        detail::checkKmerSize(k);
+    }
+    
+    // Per-thread staging buffers; flushed on destruction
+    class Writer {
+    public:
+        explicit Writer(PartitionedKmerCounter& counter)
+            : counter_(counter), buffers_(counter.partitions_.size()) {
+            for (auto& buffer : buffers_) buffer.reserve(FLUSH_KMERS);
+        }
+        
+        ~Writer() { flush(); }
+        
+        Writer(const Writer&) = delete;
+        Writer& operator=(const Writer&) = delete;
+        
+        void add(std::string_view sequence) {
+            forEachKmer(sequence, counter_.k_, counter_.canonical_, [&](uint64_t code, size_t) {
+                size_t p = counter_.partitionOf(code);
+                buffers_[p].push_back(code);
+                if (buffers_[p].size() == FLUSH_KMERS) flush(p);
+            });
+        }
+        
+        void flush() {
+            for (size_t p = 0; p < buffers_.size(); p++) flush(p);
+        }
+    
+    private:
+        static constexpr size_t FLUSH_KMERS = 4096;
+        
+        PartitionedKmerCounter& counter_;
+        std::vector<std::vector<uint64_t>> buffers_;
+        
+        void flush(size_t p) {
+            if (buffers_[p].empty()) return;
+            Partition& partition = counter_.partitions_[p];
+            std::lock_guard<std::mutex> lock(partition.m);
+            for (uint64_t code : buffers_[p]) partition.table.add(code);
+            buffers_[p].clear();
+        }
+    };
+    
+    int k() const { return k_; }
+    bool canonical() const { return canonical_; }
+    
+    // Queries below are meant for after all Writers are gone
+    uint32_t count(uint64_t kmer) const {
+        return partitions_[partitionOf(kmer)].table.count(kmer);
+    }
+    
+    // Distinct k-mers
+    size_t size() const {
+        size_t n = 0;
+        for (const Partition& p : partitions_) n += p.table.size();
+        return n;
+    }
+    
+    // Call f(kmer, count) for every distinct k-mer, partition by partition
+    template<typename F>
+    void forEach(F&& f) const {
+        for (const Partition& p : partitions_) p.table.forEach(f);
+    }
+    
+    size_t memoryBytes() const {
+        size_t n = 0;
+        for (const Partition& p : partitions_) n += p.table.memoryBytes();
+        return n;
+    }
+
+private:
+    // Aligned so that neighbouring partitions' locks do not share a cache line
+    struct alignas(64) Partition {
+        std::mutex m;
+        KmerCountTable table;
+    };
+    
+    int k_;
+    bool canonical_;
+    std::vector<Partition> partitions_;
+    
+    // Low bits of a full 64-bit mix; the tables index by the high bits of a
+    // multiplicative hash, so keys within a partition still spread evenly
+    size_t partitionOf(uint64_t kmer) const {
+        return detail::mixHash64(kmer, ~uint64_t(0)) & (partitions_.size() - 1);
+    }
+};
+
+} // namespace bio
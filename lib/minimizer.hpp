@@ -0,0 +1,100 @@
+#pragma once
+
+#include <string_view>
+#include <vector>
+#include <span>
+#include <algorithm>
+#include <cstdint>
+#include "kmer.hpp"
+#include "packed_sequence.hpp"
+
+namespace bio {
+
+// Hash index of the (w,k)-minimizers of a reference
+//
+// Entries are sorted by minimizer hash; a direct-indexed bucket table on the
+// top hash bits narrows each lookup to a few entries. Each entry stores the
+// reference position and strand of the minimizer as pos << 1 | reverse
+// (references must be shorter than 2^31). Takes ~12 bytes per minimizer plus
+// the bucket table, about 3 bytes per base for w = 10.
+class MinimizerIndex {
+public:
+    MinimizerIndex() = default;
+    
+    MinimizerIndex(std::string_view text, int k, int w) : k_(k), w_(w) {
+        std::vector<Minimizer> mins;
+        computeMinimizers(text, k, w, mins);
+        build(mins);
+    }
+    
+    MinimizerIndex(const PackedSequence& text, int k, int w) : k_(k), w_(w) {
+        std::vector<Minimizer> mins;
+        computeMinimizers(text, k, w, mins);
+        build(mins);
+    }
+    
+    // Occurrences (pos << 1 | reverse) of the minimizer with this hash
+    std::span<const uint32_t> find(uint64_t hash) const {
+        if (hashes_.empty()) return {};
+        uint64_t b = hash >> shift_;
+        auto first = hashes_.begin() + buckets_[b];
+        auto last = hashes_.begin() + buckets_[b + 1];
+        auto [lo, hi] = std::equal_range(first, last, hash);
+        return {positions_.data() + (lo - hashes_.begin()), size_t(hi - lo)};
+    }
+    
+    // find() for each of a batch of minimizers, out[i] for mins[i]. The
+    // bucket and entry loads of the whole batch are prefetched in two rounds
+    // so that their cache misses overlap.
+    void findAll(std::span<const Minimizer> mins, std::span<std::span<const uint32_t>> out) const {
+        if (hashes_.empty()) {
+            std::fill(out.begin(), out.end(), std::span<const uint32_t>());
+            return;
+        }
+        for (const Minimizer& m : mins) __builtin_prefetch(&buckets_[m.hash >> shift_]);
+        for (const Minimizer& m : mins) {
+            uint32_t first = buckets_[m.hash >> shift_];
+            __builtin_prefetch(&hashes_[first]);
+            __builtin_prefetch(&positions_[first]);
+        }
+        for (size_t i = 0; i < mins.size(); i++) out[i] = find(mins[i].hash);
+    }
+    
+    int k() const { return k_; }
+    int w() const { return w_; }
+    size_t size() const { return hashes_.size(); }
+    
+    size_t memoryBytes() const {
+        return hashes_.size() * sizeof(uint64_t) + positions_.size() * sizeof(uint32_t) +
+               buckets_.size() * sizeof(uint32_t);
+    }
+
+private:
+    int k_ = 0, w_ = 0;
+    int shift_ = 0;
+    std::vector<uint32_t> buckets_;    // buckets_[b]: first entry whose hash >> shift_ is b
+    std::vector<uint64_t> hashes_;     // sorted
+    std::vector<uint32_t> positions_;  // pos << 1 | reverse, parallel to hashes_
+    
+    void build(std::vector<Minimizer>& mins) {
+        std::sort(mins.begin(), mins.end(), [](const Minimizer& a, const Minimizer& b) {
+            return a.hash != b.hash ? a.hash < b.hash : a.pos < b.pos;
+        });
+        hashes_.resize(mins.size());
+        positions_.resize(mins.size());
+        for (size_t i = 0; i < mins.size(); i++) {
+            hashes_[i] = mins[i].hash;
+            positions_[i] = mins[i].pos << 1 | mins[i].reverse;
+        }
+        
+        // About one entry per bucket
+        int hash_bits = 2 * k_, bucket_bits = 1;
+        while (bucket_bits < hash_bits && (size_t(1) << bucket_bits) < mins.size()) bucket_bits++;
+        shift_ = hash_bits - bucket_bits;
+        buckets_.assign((size_t(1) << bucket_bits) + 1, 0);
+        for (uint64_t h : hashes_) buckets_[(h >> shift_) + 1]++;
+        for (size_t b = 1; b < buckets_.size(); b++) buckets_[b] += buckets_[b - 1];
+    }
+};
+
+} // namespace bio
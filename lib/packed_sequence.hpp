@@ -0,0 +1,267 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <span>
+#include <cstdint>
+#include <bit>
+#include <algorithm>
+
+namespace bio {
+
+// 2-bit packed nucleotide sequence
+//
+// Bases are stored 32 per 64-bit word as A=0, C=1, G=2, T=3 with the first
+// base in the most significant bits, so comparing words numerically compares
+// 32 bases lexicographically. Non-ACGT bases are stored as A and flagged in a
+// side bitmap (allocated only if there are any); they decode as 'N'. Lowercase
+// bases are packed as uppercase. Takes n/4 bytes (+ n/8 with ambiguous bases).
+//
+// A PackedSequence either owns its words or views external memory (e.g. a
+// memory-mapped index); it can be moved but not copied.
+class PackedSequence {
+public:
+    PackedSequence() = default;
+    
+    explicit PackedSequence(std::string_view s) : n_(s.size()) {
+        words_storage_.assign((n_ + 31) / 32, 0);
+        for (size_t i = 0; i < n_; i++) {
+            int c = baseCode(s[i]);
+            if (c < 0) {
+                if (ambiguous_storage_.empty()) ambiguous_storage_.assign((n_ + 63) / 64, 0);
+                ambiguous_storage_[i / 64] |= 1ULL << (i % 64);
+                c = 0;
+            }
+            words_storage_[i / 32] |= (uint64_t)c << (62 - 2 * (i % 32));
+        }
+        words_ = words_storage_;
+        ambiguous_ = ambiguous_storage_;
+    }
+    
+    // Non-owning view over packed words and ambiguity bitmap (empty if none)
+    static PackedSequence view(size_t n, std::span<const uint64_t> words, std::span<const uint64_t> ambiguous) {
+        PackedSequence p;
+        p.n_ = n;
+        p.words_ = words;
+        p.ambiguous_ = ambiguous;
+        return p;
+    }
+    
+    PackedSequence(PackedSequence&&) = default;
+    PackedSequence& operator=(PackedSequence&&) = default;
+    PackedSequence(const PackedSequence&) = delete;
+    PackedSequence& operator=(const PackedSequence&) = delete;
+    
+    size_t size() const { return n_; }
+    
+    // 2-bit code of base i (ambiguous bases read as 0)
+    int code(size_t i) const {
+        return words_[i / 32] >> (62 - 2 * (i % 32)) & 3;
+    }
+    
+    bool isAmbiguous(size_t i) const {
+        return !ambiguous_.empty() && (ambiguous_[i / 64] >> (i % 64) & 1);
+    }
+    
+    // Base i as a character: 'A', 'C', 'G', 'T' or 'N'
+    char operator[](size_t i) const {
+        return isAmbiguous(i) ? 'N' : "ACGT"[code(i)];
+    }
+    
+    // True if any base in [pos, pos + len) is ambiguous
+    bool hasAmbiguous(size_t pos, size_t len) const {
+        if (ambiguous_.empty() || len == 0) return false;
+        size_t end = std::min(pos + len, n_);
+        for (size_t w = pos / 64; w * 64 < end; w++) {
+            uint64_t bits = ambiguous_[w];
+            if (w == pos / 64) bits &= ~0ULL << (pos % 64);
+            if ((w + 1) * 64 > end && end % 64) bits &= (1ULL << (end % 64)) - 1;
+            if (bits) return true;
+        }
+        return false;
+    }
+    
+    // 32 bases starting at pos, first base in the top bits; zero past the end
+    uint64_t word(size_t pos) const {
+        size_t w = pos / 32, off = pos % 32;
+        if (w >= words_.size()) return 0;
+        uint64_t x = words_[w] << (2 * off);
+        if (off && w + 1 < words_.size()) x |= words_[w + 1] >> (64 - 2 * off);
+        return x;
+    }
+    
+    // Hint the cache to load the words that word(pos) reads
+    void prefetch(size_t pos) const {
+        size_t w = pos / 32;
+        if (w < words_.size()) __builtin_prefetch(&words_[w]);
+        if (w + 1 < words_.size()) __builtin_prefetch(&words_[w + 1]);
+    }
+    
+    // Decode [pos, pos + len) into out
+    void extract(size_t pos, size_t len, char* out) const {
+        len = pos >= n_ ? 0 : std::min(len, n_ - pos);
+        for (size_t i = 0; i < len; i += 32) {
+            uint64_t x = word(pos + i);
+            size_t k = std::min<size_t>(32, len - i);
+            for (size_t j = 0; j < k; j++) {
+                out[i + j] = "ACGT"[x >> 62];
+                x <<= 2;
+            }
+        }
+        if (hasAmbiguous(pos, len)) {
+            for (size_t i = 0; i < len; i++) {
+                if (isAmbiguous(pos + i)) out[i] = 'N';
+            }
+        }
+    }
+    
+    std::string substr(size_t pos, size_t len) const {
+        len = pos >= n_ ? 0 : std::min(len, n_ - pos);
+        std::string s(len, 'N');
+        extract(pos, len, s.data());
+        return s;
+    }
+    
+    std::string unpack() const { return substr(0, n_); }
+    
+    // Like std::string::compare(pos, len, other): compares [pos, pos + len)
+    // (clamped to the end) with all of other, 32 bases per step. Ranges with
+    // ambiguous bases fall back to per-character comparison in ASCII order.
+    int compare(size_t pos, size_t len, const PackedSequence& other) const {
+        size_t a_len = pos >= n_ ? 0 : std::min(len, n_ - pos);
+        size_t b_len = other.size();
+        size_t common = std::min(a_len, b_len);
+        
+        if (hasAmbiguous(pos, common) || other.hasAmbiguous(0, common)) {
+            for (size_t i = 0; i < common; i++) {
+                unsigned char a = (*this)[pos + i], b = other[i];
+                if (a != b) return a < b ? -1 : 1;
+            }
+        } else {
+            for (size_t i = 0; i < common; i += 32) {
+                uint64_t a = word(pos + i), b = other.word(i);
+                size_t k = std::min<size_t>(32, common - i);
+                if (k < 32) {
+                    uint64_t mask = ~0ULL << (64 - 2 * k);
+                    a &= mask;
+                    b &= mask;
+                }
+                if (a != b) return a < b ? -1 : 1;
+            }
+        }
+        return a_len < b_len ? -1 : a_len > b_len ? 1 : 0;
+    }
+    
+    // Length of the common prefix of the suffixes at pos and other[other_pos],
+    // given that their first `from` bases are already known to match. Compares
+    // 32 bases per step; words holding ambiguous bases are compared per base.
+    size_t commonPrefix(size_t pos, const PackedSequence& other, size_t other_pos, size_t from = 0) const {
+        size_t limit = std::min(n_ - std::min(pos, n_), other.n_ - std::min(other_pos, other.n_));
+        bool any_ambiguous = !ambiguous_.empty() || !other.ambiguous_.empty();
+        size_t i = from;
+        while (i < limit) {
+            size_t k = std::min<size_t>(32, limit - i);
+            if (any_ambiguous && (hasAmbiguous(pos + i, k) || other.hasAmbiguous(other_pos + i, k))) {
+                for (size_t j = 0; j < k; j++, i++) {
+                    if ((*this)[pos + i] != other[other_pos + i]) return i;
+                }
+                continue;
+            }
+            uint64_t diff = word(pos + i) ^ other.word(other_pos + i);
+            if (k < 32) diff &= ~0ULL << (64 - 2 * k);
+            if (diff) return i + std::countl_zero(diff) / 2;
+            i += k;
+        }
+        return limit;
+    }
+    
+    // Length of the common prefix of the suffix at pos and s, a plain text
+    // whose non-ACGT characters (like the ambiguous bases here) match nothing.
+    // Packs s on the fly and compares 32 bases per step.
+    size_t commonPrefix(size_t pos, std::string_view s) const {
+        size_t limit = std::min(n_ - std::min(pos, n_), s.size());
+        size_t i = 0;
+        while (i < limit) {
+            size_t k = std::min<size_t>(32, limit - i), valid = 0;
+            uint64_t packed = 0;
+            for (; valid < k; valid++) {
+                int c = baseCode(s[i + valid]);
+                if (c < 0) break;
+                packed |= (uint64_t)c << (62 - 2 * valid);
+            }
+            if (hasAmbiguous(pos + i, valid)) {
+                size_t j = 0;
+                while (!isAmbiguous(pos + i + j)) j++;
+                valid = j;
+            }
+            uint64_t diff = valid ? (word(pos + i) ^ packed) & ~0ULL << (64 - 2 * valid) : 0;
+            if (diff) return i + std::countl_zero(diff) / 2;
+            i += valid;
+            if (valid < k) return i;
+        }
+        return limit;
+    }
+    
+    // Reverse complement, computed a word at a time
+    PackedSequence reverseComplement() const {
+        PackedSequence rc;
+        rc.n_ = n_;
+        rc.words_storage_.assign(words_.size(), 0);
+        for (size_t i = 0; i < rc.words_storage_.size(); i++) {
+            // RC bases [32i, 32i + 32) are the complements of original bases
+            // [n - 32i - 32, n - 32i) in reverse order
+            long long start = (long long)n_ - 32 * (long long)(i + 1);
+            uint64_t x = start >= 0 ? word(start) : word(0) >> (2 * -start);
+            x = ~reverseBasePairs(x);
+            size_t valid = std::min<size_t>(32, n_ - 32 * i);
+            if (valid < 32) x &= ~0ULL << (64 - 2 * valid);
+            rc.words_storage_[i] = x;
+        }
+        if (!ambiguous_.empty()) {
+            rc.ambiguous_storage_.assign(ambiguous_.size(), 0);
+            for (size_t w = 0; w < ambiguous_.size(); w++) {
+                for (uint64_t bits = ambiguous_[w]; bits; bits &= bits - 1) {
+                    size_t i = n_ - 1 - (w * 64 + std::countr_zero(bits));
+                    rc.ambiguous_storage_[i / 64] |= 1ULL << (i % 64);
+                }
+            }
+        }
+        rc.words_ = rc.words_storage_;
+        rc.ambiguous_ = rc.ambiguous_storage_;
+        return rc;
+    }
+    
+    // Raw storage, e.g. for writing to an index file
+    std::span<const uint64_t> words() const { return words_; }
+    std::span<const uint64_t> ambiguityBits() const { return ambiguous_; }
+    
+    size_t memoryBytes() const {
+        return (words_.size() + ambiguous_.size()) * sizeof(uint64_t);
+    }
+    
+    // 2-bit code of an ACGT character (either case), -1 otherwise
+    static constexpr int baseCode(char c) {
+        switch (c) {
+            case 'A': case 'a': return 0;
+            case 'C': case 'c': return 1;
+            case 'G': case 'g': return 2;
+            case 'T': case 't': return 3;
+        }
+        return -1;
+    }
+
+private:
+    size_t n_ = 0;
+    std::vector<uint64_t> words_storage_, ambiguous_storage_;
+    std::span<const uint64_t> words_, ambiguous_;
+    
+    // Reverse the order of the 32 2-bit groups in a word
+    static uint64_t reverseBasePairs(uint64_t x) {
+        x = ((x >> 2) & 0x3333333333333333ULL) | ((x & 0x3333333333333333ULL) << 2);
+        x = ((x >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((x & 0x0F0F0F0F0F0F0F0FULL) << 4);
+        return __builtin_bswap64(x);
+    }
+};
+
+} // namespace bio
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <thread>
+#include <bit>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Profiling is compiled in unless built with -DBIO_PROFILE=0; counting heap
+// allocations replaces the global operator new, so it takes
+// -DBIO_PROFILE_ALLOCATIONS=1 as well
+#ifndef BIO_PROFILE
+#define BIO_PROFILE 1
+#endif
+#ifndef BIO_PROFILE_ALLOCATIONS
+#define BIO_PROFILE_ALLOCATIONS 0
+#endif
+
+namespace bio {
+
+// Building blocks for hot-path instrumentation
+//
+// Callers keep plain per-thread counters and guard every update with
+// `if constexpr (PROFILE_ENABLED)`, so a build with profiling off contains no
+// trace of it. Timestamps are raw CPU ticks (the TSC on x86, a few ns to read)
+// that are converted to seconds only when reporting.
+
+inline constexpr bool PROFILE_ENABLED = BIO_PROFILE != 0;
+
+namespace detail {
+    inline uint64_t rawTicks() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+    }
+}
+
+// Current tick count; 0 when profiling is compiled out
+inline uint64_t profileTicks() {
+    if constexpr (!PROFILE_ENABLED) return 0;
+    return detail::rawTicks();
+}
+
+// Heap allocations made by the calling thread. Counted only in a build with
+// -DBIO_PROFILE_ALLOCATIONS=1 (and profiling on) whose program expands
+// BIO_COUNT_ALLOCATIONS() once at namespace scope, which then replaces the
+// global operator new; otherwise the macro defines nothing and the count
+// stays 0.
+inline thread_local uint64_t thread_allocations = 0;
+
+inline constexpr bool ALLOCATIONS_COUNTED = PROFILE_ENABLED && BIO_PROFILE_ALLOCATIONS != 0;
+
+#if BIO_PROFILE && BIO_PROFILE_ALLOCATIONS
+// (All out of line: inlined, GCC warns that free() and sized delete get
+// memory from malloc)
+#define BIO_COUNT_ALLOCATIONS()                                                      \
+    __attribute__((noinline)) void* operator new(std::size_t size) {                 \
+        bio::thread_allocations++;                                                   \
+        if (void* p = std::malloc(size ? size : 1)) return p;                        \
+        throw std::bad_alloc();                                                      \
+    }                                                                                \
+    __attribute__((noinline)) void operator delete(void* p) noexcept { std::free(p); } \
+    __attribute__((noinline)) void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+#else
+#define BIO_COUNT_ALLOCATIONS()
+#endif
+
+// Ticks per second, measured against steady_clock since the first call: call
+// once at startup and again when reporting, so the two are far apart
+inline double profileTicksPerSecond() {
+    static const auto clock_start = std::chrono::steady_clock::now();
+    static const uint64_t ticks_start = detail::rawTicks();
+    auto elapsed = std::chrono::steady_clock::now() - clock_start;
+    if (elapsed < std::chrono::milliseconds(10)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10) - elapsed);
+        elapsed = std::chrono::steady_clock::now() - clock_start;
+    }
+    return (detail::rawTicks() - ticks_start) / std::chrono::duration<double>(elapsed).count();
+}
+
+// Log-linear histogram of non-negative values (e.g. latencies in ns): values
+// below 8 get a bucket each, larger ones 8 buckets per power of two, so a
+// bucket spans at most 1/8 of its lower bound. 4 KB, mergeable.
+class LogHistogram {
+public:
+    static constexpr int SUB_BUCKETS = 8;
+    static constexpr int NUM_BUCKETS = (64 - 2) * SUB_BUCKETS;
+    
+    void add(uint64_t value) {
+        buckets_[bucketOf(value)]++;
+        count_++;
+        sum_ += value;
+        max_ = std::max(max_, value);
+    }
+    
+    void merge(const LogHistogram& other) {
+        for (int i = 0; i < NUM_BUCKETS; i++) buckets_[i] += other.buckets_[i];
+        count_ += other.count_;
+        sum_ += other.sum_;
+        max_ = std::max(max_, other.max_);
+    }
+    
+    uint64_t count() const { return count_; }
+    uint64_t max() const { return max_; }
+    double mean() const { return count_ ? (double)sum_ / count_ : 0; }
+    
+    // Upper bound of the bucket holding the q-quantile (0 <= q <= 1)
+    uint64_t quantile(double q) const {
+        uint64_t target = q * count_, seen = 0;
+        for (int i = 0; i < NUM_BUCKETS; i++) {
+            seen += buckets_[i];
+            if (seen > target) return std::min(bucketEnd(i) - 1, max_);
+        }
+        return max_;
+    }
+    
+    // Call f(lo, hi, count) for each non-empty bucket [lo, hi), in order
+    template<typename F>
+    void forEachBucket(F&& f) const {
+        for (int i = 0; i < NUM_BUCKETS; i++) {
+            if (buckets_[i]) f(bucketStart(i), bucketEnd(i), buckets_[i]);
+        }
+    }
+
+private:
+    std::array<uint64_t, NUM_BUCKETS> buckets_{};
+    uint64_t count_ = 0, sum_ = 0, max_ = 0;
+    
+    static int bucketOf(uint64_t v) {
+        if (v < SUB_BUCKETS) return v;
+        int e = std::bit_width(v) - 1;  // >= 3
+        return (e - 2) * SUB_BUCKETS + (v >> (e - 3) & (SUB_BUCKETS - 1));
+    }
+    
+    static uint64_t bucketStart(int i) {
+        if (i < SUB_BUCKETS) return i;
+        int e = i / SUB_BUCKETS + 2;
+        return (uint64_t(SUB_BUCKETS) + i % SUB_BUCKETS) << (e - 3);
+    }
+    
+    static uint64_t bucketEnd(int i) {
+        return i + 1 < NUM_BUCKETS ? bucketStart(i + 1) : UINT64_MAX;
+    }
+};
+
+} // namespace bio
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <bit>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace bio {
+
+// 128-bit hash of a sequence, the key of a ResultCache. Two independent
+// 64-bit lanes over 8-byte words, so distinct reads practically never share
+// a key.
+struct SequenceKey {
+    uint64_t lo = 0, hi = 0;
+    
+    bool operator==(const SequenceKey&) const = default;
+};
+
+inline SequenceKey sequenceKey(std::string_view s) {
+    constexpr uint64_t K1 = 0x9E3779B97F4A7C15ULL, K2 = 0xC2B2AE3D27D4EB4FULL;
+    uint64_t a = s.size() * K1, b = ~s.size() * K2;
+    auto mix = [&](uint64_t w) {
+        a = (a ^ w) * K1;
+        a ^= a >> 29;
+        b = std::rotl((b + w) * K2, 31);
+    };
+    size_t i = 0;
+    for (; i + 8 <= s.size(); i += 8) {
+        uint64_t w;
+        std::memcpy(&w, s.data() + i, 8);
+        mix(w);
+    }
+    uint64_t tail = 0;
+    std::memcpy(&tail, s.data() + i, s.size() - i);
+    mix(tail);
+    // Finalizer of MurmurHash3 on each lane
+    auto fmix = [](uint64_t h) {
+        h = (h ^ h >> 33) * 0xFF51AFD7ED558CCDULL;
+        h = (h ^ h >> 33) * 0xC4CEB9FE1A85EC53ULL;
+        return h ^ h >> 33;
+    };
+    return {fmix(a), fmix(b ^ a)};
+}
+
+// Bounded concurrent cache of per-read results, keyed by SequenceKey
+//
+// Set-associative: a key lives in one of the WAYS entries of the set its hash
+// selects. A full set evicts with CLOCK (second chance): a hand sweeps the
+// set, sparing entries hit since it last passed (and clearing their bit), and
+// replaces the first entry not hit. New entries start unreferenced, so reads
+// seen once make way before duplicated ones. Sets are guarded by LOCKS striped
+// mutexes (set % LOCKS), so threads rarely wait on each other. Each entry
+// also keeps the cost of computing its value (e.g. in ticks), from which
+// callers estimate the time the hits save.
+template<typename V>
+class ResultCache {
+public:
+    static constexpr int WAYS = 8;
+    static constexpr size_t LOCKS = 1024;
+    
+    // Largest power-of-two number of sets within max_bytes (at least one)
+    explicit ResultCache(size_t max_bytes) {
+        size_t per_set = sizeof(Set) + WAYS * sizeof(Entry);
+        size_t sets = std::bit_floor(std::max<size_t>(1, max_bytes / per_set));
+        sets_.resize(sets);
+        entries_.resize(sets * WAYS);
+        mask_ = sets - 1;
+        locks_ = std::make_unique<std::mutex[]>(LOCKS);
+    }
+    
+    size_t capacity() const { return entries_.size(); }
+    
+    size_t memoryBytes() const {
+        return sets_.size() * sizeof(Set) + entries_.size() * sizeof(Entry);
+    }
+    
+    // Hint the cache to load the set of key, ahead of find() or insert()
+    void prefetch(const SequenceKey& key) const {
+        const Set* set = &sets_[key.lo & mask_];
+        __builtin_prefetch(set);
+        __builtin_prefetch(reinterpret_cast<const char*>(set) + 64);
+        __builtin_prefetch(reinterpret_cast<const char*>(set) + 128);
+    }
+    
+    // Copy the cached value of key and its cost; false if it is not cached
+    bool find(const SequenceKey& key, V& value, uint32_t& cost) {
+        size_t s = key.lo & mask_;
+        std::lock_guard lock(locks_[s % LOCKS]);
+        Set& set = sets_[s];
+        for (int w = 0; w < WAYS; w++) {
+            if ((set.used >> w & 1) && set.keys[w] == key) {
+                set.referenced |= 1 << w;
+                value = entries_[s * WAYS + w].value;
+                cost = entries_[s * WAYS + w].cost;
+                return true;
+            }
+        }
+        return false;
+    }
+    
+    // Cache value for key, replacing the key's entry if another thread added
+    // it meanwhile
+    void insert(const SequenceKey& key, const V& value, uint32_t cost) {
+        size_t s = key.lo & mask_;
+        std::lock_guard lock(locks_[s % LOCKS]);
+        Set& set = sets_[s];
+        int way = -1;
+        for (int w = 0; w < WAYS && way < 0; w++) {
+            if ((set.used >> w & 1) && set.keys[w] == key) way = w;
+        }
+        if (way < 0 && set.used != FULL) way = std::countr_one(set.used);
+        while (way < 0) {
+            int w = set.hand;
+            set.hand = (set.hand + 1) % WAYS;
+            if (set.referenced >> w & 1) set.referenced &= ~(1 << w);
+            else way = w;
+        }
+        set.keys[way] = key;
+        set.used |= 1 << way;
+        set.referenced &= ~(1 << way);
+        entries_[s * WAYS + way] = {value, cost};
+    }
+
+private:
+    static_assert(WAYS <= 8, "set masks are 8 bits");
+    static constexpr uint8_t FULL = (1 << WAYS) - 1;
+    
+    struct alignas(64) Set {
+        SequenceKey keys[WAYS];
+        uint8_t used = 0;        // bit per way
+        uint8_t referenced = 0;  // hit since the hand last passed
+        uint8_t hand = 0;
+    };
+    
+    struct Entry {
+        V value;
+        uint32_t cost;
+    };
+    
+    std::vector<Set> sets_;
+    std::vector<Entry> entries_;
+    size_t mask_ = 0;
+    std::unique_ptr<std::mutex[]> locks_;
+};
+
+} // namespace bio
@@ -0,0 +1,177 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <charconv>
+#include <cstdio>
+#include <stdexcept>
+
+namespace bio {
+
+// SAM output
+//
+// Records are formatted into caller-owned string buffers, typically one per
+// mapping thread and batch of reads, so formatting runs in parallel with no
+// locking. A SamWriter thread writes finished buffers to the file in batch
+// order, so the output does not depend on the thread count.
+
+constexpr int SAM_PAIRED = 0x1;
+constexpr int SAM_PROPER_PAIR = 0x2;
+constexpr int SAM_UNMAPPED = 0x4;
+constexpr int SAM_MATE_UNMAPPED = 0x8;
+constexpr int SAM_REVERSE = 0x10;
+constexpr int SAM_MATE_REVERSE = 0x20;
+constexpr int SAM_FIRST_MATE = 0x40;
+constexpr int SAM_SECOND_MATE = 0x80;
+
+struct SamRecord {
+    std::string_view qname;
+    int flag = 0;
+    std::string_view rname = "*";
+    long long pos = 0;              // 1-based leftmost position, 0 if unmapped
+    int mapq = 0;
+    std::string_view cigar = "*";
+    std::string_view rnext = "*";   // mate's reference ("=" for the same one)
+    long long pnext = 0;            // mate's 1-based position
+    long long tlen = 0;             // signed template length
+    std::string_view seq;           // as aligned: reverse complemented for SAM_REVERSE
+    std::string_view qual = "*";    // reversed for SAM_REVERSE
+    int nm = -1;                    // NM tag (edit distance), omitted if negative
+};
+
+namespace detail {
+    inline void appendNumber(std::string& out, long long value) {
+        char buf[24];
+        auto [end, ec] = std::to_chars(buf, buf + sizeof(buf), value);
+        out.append(buf, end);
+    }
+}
+
+// Append one tab-separated SAM line to out
+inline void appendSamRecord(std::string& out, const SamRecord& r) {
+    out.append(r.qname.substr(0, r.qname.find_first_of(" \t")));
+    out += '\t';
+    detail::appendNumber(out, r.flag);
+    out += '\t';
+    out.append(r.rname);
+    out += '\t';
+    detail::appendNumber(out, r.pos);
+    out += '\t';
+    detail::appendNumber(out, r.mapq);
+    out += '\t';
+    out.append(r.cigar);
+    out += '\t';
+    out.append(r.rnext);
+    out += '\t';
+    detail::appendNumber(out, r.pnext);
+    out += '\t';
+    detail::appendNumber(out, r.tlen);
+    out += '\t';
+    out.append(r.seq.empty() ? "*" : r.seq);
+    out += '\t';
+    out.append(r.qual.empty() ? "*" : r.qual);
+    if (r.nm >= 0) {
+        out.append("\tNM:i:");
+        detail::appendNumber(out, r.nm);
+    }
+    out += '\n';
+}
+
+// Writes the header, then text batches 0, 1, 2, ... in order from a
+// background thread, whatever order they are handed in. A batch more than
+// max_ahead past the next one to write blocks its caller, which bounds the
+// memory held; the next batch itself never blocks, so callers cannot deadlock.
+class SamWriter {
+public:
+    SamWriter(const std::string& path, std::string_view header, size_t max_ahead = 64)
+        : path_(path), max_ahead_(max_ahead) {
+        file_ = std::fopen(path.c_str(), "wb");
+        if (!file_) throw std::runtime_error("Cannot create " + path);
+        pending_.emplace(0, std::string(header));
+        thread_ = std::thread([this] { writeBatches(); });
+    }
+    
+    ~SamWriter() {
+        try {
+            close();
+        } catch (...) {
+        }
+    }
+    
+    SamWriter(const SamWriter&) = delete;
+    SamWriter& operator=(const SamWriter&) = delete;
+    
+    // Queue the text of batch index (each index exactly once, from 0)
+    void write(size_t index, std::string&& text) {
+        std::unique_lock<std::mutex> lock(m_);
+        cv_.wait(lock, [&] { return index + 1 < next_ + max_ahead_ || !error_.empty(); });
+        pending_.emplace(index + 1, std::move(text));  // key 0 is the header
+        cv_.notify_all();
+    }
+    
+    // An empty buffer for the next batch, reusing the storage of written ones
+    std::string buffer() {
+        std::lock_guard<std::mutex> lock(m_);
+        if (spare_.empty()) return std::string();
+        std::string s = std::move(spare_.back());
+        spare_.pop_back();
+        return s;
+    }
+    
+    // Write all queued batches and close the file; throws on I/O errors
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(m_);
+            if (closed_) return;
+            closed_ = true;
+        }
+        cv_.notify_all();
+        thread_.join();
+        bool failed = std::fclose(file_) != 0;
+        if (!error_.empty()) throw std::runtime_error(error_);
+        if (failed) throw std::runtime_error("Failed writing " + path_);
+    }
+
+private:
+    std::string path_;
+    std::FILE* file_ = nullptr;
+    size_t max_ahead_;
+    
+    std::mutex m_;
+    std::condition_variable cv_;
+    std::map<size_t, std::string> pending_;  // batch index + 1 -> text
+    std::vector<std::string> spare_;
+    size_t next_ = 0;
+    bool closed_ = false;
+    std::string error_;
+    std::thread thread_;
+    
+    void writeBatches() {
+        std::unique_lock<std::mutex> lock(m_);
+        while (true) {
+            cv_.wait(lock, [&] { return (!pending_.empty() && pending_.begin()->first == next_) || closed_; });
+            if (pending_.empty() || pending_.begin()->first != next_) return;  // closed and drained
+            std::string text = std::move(pending_.begin()->second);
+            pending_.erase(pending_.begin());
+            lock.unlock();
+            bool ok = std::fwrite(text.data(), 1, text.size(), file_) == text.size();
+            text.clear();
+            lock.lock();
+            if (!ok) {
+                error_ = "Failed writing " + path_;
+                cv_.notify_all();
+                return;
+            }
+            next_++;
+            if (spare_.size() < max_ahead_) spare_.push_back(std::move(text));
+            cv_.notify_all();
+        }
+    }
+};
+
+} // namespace bio
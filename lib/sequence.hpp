@@ -0,0 +1,29 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+namespace bio {
+
+// Watson-Crick complement of a nucleotide, in upper case whatever the case of
+// c (as PackedSequence reads a-t as ACGT); anything else (N, IUPAC codes) maps to N
+inline char complementBase(char c) {
+    switch (c) {
+        case 'A': case 'a': return 'T';
+        case 'C': case 'c': return 'G';
+        case 'G': case 'g': return 'C';
+        case 'T': case 't': return 'A';
+    }
+    return 'N';
+}
+
+// Reverse complement of a DNA sequence
+inline std::string reverseComplement(std::string_view s) {
+    std::string rc(s.size(), 'N');
+    for (size_t i = 0; i < s.size(); i++) {
+        rc[s.size() - 1 - i] = complementBase(s[i]);
+    }
+    return rc;
+}
+
+} // namespace bio
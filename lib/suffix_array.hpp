@@ -1,12 +1,140 @@
 #pragma once
 
 #include <vector>
+#include <array>
 #include <string>
+#include <string_view>
+#include <span>
 #include <algorithm>
+#include <utility>
+#include <cstdint>
+#include <bit>
+#include "packed_sequence.hpp"
 
 namespace bio {
 
+namespace detail {
+    // SA-IS (Nong, Zhang & Chan 2009): linear-time suffix sorting by induced sorting.
+    // s[0..n) holds symbols in [0, upper]; the end of the text acts as an implicit
+    // sentinel smaller than every symbol, matching std::string::compare order.
+    // Index must be a signed integer type wide enough to hold n.
+    template<typename Index, typename Symbol>
+    std::vector<Index> saIs(const Symbol* s, Index n, Index upper) {
+        if (n == 0) return {};
+        if (n == 1) return {0};
+        if (n == 2) {
+            if (s[0] < s[1]) return {0, 1};
+            return {1, 0};
+        }
+        
+        std::vector<Index> sa(n);
+        std::vector<bool> ls(n);  // true = S-type suffix
+        for (Index i = n - 2; i >= 0; i--) {
+            ls[i] = (s[i] == s[i + 1]) ? ls[i + 1] : (s[i] < s[i + 1]);
+        }
+        
+        // Bucket boundaries: sum_l[c] = start of c's bucket, sum_s[c] = start of its S part
+        std::vector<Index> sum_l(upper + 1), sum_s(upper + 1);
+        for (Index i = 0; i < n; i++) {
+            if (!ls[i]) sum_s[s[i]]++;
+            else sum_l[s[i] + 1]++;
+        }
+        for (Index c = 0; c <= upper; c++) {
+            sum_s[c] += sum_l[c];
+            if (c < upper) sum_l[c + 1] += sum_s[c];
+        }
+        
+        std::vector<Index> buf(upper + 1);
+        auto induce = [&](const std::vector<Index>& lms) {
+            std::fill(sa.begin(), sa.end(), -1);
+            std::copy(sum_s.begin(), sum_s.end(), buf.begin());
+            for (Index d : lms) {
+                if (d != n) sa[buf[s[d]]++] = d;
+            }
+            // L-type suffixes, left to right
+            std::copy(sum_l.begin(), sum_l.end(), buf.begin());
+            sa[buf[s[n - 1]]++] = n - 1;
+            for (Index i = 0; i < n; i++) {
+                Index v = sa[i];
+                if (v >= 1 && !ls[v - 1]) sa[buf[s[v - 1]]++] = v - 1;
+            }
+            // S-type suffixes, right to left
+            std::copy(sum_l.begin(), sum_l.end(), buf.begin());
+            for (Index i = n - 1; i >= 0; i--) {
+                Index v = sa[i];
+                if (v >= 1 && ls[v - 1]) sa[--buf[s[v - 1] + 1]] = v - 1;
+            }
+        };
+        
+        // Leftmost-S positions, numbered in text order
+        std::vector<Index> lms_map(n + 1, -1);
+        std::vector<Index> lms;
+        for (Index i = 1; i < n; i++) {
+            if (!ls[i - 1] && ls[i]) {
+                lms_map[i] = lms.size();
+                lms.push_back(i);
+            }
+        }
+        Index m = lms.size();
+        
+        induce(lms);
+        if (m == 0) return sa;
+        
+        // Name the LMS substrings in sorted order and recurse on the reduced string
+        std::vector<Index> sorted_lms;
+        sorted_lms.reserve(m);
+        for (Index v : sa) {
+            if (lms_map[v] != -1) sorted_lms.push_back(v);
+        }
+        std::vector<Index> rec_s(m);
+        Index rec_upper = 0;
+        rec_s[lms_map[sorted_lms[0]]] = 0;
+        for (Index i = 1; i < m; i++) {
+            Index l = sorted_lms[i - 1], r = sorted_lms[i];
+            Index end_l = (lms_map[l] + 1 < m) ? lms[lms_map[l] + 1] : n;
+            Index end_r = (lms_map[r] + 1 < m) ? lms[lms_map[r] + 1] : n;
+            bool same = true;
+            if (end_l - l != end_r - r) {
+                same = false;
+            } else {
+                while (l < end_l && s[l] == s[r]) {
+                    l++;
+                    r++;
+                }
+                if (l == n || r == n || s[l] != s[r]) same = false;
+            }
+            if (!same) rec_upper++;
+            rec_s[lms_map[sorted_lms[i]]] = rec_upper;
+        }
+        lms_map = std::vector<Index>();
+        
+        std::vector<Index> rec_sa = saIs<Index>(rec_s.data(), m, rec_upper);
+        for (Index i = 0; i < m; i++) {
+            sorted_lms[i] = lms[rec_sa[i]];
+        }
+        induce(sorted_lms);
+        return sa;
+    }
+}
+
+// O(n) suffix array construction (SA-IS) for texts shorter than 2^31
 inline std::vector<int> buildSuffixArray(const std::string& s) {
+    return detail::saIs<int>(reinterpret_cast<const unsigned char*>(s.data()), (int)s.size(), 255);
+}
+
+// Suffix array of a packed sequence, in the same order as for its unpacked
+// text (ambiguous bases sort as 'N'); unpacks into a temporary string
+inline std::vector<int> buildSuffixArray(const PackedSequence& s) {
+    return buildSuffixArray(s.unpack());
+}
+
+// O(n) suffix array construction (SA-IS) with 64-bit indices, for texts of 2^31 bases and more
+inline std::vector<long long> buildSuffixArray64(const std::string& s) {
+    return detail::saIs<long long>(reinterpret_cast<const unsigned char*>(s.data()), (long long)s.size(), 255);
+}
+
+// O(n log² n) prefix-doubling construction, kept as a reference implementation
+inline std::vector<int> buildSuffixArrayDoubling(const std::string& s) {
     int n = s.size();
     std::vector<int> sa(n), rk(n), tmp(n);
     
@@ -35,7 +163,7 @@ inline std::vector<int> buildSuffixArray(const std::string& s) {
 }
 
 // Find lower bound: first suffix >= pattern
-inline int suffixArrayLowerBound(const std::string& s, const std::vector<int>& sa, const std::string& pat) {
+inline int suffixArrayLowerBound(std::string_view s, std::span<const int> sa, std::string_view pat) {
     int lo = 0, hi = sa.size();
     while (lo < hi) {
         int mid = (lo + hi) / 2;
@@ -48,7 +176,7 @@ inline int suffixArrayLowerBound(const std::string& s, const std::vector<int>& s
 }
 
 // Find upper bound: first suffix > pattern
-inline int suffixArrayUpperBound(const std::string& s, const std::vector<int>& sa, const std::string& pat) {
+inline int suffixArrayUpperBound(std::string_view s, std::span<const int> sa, std::string_view pat) {
     int lo = 0, hi = sa.size();
     while (lo < hi) {
         int mid = (lo + hi) / 2;
@@ -61,7 +189,7 @@ inline int suffixArrayUpperBound(const std::string& s, const std::vector<int>& s
 }
 
 // Find all occurrences of pattern in text using suffix array
-inline std::vector<int> findAllOccurrences(const std::string& text, const std::vector<int>& sa, const std::string& pattern) {
+inline std::vector<int> findAllOccurrences(std::string_view text, std::span<const int> sa, std::string_view pattern) {
     int lo = suffixArrayLowerBound(text, sa, pattern);
     int hi = suffixArrayUpperBound(text, sa, pattern);
     std::vector<int> result;
@@ -72,18 +200,655 @@ inline std::vector<int> findAllOccurrences(const std::string& text, const std::v
 }
 
 // Check if pattern has unique occurrence
-inline bool hasUniqueMatch(const std::string& text, const std::vector<int>& sa, const std::string& pattern) {
+inline bool hasUniqueMatch(std::string_view text, std::span<const int> sa, std::string_view pattern) {
     int lo = suffixArrayLowerBound(text, sa, pattern);
     int hi = suffixArrayUpperBound(text, sa, pattern);
     return (hi - lo) == 1;
 }
 
 // Get unique match position, returns -1 if not unique
-inline int getUniqueMatchPosition(const std::string& text, const std::vector<int>& sa, const std::string& pattern) {
+inline int getUniqueMatchPosition(std::string_view text, std::span<const int> sa, std::string_view pattern) {
     int lo = suffixArrayLowerBound(text, sa, pattern);
     int hi = suffixArrayUpperBound(text, sa, pattern);
     if (hi - lo == 1) return sa[lo];
     return -1;
 }
 
+// Packed-text searches: suffixes are compared with the pattern 32 bases per
+// word. Pack the pattern once when searching it more than once.
+inline int suffixArrayLowerBound(const PackedSequence& s, std::span<const int> sa, const PackedSequence& pat) {
+    int lo = 0, hi = sa.size();
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (s.compare(sa[mid], pat.size(), pat) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+inline int suffixArrayUpperBound(const PackedSequence& s, std::span<const int> sa, const PackedSequence& pat) {
+    int lo = 0, hi = sa.size();
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (s.compare(sa[mid], pat.size(), pat) <= 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+inline int suffixArrayLowerBound(const PackedSequence& s, std::span<const int> sa, std::string_view pat) {
+    return suffixArrayLowerBound(s, sa, PackedSequence(pat));
+}
+
+inline int suffixArrayUpperBound(const PackedSequence& s, std::span<const int> sa, std::string_view pat) {
+    return suffixArrayUpperBound(s, sa, PackedSequence(pat));
+}
+
+inline std::vector<int> findAllOccurrences(const PackedSequence& text, std::span<const int> sa, std::string_view pattern) {
+    PackedSequence pat(pattern);
+    int lo = suffixArrayLowerBound(text, sa, pat);
+    int hi = suffixArrayUpperBound(text, sa, pat);
+    return std::vector<int>(sa.begin() + lo, sa.begin() + hi);
+}
+
+// LCP array (Kasai et al. 2001) in O(n): lcp[i] = length of the longest common
+// prefix of suffixes sa[i - 1] and sa[i]; lcp[0] = 0
+namespace detail {
+    inline size_t extendMatch(std::string_view s, size_t a, size_t b, size_t from) {
+        size_t h = from;
+        while (a + h < s.size() && b + h < s.size() && s[a + h] == s[b + h]) h++;
+        return h;
+    }
+    
+    inline size_t extendMatch(const PackedSequence& s, size_t a, size_t b, size_t from) {
+        return s.commonPrefix(a, s, b, from);
+    }
+    
+    template<typename Text>
+    std::vector<int> kasaiLcp(const Text& text, std::span<const int> sa) {
+        int n = sa.size();
+        std::vector<int> rank(n), lcp(n, 0);
+        for (int i = 0; i < n; i++) rank[sa[i]] = i;
+        size_t h = 0;
+        for (int i = 0; i < n; i++) {
+            if (rank[i] == 0) {
+                h = 0;
+                continue;
+            }
+            h = extendMatch(text, i, sa[rank[i] - 1], h);
+            lcp[rank[i]] = h;
+            if (h > 0) h--;
+        }
+        return lcp;
+    }
+}
+
+inline std::vector<int> buildLcpArray(std::string_view text, std::span<const int> sa) {
+    return detail::kasaiLcp(text, sa);
+}
+
+inline std::vector<int> buildLcpArray(const PackedSequence& text, std::span<const int> sa) {
+    return detail::kasaiLcp(text, sa);
+}
+
+// LCP-LR tables (Manber & Myers 1993) for suffixArrayRange
+//
+// The search bisects (lo, hi) starting from (-1, n), so every row m is the
+// midpoint of exactly one interval. left[m] = lcp(S[lo], S[m]) and
+// right[m] = lcp(S[m], S[hi]) for that interval, where S[-1] and S[n] are
+// empty sentinels. Values are saturated at 255 (LCP_LR_MAX) to take 2 bytes
+// per suffix; longer common prefixes are still found, just compared directly.
+constexpr int LCP_LR_MAX = 255;
+
+struct LcpLrTables {
+    std::vector<uint8_t> left, right;
+};
+
+namespace detail {
+    // Fill the tables for the interval (lo, hi); returns min(lcp[lo + 1 .. hi]),
+    // taking lcp[0] and lcp[n] (the sentinels) as 0
+    inline int fillLcpLr(std::span<const int> lcp, int lo, int hi, LcpLrTables& t) {
+        if (hi - lo == 1) return hi < (int)lcp.size() ? lcp[hi] : 0;
+        int mid = lo + (hi - lo) / 2;
+        int left = fillLcpLr(lcp, lo, mid, t);
+        int right = fillLcpLr(lcp, mid, hi, t);
+        t.left[mid] = std::min(left, LCP_LR_MAX);
+        t.right[mid] = std::min(right, LCP_LR_MAX);
+        return std::min(left, right);
+    }
+}
+
+inline LcpLrTables buildLcpLrTables(std::span<const int> lcp) {
+    LcpLrTables t;
+    t.left.assign(lcp.size(), 0);
+    t.right.assign(lcp.size(), 0);
+    detail::fillLcpLr(lcp, -1, lcp.size(), t);
+    return t;
+}
+
+namespace detail {
+    // Order of the suffix at pos relative to pat (-1, 0 = starts with pat, 1),
+    // given that their first `from` bases match; sets h to their common prefix length
+    inline int compareFrom(std::string_view text, size_t pos, std::string_view pat, size_t from, int& h) {
+        size_t i = from, limit = std::min(pat.size(), text.size() - pos);
+        while (i < limit && text[pos + i] == pat[i]) i++;
+        h = i;
+        if (i == pat.size()) return 0;
+        if (i == limit) return -1;
+        return (unsigned char)text[pos + i] < (unsigned char)pat[i] ? -1 : 1;
+    }
+    
+    inline int compareFrom(const PackedSequence& text, size_t pos, const PackedSequence& pat, size_t from, int& h) {
+        size_t m = pat.size(), limit = std::min(m, text.size() - pos);
+        if (text.hasAmbiguous(pos + from, limit - from) || pat.hasAmbiguous(from, limit - from)) {
+            size_t i = text.commonPrefix(pos, pat, 0, from);
+            h = i;
+            if (i == m) return 0;
+            if (i == limit) return -1;
+            return (unsigned char)text[pos + i] < (unsigned char)pat[i] ? -1 : 1;
+        }
+        for (size_t i = from; i < limit; i += 32) {
+            uint64_t a = text.word(pos + i), b = pat.word(i);
+            size_t k = std::min<size_t>(32, limit - i);
+            uint64_t diff = a ^ b;
+            if (k < 32) diff &= ~0ULL << (64 - 2 * k);
+            if (diff) {
+                h = i + std::countl_zero(diff) / 2;
+                return a < b ? -1 : 1;
+            }
+        }
+        h = limit;
+        return limit == m ? 0 : -1;
+    }
+    
+    // One step of the LCP-LR search at row mid of the interval (lo, hi) whose
+    // bounds match the pattern for l and r bases. Returns the order of the
+    // suffix at mid relative to the pattern (-1, 0 = starts with it, 1) and
+    // sets h to their common prefix length.
+    template<typename Text, typename Pattern>
+    int lcpLrStep(const Text& text, std::span<const int> sa, std::span<const uint8_t> left,
+                  std::span<const uint8_t> right, const Pattern& pat, int mid, int l, int r, int& h) {
+        int skip;
+        if (l >= r) {
+            // S[mid] agrees with S[lo] for left[mid] bases, and S[lo] < P at l
+            int x = left[mid];
+            if (x < LCP_LR_MAX || l < LCP_LR_MAX) {
+                if (x > l) { h = l; return -1; }
+                if (x < l) { h = x; return 1; }
+            }
+            skip = std::min(l, x);
+        } else {
+            int y = right[mid];
+            if (y < LCP_LR_MAX || r < LCP_LR_MAX) {
+                if (y > r) { h = r; return 1; }
+                if (y < r) { h = y; return -1; }
+            }
+            skip = std::min(r, y);
+        }
+        return compareFrom(text, sa[mid], pat, skip, h);
+    }
+    
+    // One-pass [lo, hi) search over rows (lo, hi): the lower and upper bound
+    // searches share their descent until the first row starting with the
+    // pattern. step(mid, l, r, h) orders row mid against the pattern given
+    // the common prefix lengths l, r of the current bounds.
+    template<typename Step>
+    std::pair<int, int> bisectRange(int lo, int hi, int m, Step step) {
+        int l = 0, r = 0, h;
+        while (hi - lo > 1) {
+            int mid = lo + (hi - lo) / 2;
+            int c = step(mid, l, r, h);
+            if (c < 0) {
+                lo = mid;
+                l = h;
+            } else if (c > 0) {
+                hi = mid;
+                r = h;
+            } else {
+                // Lower bound in (lo, mid], upper bound in [mid, hi)
+                int a = lo, b = mid, la = l, rb = m;
+                while (b - a > 1) {
+                    int x = a + (b - a) / 2;
+                    if (step(x, la, rb, h) < 0) {
+                        a = x;
+                        la = h;
+                    } else {
+                        b = x;
+                        rb = h;
+                    }
+                }
+                int u = mid, v = hi, lu = m, rv = r;
+                while (v - u > 1) {
+                    int x = u + (v - u) / 2;
+                    if (step(x, lu, rv, h) <= 0) {
+                        u = x;
+                        lu = h;
+                    } else {
+                        v = x;
+                        rv = h;
+                    }
+                }
+                return {b, v};
+            }
+        }
+        return {hi, hi};
+    }
+    
+    template<typename Text, typename Pattern>
+    std::pair<int, int> lcpLrRange(const Text& text, std::span<const int> sa, std::span<const uint8_t> left,
+                                   std::span<const uint8_t> right, const Pattern& pat) {
+        return bisectRange(-1, sa.size(), pat.size(), [&](int mid, int l, int r, int& h) {
+            return lcpLrStep(text, sa, left, right, pat, mid, l, r, h);
+        });
+    }
+}
+
+// Suffix-array interval [lo, hi) of suffixes starting with pat, in one pass:
+// the lower and upper bound searches share their descent until the first
+// match, and the LCP-LR tables let every step skip the prefix already known
+// to match, so a lookup costs O(m + log n) base comparisons instead of
+// O(m log n). Same result as suffixArrayLowerBound/UpperBound.
+inline std::pair<int, int> suffixArrayRange(std::string_view text, std::span<const int> sa, std::span<const uint8_t> lcp_left,
+                                            std::span<const uint8_t> lcp_right, std::string_view pat) {
+    return detail::lcpLrRange(text, sa, lcp_left, lcp_right, pat);
+}
+
+inline std::pair<int, int> suffixArrayRange(const PackedSequence& text, std::span<const int> sa, std::span<const uint8_t> lcp_left,
+                                            std::span<const uint8_t> lcp_right, const PackedSequence& pat) {
+    return detail::lcpLrRange(text, sa, lcp_left, lcp_right, pat);
+}
+
+inline std::pair<int, int> suffixArrayRange(const PackedSequence& text, std::span<const int> sa, std::span<const uint8_t> lcp_left,
+                                            std::span<const uint8_t> lcp_right, std::string_view pat) {
+    return suffixArrayRange(text, sa, lcp_left, lcp_right, PackedSequence(pat));
+}
+
+// k-mer prefix table: direct-indexed suffix-array bounds of every k-mer
+//
+// table[c] (c = 2-bit code of a k-mer, 0 <= c <= 4^k) is the number of
+// suffixes that sort before k-mer c, so rows [table[c], table[c + 1]) hold
+// every suffix starting with c (plus any suffix that runs into an 'N' or the
+// text end after a prefix of c). A lookup then only searches that range,
+// skipping the cache-missing top of the binary search. Takes 4 * 4^k bytes.
+// Built in O(n) from the text alone.
+namespace detail {
+    // Code of an uppercase ACGT character, -1 otherwise (ASCII order of the text)
+    inline int acgtCode(char c) {
+        switch (c) {
+            case 'A': return 0;
+            case 'C': return 1;
+            case 'G': return 2;
+            case 'T': return 3;
+        }
+        return -1;
+    }
+    
+    template<typename Text>
+    std::vector<uint32_t> prefixTable(const Text& text, int k) {
+        size_t n = text.size();
+        size_t buckets = size_t(1) << (2 * k);
+        std::vector<uint32_t> table(buckets + 1, 0);
+        
+        // Bucket each suffix by the number of k-mers that sort at or before it:
+        // its code + 1 if it starts with k ACGT bases; otherwise the valid
+        // prefix p of length j (before an 'N' or the end) precedes the k-mers
+        // extending p, plus those continuing with a base below the 'N'
+        uint64_t code = 0;  // rolling code of text[i, i + valid)
+        size_t valid = 0;   // ACGT bases starting at i, up to k
+        size_t next = 0;    // first position not yet added to code
+        for (size_t i = 0; i < n; i++) {
+            while (valid < (size_t)k && next < n) {
+                int c = acgtCode(text[next]);
+                if (c < 0) break;
+                code = (code << 2 | c) & (buckets - 1);
+                valid++;
+                next++;
+            }
+            size_t f;
+            if (valid == (size_t)k) {
+                f = code + 1;
+            } else {
+                size_t rest = 2 * (k - valid);
+                f = code << rest;
+                if (next < n) {
+                    // Stopped at a non-ACGT character; count ACGT below it
+                    unsigned char ch = text[next];
+                    int below = (ch > 'A') + (ch > 'C') + (ch > 'G') + (ch > 'T');
+                    f += below * (size_t(1) << (rest - 2));
+                }
+            }
+            table[f]++;
+            
+            // Slide the window start past i
+            if (valid > 0) {
+                valid--;
+                code &= (uint64_t(1) << (2 * valid)) - 1;
+            } else {
+                next = i + 1;  // text[i] is not ACGT
+            }
+        }
+        // table[c] = suffixes with bucket value <= c
+        for (size_t c = 1; c <= buckets; c++) table[c] += table[c - 1];
+        return table;
+    }
+}
+
+inline std::vector<uint32_t> buildPrefixTable(std::string_view text, int k) {
+    return detail::prefixTable(text, k);
+}
+
+inline std::vector<uint32_t> buildPrefixTable(const PackedSequence& text, int k) {
+    return detail::prefixTable(text, k);
+}
+
+// k of a prefix table (from its size), or -1 if the size is not 4^k + 1
+inline int prefixTableK(std::span<const uint32_t> table) {
+    for (int k = 0; k < 16; k++) {
+        if (table.size() == (size_t(1) << (2 * k)) + 1) return k;
+    }
+    return -1;
+}
+
+// Largest prefix table k: 4^14 + 1 entries take 1 GiB
+constexpr int MAX_PREFIX_K = 14;
+
+// Largest k with 4^k <= n, at most MAX_PREFIX_K: about one suffix per bucket,
+// and a table no larger than the suffix array
+inline int defaultPrefixK(size_t n) {
+    int k = 0;
+    while (k < MAX_PREFIX_K && (size_t(4) << (2 * k)) <= n) k++;
+    return k;
+}
+
+namespace detail {
+    template<typename Text, typename Pattern>
+    std::pair<int, int> prefixTableRange(const Text& text, std::span<const int> sa, std::span<const uint32_t> table,
+                                         const Pattern& pat) {
+        int k = prefixTableK(table);
+        int lo = -1, hi = sa.size();
+        if (k >= 0 && (int)pat.size() >= k) {
+            uint64_t code = 0;
+            int i = 0;
+            for (; i < k; i++) {
+                int c = acgtCode(pat[i]);
+                if (c < 0) break;
+                code = code << 2 | c;
+            }
+            if (i == k) {
+                lo = (int)table[code] - 1;
+                hi = table[code + 1];
+            }
+        }
+        // Within the range, each step skips the prefix shared by both bounds (mlr)
+        return bisectRange(lo, hi, pat.size(), [&](int mid, int l, int r, int& h) {
+            return compareFrom(text, sa[mid], pat, std::min(l, r), h);
+        });
+    }
+}
+
+// Suffix-array interval [lo, hi) of suffixes starting with pat, searched only
+// within the prefix-table range of its first k bases. Patterns shorter than k
+// or with a non-ACGT base among the first k search the whole suffix array.
+inline std::pair<int, int> suffixArrayRange(std::string_view text, std::span<const int> sa,
+                                            std::span<const uint32_t> prefix_table, std::string_view pat) {
+    return detail::prefixTableRange(text, sa, prefix_table, pat);
+}
+
+inline std::pair<int, int> suffixArrayRange(const PackedSequence& text, std::span<const int> sa,
+                                            std::span<const uint32_t> prefix_table, const PackedSequence& pat) {
+    return detail::prefixTableRange(text, sa, prefix_table, pat);
+}
+
+inline std::pair<int, int> suffixArrayRange(const PackedSequence& text, std::span<const int> sa,
+                                            std::span<const uint32_t> prefix_table, std::string_view pat) {
+    return suffixArrayRange(text, sa, prefix_table, PackedSequence(pat));
+}
+
+namespace detail {
+    // One bisection of a batched range search: the descent shared by the two
+    // bounds, then the lower and upper bound searches once it hits a match
+    struct BatchCursor {
+        enum Phase : uint8_t { Shared, Lower, Upper };
+        int lo, hi, l, r;
+        int mid;
+        int m;       // pattern length
+        int query;
+        Phase phase;
+    };
+    
+    // bisectRange for many patterns at once. Up to `width` bisections advance
+    // in lockstep, one step per round: first every cursor's next row is
+    // prefetched, then the text at each row's suffix, then all compare. The
+    // cache misses of a round thus overlap instead of following each other.
+    // init(q, lo, hi, m) sets the starting rows and the pattern length of
+    // query q, ahead(q) is called `width` queries before init to prefetch
+    // what it reads, row(mid) and text_at(mid, skip) prefetch a step's loads,
+    // and step(q, mid, l, r, h) is bisectRange's step for query q.
+    template<typename Init, typename Ahead, typename Row, typename TextAt, typename Step>
+    void bisectRanges(size_t count, size_t width, std::vector<BatchCursor>& active, std::vector<BatchCursor>& split,
+                      std::span<std::pair<int, int>> out, Init init, Ahead ahead, Row row, TextAt text_at, Step step) {
+        // Record a finished bisection; false if it has rows left
+        auto finish = [&](const BatchCursor& c) {
+            if (c.hi - c.lo > 1) return false;
+            if (c.phase == BatchCursor::Shared) out[c.query] = {c.hi, c.hi};
+            else if (c.phase == BatchCursor::Lower) out[c.query].first = c.hi;
+            else out[c.query].second = c.hi;
+            return true;
+        };
+        
+        active.clear();
+        size_t next = 0;
+        for (size_t q = 0; q < std::min(width, count); q++) ahead(q);
+        while (true) {
+            while (active.size() < width && next < count) {
+                if (next + width < count) ahead(next + width);
+                BatchCursor c{0, 0, 0, 0, 0, 0, (int)next, BatchCursor::Shared};
+                init(next++, c.lo, c.hi, c.m);
+                if (!finish(c)) active.push_back(c);
+            }
+            if (active.empty()) break;
+            
+            for (BatchCursor& c : active) {
+                c.mid = c.lo + (c.hi - c.lo) / 2;
+                row(c.mid);
+            }
+            for (const BatchCursor& c : active) text_at(c.mid, std::min(c.l, c.r));
+            
+            split.clear();
+            size_t kept = 0;
+            for (BatchCursor c : active) {
+                int h;
+                int s = step(c.query, c.mid, c.l, c.r, h);
+                if (c.phase == BatchCursor::Shared && s == 0) {
+                    // Lower bound in (lo, mid], upper bound in [mid, hi)
+                    BatchCursor upper = c;
+                    upper.phase = BatchCursor::Upper;
+                    upper.lo = c.mid;
+                    upper.l = c.m;
+                    c.phase = BatchCursor::Lower;
+                    c.hi = c.mid;
+                    c.r = c.m;
+                    if (!finish(upper)) split.push_back(upper);
+                } else if (s < 0 || (s == 0 && c.phase == BatchCursor::Upper)) {
+                    c.lo = c.mid;
+                    c.l = h;
+                } else {
+                    c.hi = c.mid;
+                    c.r = h;
+                }
+                if (!finish(c)) active[kept++] = c;
+            }
+            active.resize(kept);
+            active.insert(active.end(), split.begin(), split.end());
+        }
+    }
+}
+
+// Batched suffixArrayRange: the interval of every pattern, with the binary
+// searches of `width` patterns (16-64 is best) advancing in lockstep so that
+// their cache misses overlap. Results are identical to one suffixArrayRange
+// call per pattern. Holds scratch buffers; reuse one object per thread.
+class SuffixArrayBatch {
+public:
+    static constexpr size_t DEFAULT_WIDTH = 32;
+    
+    explicit SuffixArrayBatch(size_t width = DEFAULT_WIDTH) : width_(std::max<size_t>(1, width)) {}
+    
+    // Prefix-table searches (see suffixArrayRange above)
+    void ranges(std::string_view text, std::span<const int> sa, std::span<const uint32_t> prefix_table,
+                std::span<const std::string_view> patterns, std::span<std::pair<int, int>> out) {
+        prefixTableRanges(text, sa, prefix_table, patterns, patterns, out);
+    }
+    
+    void ranges(const PackedSequence& text, std::span<const int> sa, std::span<const uint32_t> prefix_table,
+                std::span<const std::string_view> patterns, std::span<std::pair<int, int>> out) {
+        pack(patterns);
+        prefixTableRanges(text, sa, prefix_table, patterns, packed_, out);
+    }
+    
+    // LCP-LR searches
+    void ranges(std::string_view text, std::span<const int> sa, std::span<const uint8_t> lcp_left,
+                std::span<const uint8_t> lcp_right, std::span<const std::string_view> patterns,
+                std::span<std::pair<int, int>> out) {
+        lcpLrRanges(text, sa, lcp_left, lcp_right, patterns, out);
+    }
+    
+    void ranges(const PackedSequence& text, std::span<const int> sa, std::span<const uint8_t> lcp_left,
+                std::span<const uint8_t> lcp_right, std::span<const std::string_view> patterns,
+                std::span<std::pair<int, int>> out) {
+        pack(patterns);
+        lcpLrRanges(text, sa, lcp_left, lcp_right, packed_, out);
+    }
+
+private:
+    size_t width_;
+    std::vector<detail::BatchCursor> active_, split_;
+    std::vector<uint64_t> words_, ambiguous_;
+    std::vector<std::pair<size_t, size_t>> offsets_;  // per pattern: first word, first ambiguity word or SIZE_MAX
+    std::vector<PackedSequence> packed_;
+    
+    // Pack all patterns into shared buffers, viewed by packed_. Words are
+    // packed from a code table; only a word with a non-ACGT base goes back
+    // over its bases to flag them.
+    void pack(std::span<const std::string_view> patterns) {
+        static constexpr auto codes = [] {
+            std::array<int8_t, 256> t{};
+            t.fill(-1);
+            for (int c = 0; c < 256; c++) t[c] = PackedSequence::baseCode(c);
+            return t;
+        }();
+        words_.clear();
+        ambiguous_.clear();
+        offsets_.clear();
+        for (std::string_view p : patterns) {
+            size_t w = words_.size();
+            words_.resize(w + (p.size() + 31) / 32);
+            size_t a = SIZE_MAX;
+            for (size_t i = 0; i < p.size(); i += 32) {
+                size_t k = std::min<size_t>(32, p.size() - i);
+                uint64_t word = 0;
+                int invalid = 0;
+                for (size_t j = 0; j < k; j++) {
+                    int c = codes[(unsigned char)p[i + j]];
+                    invalid |= c;
+                    word = word << 2 | (c & 3);
+                }
+                if (invalid < 0) {
+                    word = 0;
+                    for (size_t j = 0; j < k; j++) {
+                        int c = codes[(unsigned char)p[i + j]];
+                        if (c < 0) {
+                            if (a == SIZE_MAX) {
+                                a = ambiguous_.size();
+                                ambiguous_.resize(a + (p.size() + 63) / 64, 0);
+                            }
+                            ambiguous_[a + (i + j) / 64] |= 1ULL << ((i + j) % 64);
+                            c = 0;
+                        }
+                        word = word << 2 | c;
+                    }
+                }
+                words_[w + i / 32] = k < 32 ? word << (64 - 2 * k) : word;
+            }
+            offsets_.push_back({w, a});
+        }
+        packed_.clear();
+        for (size_t q = 0; q < patterns.size(); q++) {
+            size_t m = patterns[q].size();
+            auto [w, a] = offsets_[q];
+            std::span<const uint64_t> amb;
+            if (a != SIZE_MAX) amb = std::span<const uint64_t>(ambiguous_).subspan(a, (m + 63) / 64);
+            packed_.push_back(PackedSequence::view(m, std::span<const uint64_t>(words_).subspan(w, (m + 31) / 32), amb));
+        }
+    }
+    
+    static void prefetchText(std::string_view text, size_t pos) {
+        if (pos < text.size()) __builtin_prefetch(text.data() + pos);
+    }
+    
+    static void prefetchText(const PackedSequence& text, size_t pos) {
+        text.prefetch(pos);
+    }
+    
+    // The k-mer code of the first k bases of pat, or -1 (as in prefixTableRange)
+    static int64_t prefixCode(std::string_view pat, int k) {
+        if (k < 0 || (int)pat.size() < k) return -1;
+        uint64_t code = 0;
+        for (int i = 0; i < k; i++) {
+            int c = detail::acgtCode(pat[i]);
+            if (c < 0) return -1;
+            code = code << 2 | c;
+        }
+        return code;
+    }
+    
+    template<typename Text, typename Patterns>
+    void prefixTableRanges(const Text& text, std::span<const int> sa, std::span<const uint32_t> table,
+                           std::span<const std::string_view> patterns, const Patterns& pats,
+                           std::span<std::pair<int, int>> out) {
+        int k = prefixTableK(table);
+        detail::bisectRanges(patterns.size(), width_, active_, split_, out,
+            [&](size_t q, int& lo, int& hi, int& m) {
+                int64_t code = prefixCode(patterns[q], k);
+                lo = code < 0 ? -1 : (int)table[code] - 1;
+                hi = code < 0 ? sa.size() : table[code + 1];
+                m = patterns[q].size();
+            },
+            [&](size_t q) {
+                int64_t code = prefixCode(patterns[q], k);
+                if (code >= 0) __builtin_prefetch(&table[code]);
+            },
+            [&](int mid) { __builtin_prefetch(&sa[mid]); },
+            [&](int mid, int skip) { prefetchText(text, sa[mid] + skip); },
+            [&](size_t q, int mid, int l, int r, int& h) {
+                return detail::compareFrom(text, sa[mid], pats[q], std::min(l, r), h);
+            });
+    }
+    
+    template<typename Text, typename Patterns>
+    void lcpLrRanges(const Text& text, std::span<const int> sa, std::span<const uint8_t> left,
+                     std::span<const uint8_t> right, const Patterns& pats, std::span<std::pair<int, int>> out) {
+        detail::bisectRanges(pats.size(), width_, active_, split_, out,
+            [&](size_t q, int& lo, int& hi, int& m) {
+                lo = -1;
+                hi = sa.size();
+                m = pats[q].size();
+            },
+            [](size_t) {},
+            [&](int mid) {
+                __builtin_prefetch(&sa[mid]);
+                __builtin_prefetch(&left[mid]);
+                __builtin_prefetch(&right[mid]);
+            },
+            [&](int mid, int skip) { prefetchText(text, sa[mid] + skip); },
+            [&](size_t q, int mid, int l, int r, int& h) {
+                return detail::lcpLrStep(text, sa, left, right, pats[q], mid, l, r, h);
+            });
+    }
+};
+
 } // namespace bio
@@ -1,264 +1,2229 @@
 #include <iostream>
-#include <fstream>
 #include <string>
 #include <vector>
 #include <algorithm>
 #include <chrono>
 #include <iomanip>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <atomic>
+#include <memory>
+#include <string_view>
+#include <span>
+#include <fstream>
 #include "lib/bio.hpp"
 
 using namespace std;
 
-// Parse FASTA file - concatenate all sequences
-string loadFasta(const string& filename) {
-    ifstream in(filename);
-    if (!in) {
-        cerr << "Error: Cannot open " << filename << endl;
+// Count heap allocations per thread for --stats-json (builds with
+// -DBIO_PROFILE_ALLOCATIONS=1 only)
+BIO_COUNT_ALLOCATIONS()
+
+// Parse FASTA file - concatenate all records, ContigTable::GAP bases apart,
+// and fill their table. Unnamed records (a headerless file) are named
+// "unnamed" so SAM @SQ lines stay valid.
+string loadFasta(const string& filename, bio::ContigTable& contigs) {
+    string genome;
+    try {
+        vector<bio::FastaContig> records = bio::readFasta(filename, genome);
+        for (auto& record : records) {
+            if (record.name.empty()) record.name = "unnamed";
+        }
+        contigs = bio::ContigTable::separate(genome, records);
+        if (contigs.size() == 0) throw runtime_error(filename + ": no FASTA records");
+    } catch (const exception& e) {
+        cerr << "Error: " << e.what() << endl;
         exit(1);
     }
-    
-    string genome, line;
-    while (getline(in, line)) {
-        if (line.empty() || line[0] == '>') continue;
-        genome += line;
-    }
     return genome;
 }
 
-// FASTQ read structure
-struct Read {
-    string id;
-    string seq;
-    string qual;
-};
-
-// Parse single read from FASTQ (4 lines)
-bool readFastq(ifstream& in, Read& read) {
-    string plus;
-    if (!getline(in, read.id)) return false;
-    if (!getline(in, read.seq)) return false;
-    if (!getline(in, plus)) return false;
-    if (!getline(in, read.qual)) return false;
-    if (!read.id.empty() && read.id[0] == '@') {
-        read.id = read.id.substr(1);
-    }
-    return true;
-}
-
 // Mapping result
 enum class MapStatus { Unmapped, Unique, Multi };
+// How a paired read was placed (see mapPairs): on its own, within the insert
+// window of its mate from its own hits or candidates there, or by a search of
+// that window
+enum class Placement { Alone, MateWindow, MateSearch };
 
 struct MappingResult {
     MapStatus status;
-    int position;
+    int position;         // leftmost forward-strand coordinate
     int edit_dist;
+    bool reverse = false; // read aligns as its reverse complement
+    int candidates = 0;   // candidate loci verified
+    int mapq = 0;         // mapping quality (see mapReads)
+    Placement placement = Placement::Alone;
 };
 
-// Map single read using seed-and-extend
-MappingResult mapRead(const string& genome, const vector<int>& sa,
-                      const string& read, int seed_len, int max_errors) {
-    MappingResult result{MapStatus::Unmapped, -1, -1};
+// Hot-path counters and stage timers of one worker, merged for --stats-json.
+// Every update is behind `if constexpr (bio::PROFILE_ENABLED)`, so a build
+// with -DBIO_PROFILE=0 compiles them out. Times are in CPU ticks.
+struct alignas(64) MappingProfile {
+    // Where mapReads finished with a read
+    enum Exit { SkippedN, ExactMatch, NoCandidates, Verified, NotVerified, MateWindow, MateSearch, CacheHit,
+                NUM_EXITS };
+    static constexpr const char* EXIT_NAMES[NUM_EXITS] = {
+        "skipped_n", "exact_match", "no_candidates", "verified_mapped", "verified_unmapped", "mate_window",
+        "mate_search", "cache_hit"};
+    // Parse runs on the reader thread, the rest per read on the workers
+    enum Stage { Parse, Cache, Exact, Seeding, Verify, Coverage, Output, NUM_STAGES };
+    static constexpr const char* STAGE_NAMES[NUM_STAGES] = {
+        "parse", "read_cache", "exact_match", "seeding", "verify", "coverage", "output"};
     
-    // Skip reads starting with N (common Illumina artifact)
-    if (!read.empty() && read[0] == 'N') return result;
+    array<long long, NUM_EXITS> exits{};
+    array<uint64_t, NUM_STAGES> stage_ticks{};
+    long long sa_probes = 0;            // suffix-array (or FM-index) interval searches
+    long long sa_locates = 0;           // rows turned into genome positions
+    long long minimizer_lookups = 0;
+    long long edit_distance_calls = 0;  // candidate windows verified
+    long long mate_searches = 0;        // insert windows searched for a mate (paired mode)
+    long long cache_ticks_saved = 0;    // mapping ticks of the read cache's hits, less all its probes
+    long long heap_allocations = 0;     // while mapping, recording coverage and formatting SAM
+    bio::LogHistogram candidates;       // candidates verified per read
+    bio::LogHistogram latency;          // ticks per read: share of the batched lookups, then its own work to output
     
-    // Try exact match first (fast path)
-    int lo = bio::suffixArrayLowerBound(genome, sa, read);
-    int hi = bio::suffixArrayUpperBound(genome, sa, read);
-    
-    if (hi > lo) {
-        if (hi - lo == 1) {
-            result.status = MapStatus::Unique;
-            result.position = sa[lo];
-            result.edit_dist = 0;
+    void exit(Exit e) {
+        if constexpr (bio::PROFILE_ENABLED) exits[e]++;
+    }
+    
+    void count(long long& counter, long long n = 1) {
+        if constexpr (bio::PROFILE_ENABLED) counter += n;
+    }
+    
+    // Charge the ticks since `since` to stage and restart the clock
+    void lap(Stage stage, uint64_t& since) {
+        if constexpr (bio::PROFILE_ENABLED) {
+            uint64_t now = bio::profileTicks();
+            stage_ticks[stage] += now - since;
+            since = now;
+        }
+    }
+    
+    void read(int num_candidates, uint64_t start, uint64_t end) {
+        if constexpr (bio::PROFILE_ENABLED) {
+            candidates.add(num_candidates);
+            latency.add(end - start);
+        }
+    }
+    
+    void merge(const MappingProfile& other) {
+        for (int i = 0; i < NUM_EXITS; i++) exits[i] += other.exits[i];
+        for (int i = 0; i < NUM_STAGES; i++) stage_ticks[i] += other.stage_ticks[i];
+        sa_probes += other.sa_probes;
+        sa_locates += other.sa_locates;
+        minimizer_lookups += other.minimizer_lookups;
+        edit_distance_calls += other.edit_distance_calls;
+        mate_searches += other.mate_searches;
+        cache_ticks_saved += other.cache_ticks_saved;
+        heap_allocations += other.heap_allocations;
+        candidates.merge(other.candidates);
+        latency.merge(other.latency);
+    }
+};
+
+// Reference with its lookup structure: the suffix array with its LCP-LR
+// tables, or an FM-index (which answers the same [lo, hi) intervals in ~0.7
+// bytes per base). The genome is kept 2-bit packed.
+struct ReferenceIndex {
+    const bio::PackedSequence* genome = nullptr;
+    span<const int> sa;
+    span<const uint8_t> lcp_left, lcp_right;
+    span<const uint32_t> prefix_table;  // k-mer prefix table; LCP-LR search if empty
+    const bio::FMIndex* fm = nullptr;
+    const bio::MinimizerIndex* minimizers = nullptr;  // seeding with -x minimizer
+    bool mem_seeding = false;                          // seeding with -x smem (suffix array only)
+    const bio::ContigTable* contigs = nullptr;        // the genome's records
+    
+    // Suffix-array interval [lo, hi) of genome positions starting with each
+    // pattern; the suffix-array searches run interleaved in `batch`
+    void findAll(span<const string_view> patterns, span<pair<int, int>> out, bio::SuffixArrayBatch& batch) const {
+        if (fm) {
+            for (size_t i = 0; i < patterns.size(); i++) out[i] = fm->backwardSearch(patterns[i]);
+        } else if (!prefix_table.empty()) {
+            batch.ranges(*genome, sa, prefix_table, patterns, out);
         } else {
-            result.status = MapStatus::Multi;
-            result.position = sa[lo];
-            result.edit_dist = 0;
+            batch.ranges(*genome, sa, lcp_left, lcp_right, patterns, out);
         }
-        return result;
     }
     
-    // Seed-and-extend: try multiple seeds
-    vector<int> candidates;
+    // Genome position of suffix-array row
+    int position(int row) const {
+        return fm ? fm->locate(row) : sa[row];
+    }
+    
+    // True if the window [pos, pos + len) runs from one record into the
+    // next. Only a window holding a gap, i.e. an ambiguous base, can, so the
+    // contig lookup is skipped for nearly all windows.
+    bool crossesContigs(int pos, int len) const {
+        return contigs->size() > 1 && genome->hasAmbiguous(pos, len) && !contigs->contains(pos, len);
+    }
+    
+    size_t contigOf(int pos) const {
+        return contigs->find(pos);
+    }
+};
+
+// A seed lookup of fixed seeding: the genome start of a hit is its position
+// minus read_offset, on the forward (strand 0) or reverse strand
+struct SeedLookup {
+    int read_offset;
+    int strand;
+};
+
+// Fixed seeding: num_seeds seeds at evenly spaced offsets, appended to
+// patterns for a batched lookup. Seeds are taken from the forward read; the
+// reverse complement of each seed is the matching seed of the reverse strand
+// (a substring of rc), so both strands share seed selection and the N check.
+void fixedSeeds(string_view read, string_view rc, int seed_len, bool map_rc, vector<string_view>& patterns,
+                vector<SeedLookup>& seeds) {
     int num_seeds = 3;
     int step = (read.size() - seed_len) / max(1, num_seeds - 1);
     
     for (int i = 0; i < num_seeds && i * step + seed_len <= (int)read.size(); i++) {
-        string seed = read.substr(i * step, seed_len);
+        string_view seed = read.substr(i * step, seed_len);
         
         // Skip seeds with N
-        if (seed.find('N') != string::npos) continue;
+        if (seed.find('N') != string_view::npos) continue;
         
-        int slo = bio::suffixArrayLowerBound(genome, sa, seed);
-        int shi = bio::suffixArrayUpperBound(genome, sa, seed);
-        
-        // Limit candidates per seed to avoid explosion
-        int max_hits = 100;
-        for (int j = slo; j < shi && j < slo + max_hits; j++) {
-            int genome_start = sa[j] - i * step;
-            if (genome_start >= 0 && genome_start + (int)read.size() <= (int)genome.size()) {
-                candidates.push_back(genome_start);
+        patterns.push_back(seed);
+        seeds.push_back({i * step, 0});
+        if (map_rc) {
+            int rc_offset = read.size() - i * step - seed_len;
+            patterns.push_back(rc.substr(rc_offset, seed_len));
+            seeds.push_back({rc_offset, 1});
+        }
+    }
+}
+
+// Candidates of fixed seeding from the looked-up seed intervals
+void fixedSeedCandidates(const ReferenceIndex& ref, int read_len, span<const pair<int, int>> ranges,
+                         span<const SeedLookup> seeds, vector<int> candidates[2], MappingProfile& profile) {
+    // Limit candidates per seed to avoid explosion
+    int max_hits = 100;
+    for (size_t s = 0; s < seeds.size(); s++) {
+        auto [lo, hi] = ranges[s];
+        profile.count(profile.sa_locates, min(hi - lo, max_hits));
+        for (int j = lo; j < hi && j < lo + max_hits; j++) {
+            int genome_start = ref.position(j) - seeds[s].read_offset;
+            if (genome_start >= 0 && genome_start + read_len <= (int)ref.genome->size()) {
+                candidates[seeds[s].strand].push_back(genome_start);
             }
         }
     }
+}
+
+// A minimizer hit as a read placement, for chaining
+struct MinimizerAnchor {
+    int strand;  // 0: read on the forward strand, 1: reverse complement
+    int start;   // implied genome start of the read on that strand
+    int qpos;    // minimizer position in the read
+};
+
+// Buffers of minimizerCandidates, reused across reads
+struct MinimizerScratch {
+    vector<bio::Minimizer> minimizers;
+    vector<span<const uint32_t>> hits;
+    vector<MinimizerAnchor> anchors;
+};
+
+// Minimizer seeding: look up the read's minimizers and chain the hits that lie
+// on the same strand and diagonal (genome start), allowing max_errors of
+// indel drift along a chain. Minimizers with more than max_occ hits are
+// repeats and skipped, unless the read has no other. Only the chains with the
+// most anchors become candidates, so repeats hit by a single minimizer are
+// not verified. Each chosen chain is verified once, at its lead: the anchor
+// nearest the start of the read's genome span, so the indel drift of the
+// anchors after it stays within the max_errors the verification allows.
+void minimizerCandidates(const ReferenceIndex& ref, string_view read, int max_errors, bool map_rc,
+                         vector<int> candidates[2], MinimizerScratch& scratch, MappingProfile& profile) {
+    const bio::MinimizerIndex& index = *ref.minimizers;
+    const int max_occ = 100;
+    int k = index.k(), len = read.size(), genome_size = ref.genome->size();
     
-    if (candidates.empty()) return result;
+    vector<bio::Minimizer>& mins = scratch.minimizers;
+    mins.clear();
+    bio::computeMinimizers(read, k, index.w(), mins);
     
-    // Remove duplicates
-    sort(candidates.begin(), candidates.end());
-    candidates.erase(unique(candidates.begin(), candidates.end()), candidates.end());
+    using Anchor = MinimizerAnchor;
+    vector<Anchor>& anchors = scratch.anchors;
+    anchors.clear();
+    auto addAnchors = [&](const bio::Minimizer& m, span<const uint32_t> hits) {
+        for (uint32_t hit : hits) {
+            int tpos = hit >> 1;
+            int strand = m.reverse != (hit & 1);
+            if (strand == 1 && !map_rc) continue;
+            // On the reverse strand the k-mer sits at len - pos - k of the reverse complement
+            int start = tpos - (strand == 0 ? (int)m.pos : len - (int)m.pos - k);
+            if (start >= 0 && start + len <= genome_size) anchors.push_back({strand, start, (int)m.pos});
+        }
+    };
     
-    // Verify candidates with edit distance
+    vector<span<const uint32_t>>& hits = scratch.hits;
+    hits.resize(mins.size());
+    index.findAll(mins, hits);
+    profile.count(profile.minimizer_lookups, mins.size());
+    size_t rarest = mins.size();
+    for (size_t i = 0; i < mins.size(); i++) {
+        if (hits[i].size() <= (size_t)max_occ) {
+            addAnchors(mins[i], hits[i]);
+        } else if (rarest == mins.size() || hits[i].size() < hits[rarest].size()) {
+            rarest = i;
+        }
+    }
+    if (anchors.empty() && rarest < mins.size()) addAnchors(mins[rarest], hits[rarest].first(max_occ));
+    if (anchors.empty()) return;
+    
+    // Chain anchors along each diagonal band; a chain's score is its number of
+    // distinct read positions
+    sort(anchors.begin(), anchors.end(), [](const Anchor& a, const Anchor& b) {
+        return a.strand != b.strand ? a.strand < b.strand : a.start != b.start ? a.start < b.start : a.qpos < b.qpos;
+    });
+    // Calls f(score, lead) per chain, lead being the anchor nearest the start
+    // of the read's genome span (on the reverse strand the one furthest along
+    // the forward read). Chains are short, so duplicates are found by scanning.
+    auto forEachChain = [&](auto&& f) {
+        for (size_t i = 0; i < anchors.size();) {
+            size_t j = i, lead = i;
+            int score = 0;
+            for (; j < anchors.size() && anchors[j].strand == anchors[i].strand &&
+                   anchors[j].start - anchors[i].start <= max_errors; j++) {
+                const Anchor& a = anchors[j];
+                bool seen = false;
+                for (size_t p = i; p < j && !seen; p++) seen = anchors[p].qpos == a.qpos;
+                score += !seen;
+                if (a.strand == 0 ? a.qpos < anchors[lead].qpos : a.qpos > anchors[lead].qpos) lead = j;
+            }
+            f(score, anchors[lead]);
+            i = j;
+        }
+    };
+    int best_score = 0;
+    forEachChain([&](int score, const Anchor&) { best_score = max(best_score, score); });
+    forEachChain([&](int score, const Anchor& lead) {
+        if (score == best_score) candidates[lead.strand].push_back(lead.start);
+    });
+}
+
+// A maximal exact match of -x smem seeding: bases [qpos, qpos + len) of read
+// `read` on strand `strand` occur at suffix-array rows [lo, hi). Intervals
+// scanned around an insertion point stop past MEM_MAX_OCC rows.
+struct MemSeed {
+    int read;  // index among the reads given to memSeeds
+    int strand;
+    int qpos, len;
+    int lo, hi;
+};
+
+// Seeds with more hits are repeats, used only if a read has no other
+constexpr int MEM_MAX_OCC = 100;
+
+// A MEM hit as a read placement, for chaining
+struct MemAnchor {
+    int strand;
+    int start;  // implied genome start of the read on that strand
+    int mem;    // index of the MEM
+};
+
+// Buffers of memSeeds and memCandidates, reused across reads
+struct MemScratch {
+    struct Cursor {
+        int read, strand, q, end;  // next match starts at q, in an N-free stretch ending at end
+    };
+    vector<Cursor> cursors;
+    vector<string_view> patterns;
+    vector<size_t> lookups;                 // cursor of each pattern
+    vector<pair<int, int>> lookup_ranges;
+    vector<pair<int, int>> ranges;          // interval of each cursor's stretch
+    vector<int> lens;                       // its longest match
+    vector<MemSeed> found;
+    vector<size_t> slots;
+    vector<int> covered;                    // read bases in MEMs, per read and strand
+    vector<MemAnchor> anchors;
+    vector<pair<int, int>> spans;           // read bases of a chain's MEMs
+};
+
+// Candidates of MEM seeding from a read's MEMs: their hits are chained along
+// diagonals like minimizer hits (see minimizerCandidates), a chain scoring the
+// read bases its MEMs cover. Only chains scoring at least half the best are
+// verified (like BWA-MEM's chain filter), each at its lead: its MEM nearest
+// the read start, as an indel shifts the diagonal.
+// MEMs with more than MEM_MAX_OCC hits are skipped unless the read has no
+// other, then the first rows of its longest one are used.
+void memCandidates(const ReferenceIndex& ref, int read_len, span<const MemSeed> mems, int max_errors,
+                   vector<int> candidates[2], MemScratch& scratch, MappingProfile& profile) {
+    int genome_size = ref.genome->size();
+    using Anchor = MemAnchor;
+    vector<Anchor>& anchors = scratch.anchors;
+    anchors.clear();
+    auto addAnchors = [&](size_t m, int max_hits) {
+        const MemSeed& mem = mems[m];
+        profile.count(profile.sa_locates, min(mem.hi - mem.lo, max_hits));
+        for (int row = mem.lo; row < mem.hi && row < mem.lo + max_hits; row++) {
+            // On the reverse strand, qpos is a position in the reverse complement
+            int start = ref.position(row) - mem.qpos;
+            if (start >= 0 && start + read_len <= genome_size) anchors.push_back({mem.strand, start, (int)m});
+        }
+    };
+    size_t longest = mems.size();
+    for (size_t m = 0; m < mems.size(); m++) {
+        if (mems[m].hi - mems[m].lo <= MEM_MAX_OCC) {
+            addAnchors(m, MEM_MAX_OCC);
+        } else if (longest == mems.size() || mems[m].len > mems[longest].len) {
+            longest = m;
+        }
+    }
+    if (anchors.empty() && longest < mems.size()) addAnchors(longest, MEM_MAX_OCC);
+    if (anchors.empty()) return;
+    
+    sort(anchors.begin(), anchors.end(), [](const Anchor& a, const Anchor& b) {
+        return a.strand != b.strand ? a.strand < b.strand : a.start < b.start;
+    });
+    // Calls f(score, lead) per chain
+    auto forEachChain = [&](auto&& f) {
+        for (size_t i = 0; i < anchors.size();) {
+            size_t j = i, lead = i;
+            vector<pair<int, int>>& spans = scratch.spans;
+            spans.clear();
+            for (; j < anchors.size() && anchors[j].strand == anchors[i].strand &&
+                   anchors[j].start - anchors[i].start <= max_errors; j++) {
+                const MemSeed& mem = mems[anchors[j].mem];
+                spans.push_back({mem.qpos, mem.qpos + mem.len});
+                if (mem.qpos < mems[anchors[lead].mem].qpos) lead = j;
+            }
+            // Read bases covered; a re-seed overlaps its MEM
+            sort(spans.begin(), spans.end());
+            int score = 0, covered = 0;
+            for (auto [from, to] : spans) {
+                score += max(0, to - max(from, covered));
+                covered = max(covered, to);
+            }
+            f(score, anchors[lead]);
+            i = j;
+        }
+    };
+    int best_score = 0;
+    forEachChain([&](int score, const Anchor&) { best_score = max(best_score, score); });
+    forEachChain([&](int score, const Anchor& lead) {
+        if (2 * score >= best_score) candidates[lead.strand].push_back(lead.start);
+    });
+}
+
+// Reads mapped together by mapReads: enough lookups to keep the batched
+// suffix-array search full, few enough for the group to stay in cache
+constexpr size_t MAP_GROUP_SIZE = 256;
+
+// Buffers of mapReads and mapPairs, kept by each worker across groups of reads
+struct MappingScratch {
+    static constexpr size_t NOT_PENDING = SIZE_MAX;
+    // Progress of a read in mapPairs: settled by its exact lookup, with seed
+    // lookups, left without them for a search near its mate, or verified
+    // genome-wide
+    enum class ReadState : char { Settled, Seeded, Deferred, Verified };
+    
+    bio::SuffixArrayBatch batch;
+    vector<string> rc;                 // reverse complement of each read
+    vector<char> map_rc;               // map the reverse strand (rc differs from the read)
+    vector<string_view> patterns;      // lookups of the current stage
+    vector<pair<int, int>> exact;      // suffix-array intervals of the exact-match lookups
+    vector<size_t> first;              // first exact lookup of each read, then the end
+    vector<pair<int, int>> ranges;     // suffix-array intervals of the seed lookups
+    vector<size_t> pending;            // reads without an exact match
+    vector<size_t> pending_index;      // index of each read in pending, or NOT_PENDING
+    vector<SeedLookup> seeds;
+    vector<size_t> seed_first;         // first seed (or MEM) of each pending read, then the end
+    vector<int> candidates[2];         // forward, reverse
+    vector<int> dists[2];
+    bio::BitParallelPattern pattern;   // verification kernel, reassigned per read and strand
+    MinimizerScratch minimizer;
+    MemScratch mem;
+    vector<MemSeed> mems;              // MEMs of the pending reads (-x smem)
+    vector<uint64_t> ticks;            // mapping ticks of each read
+    
+    // Paired mode: each mate's own candidates, those inside the insert
+    // window, and the read k-mer table of a window search
+    vector<int> mate_candidates[2][2];
+    vector<int> mate_dists[2][2];
+    vector<int> window_candidates[2];
+    vector<ReadState> state;
+    vector<uint64_t> kmer_table;
+    vector<string_view> own_patterns;  // seed lookups of a read left out of the batch
+    vector<SeedLookup> own_seeds;
+    vector<pair<int, int>> own_ranges;
+    vector<MemSeed> own_mems;
+    vector<size_t> own_first;
+    
+    // Read cache (mapCached): each read's key, and the reads it missed,
+    // mapped together
+    vector<bio::SequenceKey> keys;
+    vector<size_t> misses;
+    vector<bio::FastqRecord> miss_reads;
+    vector<MappingResult> miss_results;
+    vector<uint64_t> miss_ticks;
+};
+
+// Results of mapped reads by sequence (--read-cache)
+using ReadCache = bio::ResultCache<MappingResult>;
+
+// Place a read at the best of its verified candidates (dists[strand][c] is
+// the distance at candidates[strand][c]); returns true if one is within
+// max_errors, and otherwise leaves the result as it was
+bool pickBest(const vector<int> candidates[2], const vector<int> dists[2], int max_errors, MappingResult& result) {
     int best_dist = max_errors + 1;
     int best_pos = -1;
-    int best_count = 0;
+    bool best_reverse = false;
+    for (int strand = 0; strand < 2; strand++) {
+        for (size_t c = 0; c < candidates[strand].size(); c++) {
+            if (dists[strand][c] < best_dist) {
+                best_dist = dists[strand][c];
+                best_pos = candidates[strand][c];
+                best_reverse = strand == 1;
+            }
+        }
+    }
+    if (best_dist > max_errors) return false;
     
-    for (int cand : candidates) {
-        string ref_seg = genome.substr(cand, read.size());
-        int dist = bio::editDistance<10>(ref_seg, read);
+    // Next best locus; shifted windows of the best one do not count,
+    // so a read is Multi exactly when another locus is as good (MAPQ 0)
+    int second_dist = max_errors + 1;
+    for (int strand = 0; strand < 2; strand++) {
+        for (size_t c = 0; c < candidates[strand].size(); c++) {
+            bool same_locus = (strand == 1) == best_reverse && abs(candidates[strand][c] - best_pos) <= max_errors;
+            if (!same_locus) second_dist = min(second_dist, dists[strand][c]);
+        }
+    }
+    result.status = second_dist == best_dist ? MapStatus::Multi : MapStatus::Unique;
+    result.position = best_pos;
+    result.reverse = best_reverse;
+    result.edit_dist = best_dist;
+    result.mapq = second_dist > max_errors ? 60 : min(60, 20 * (second_dist - best_dist));
+    return true;
+}
+
+// Verify the candidates of each strand with the batched bit-parallel kernel,
+// then pickBest; returns true if the read maps
+bool verifyCandidates(const ReferenceIndex& ref, string_view read, string_view rc, int max_errors,
+                      vector<int> candidates[2], vector<int> dists[2], bio::BitParallelPattern& pattern,
+                      MappingResult& result, MappingProfile& profile) {
+    const bio::PackedSequence& genome = *ref.genome;
+    for (int strand = 0; strand < 2; strand++) {
+        vector<int>& cands = candidates[strand];
+        if (cands.empty()) continue;
+        
+        // Remove duplicates, and windows spanning two reference records
+        sort(cands.begin(), cands.end());
+        cands.erase(unique(cands.begin(), cands.end()), cands.end());
+        erase_if(cands, [&](int c) { return ref.crossesContigs(c, read.size()); });
+        if (cands.empty()) continue;
         
-        if (dist < best_dist) {
-            best_dist = dist;
-            best_pos = cand;
-            best_count = 1;
-        } else if (dist == best_dist && cand != best_pos) {
-            best_count++;
+        result.candidates += cands.size();
+        profile.count(profile.edit_distance_calls, cands.size());
+        pattern.assign(strand == 0 ? read : rc);
+        dists[strand].resize(cands.size());
+        pattern.distances(genome, cands, read.size(), max_errors, dists[strand]);
+    }
+    return pickBest(candidates, dists, max_errors, result);
+}
+
+// First stage of mapReads: the batched exact-match lookups of every read and
+// its reverse complement, which settle the reads with an exact match (or
+// starting with N) and list the others in scratch.pending. Sets
+// scratch.ticks[i] to read i's share of the lookups.
+void exactLookups(const ReferenceIndex& ref, span<const bio::FastqRecord> reads, bool forward_only,
+                  span<MappingResult> results, MappingScratch& scratch, MappingProfile& profile) {
+    size_t n = reads.size();
+    uint64_t clock = bio::profileTicks(), start = clock;
+    
+    // Try exact match first (fast path)
+    if (scratch.rc.size() < n) scratch.rc.resize(n);  // never shrink: the strings keep their capacity
+    scratch.map_rc.assign(n, false);
+    scratch.first.resize(n + 1);
+    scratch.patterns.clear();
+    for (size_t i = 0; i < n; i++) {
+        string_view read = reads[i].seq;
+        results[i] = {MapStatus::Unmapped, -1, -1};
+        scratch.first[i] = scratch.patterns.size();
+        
+        // Skip reads starting with N (common Illumina artifact), and empty
+        // reads, which would match everywhere (both counted as skipped_n)
+        if (read.empty() || read[0] == 'N') continue;
+        
+        scratch.patterns.push_back(read);
+        if (forward_only) {
+            scratch.rc[i].clear();
+            continue;
         }
+        scratch.rc[i].resize(read.size());
+        for (size_t j = 0; j < read.size(); j++) scratch.rc[i][j] = bio::complementBase(read[read.size() - 1 - j]);
+        // A reverse-complement palindrome has the same hits on both strands; map it once
+        scratch.map_rc[i] = scratch.rc[i] != read;
+        if (scratch.map_rc[i]) scratch.patterns.push_back(scratch.rc[i]);
     }
+    scratch.first[n] = scratch.patterns.size();
+    scratch.exact.resize(scratch.patterns.size());
+    ref.findAll(scratch.patterns, scratch.exact, scratch.batch);
+    profile.count(profile.sa_probes, scratch.patterns.size());
     
-    if (best_dist <= max_errors) {
-        if (best_count == 1) {
-            result.status = MapStatus::Unique;
+    scratch.pending.clear();
+    for (size_t i = 0; i < n; i++) {
+        size_t p = scratch.first[i];
+        if (p == scratch.first[i + 1]) {
+            profile.exit(MappingProfile::SkippedN);
+            continue;
+        }
+        auto [lo, hi] = scratch.exact[p];
+        auto [rlo, rhi] = scratch.map_rc[i] ? scratch.exact[p + 1] : pair<int, int>{0, 0};
+        int exact_hits = (hi - lo) + (rhi - rlo);
+        int position = exact_hits ? ref.position(hi == lo ? rlo : lo) : 0;
+        // An N of the read can match the gap between two records
+        if (exact_hits == 0 || ref.crossesContigs(position, reads[i].seq.size())) {
+            scratch.pending.push_back(i);
+            continue;
+        }
+        MappingResult& result = results[i];
+        profile.count(profile.sa_locates);
+        profile.exit(MappingProfile::ExactMatch);
+        result.status = exact_hits == 1 ? MapStatus::Unique : MapStatus::Multi;
+        result.reverse = hi == lo;
+        result.position = position;
+        result.edit_dist = 0;
+        result.mapq = exact_hits == 1 ? 60 : 0;
+    }
+    profile.lap(MappingProfile::Exact, clock);
+    scratch.ticks.assign(n, n ? (clock - start) / n : 0);
+}
+
+// Maximal exact match seeding over the suffix array, for the reads `which`
+// (their reverse complements in rc, mapped if map_rc). Each strand is covered
+// greedily from the left: the longest match starting at q becomes a seed if
+// it has min_len bases or more, and the next search starts past the base that
+// ended it, so a read with e errors gets about e + 1 seeds as long as the
+// stretches between errors allow, and a seed in a repeat extends until the
+// copies differ. A search looks up the rest of the stretch in one batched
+// lookup: if it does not occur, the longest match is shared with one of the
+// two suffixes around its insertion point, and its interval is scanned from
+// there. Then each MEM of at least 2 * min_len bases with few hits is
+// re-seeded with the min_len bases at its middle, which also hit loci where
+// the read differs beyond the MEM (as in BWA-MEM): kept if they hit more. A
+// read without N starts from its exact-match lookups (see exactLookups). The
+// MEMs of reads[which[k]] end up in mems[mem_first[k], mem_first[k + 1]).
+void memSeeds(const ReferenceIndex& ref, span<const bio::FastqRecord> reads, span<const size_t> which, int min_len,
+              MappingScratch& scratch, vector<MemSeed>& mems, vector<size_t>& mem_first, MappingProfile& profile) {
+    const int reseed_occ = 10;
+    const bio::PackedSequence& genome = *ref.genome;
+    int rows = ref.sa.size();
+    MemScratch& ms = scratch.mem;
+    auto strandSeq = [&](int k, int strand) -> string_view {
+        return strand ? scratch.rc[which[k]] : reads[which[k]].seq;
+    };
+    
+    // Move c to the next N-free stretch of min_len bases or more from c.q; false if none
+    auto nextStretch = [&](MemScratch::Cursor& c) {
+        string_view s = strandSeq(c.read, c.strand);
+        while (c.q + min_len <= (int)s.size()) {
+            size_t n = s.find('N', c.q);
+            c.end = n == string_view::npos ? s.size() : n;
+            if (c.end - c.q >= min_len) return true;
+            c.q = c.end + 1;
+        }
+        return false;
+    };
+    vector<MemScratch::Cursor>& cursors = ms.cursors;
+    cursors.clear();
+    for (size_t k = 0; k < which.size(); k++) {
+        size_t i = which[k];
+        for (int strand = 0; strand < 1 + scratch.map_rc[i]; strand++) {
+            MemScratch::Cursor c{(int)k, strand, 0, 0};
+            if (nextStretch(c)) cursors.push_back(c);
+        }
+    }
+    // Bases of c's stretch shared with the suffix at row
+    auto matchAt = [&](int row, const MemScratch::Cursor& c) {
+        string_view stretch = strandSeq(c.read, c.strand).substr(c.q, c.end - c.q);
+        return row >= 0 && row < rows ? (int)genome.commonPrefix(ref.sa[row], stretch) : 0;
+    };
+    
+    vector<MemSeed>& found = ms.found;
+    found.clear();
+    vector<int>& covered = ms.covered;
+    covered.assign(2 * which.size(), 0);
+    for (bool first_round = true; !cursors.empty(); first_round = false) {
+        // Look up the rest of each stretch, but for the whole read, whose
+        // interval is known
+        ms.patterns.clear();
+        ms.lookups.clear();
+        ms.ranges.resize(cursors.size());
+        for (size_t j = 0; j < cursors.size(); j++) {
+            const MemScratch::Cursor& c = cursors[j];
+            size_t i = which[c.read], e = scratch.first[i] + c.strand;
+            string_view s = strandSeq(c.read, c.strand);
+            if (first_round && c.q == 0 && c.end == (int)s.size() && e < scratch.first[i + 1]) {
+                ms.ranges[j] = scratch.exact[e];
+            } else {
+                ms.patterns.push_back(s.substr(c.q, c.end - c.q));
+                ms.lookups.push_back(j);
+            }
+        }
+        ms.lookup_ranges.resize(ms.patterns.size());
+        ref.findAll(ms.patterns, ms.lookup_ranges, scratch.batch);
+        profile.count(profile.sa_probes, ms.patterns.size());
+        for (size_t l = 0; l < ms.lookups.size(); l++) ms.ranges[ms.lookups[l]] = ms.lookup_ranges[l];
+        // The suffixes around each insertion point, then their text, so that
+        // the cache misses of the comparisons below overlap
+        for (auto [lo, hi] : ms.ranges) {
+            if (lo == hi && lo > 0) __builtin_prefetch(&ref.sa[lo - 1]);
+        }
+        for (auto [lo, hi] : ms.ranges) {
+            if (lo == hi && lo > 0) genome.prefetch(ref.sa[lo - 1]);
+            if (lo == hi && lo < rows) genome.prefetch(ref.sa[lo]);
+        }
+        
+        // The longest match of a stretch that does not occur is shared with
+        // one of the suffixes around its insertion point (lo = hi)
+        ms.lens.resize(cursors.size());
+        for (size_t j = 0; j < cursors.size(); j++) {
+            const MemScratch::Cursor& c = cursors[j];
+            auto& [lo, hi] = ms.ranges[j];
+            ms.lens[j] = c.end - c.q;
+            if (lo < hi) continue;
+            int before = matchAt(lo - 1, c), after = matchAt(lo, c);
+            ms.lens[j] = max(before, after);
+            if (before == ms.lens[j]) lo--;
+            if (after == ms.lens[j]) hi++;
+            if (ms.lens[j] >= min_len) {
+                if (lo > 0) genome.prefetch(ref.sa[lo - 1]);
+                if (hi < rows) genome.prefetch(ref.sa[hi]);
+            }
+        }
+        
+        // Widen those to every row sharing the match, then move on past it
+        size_t kept = 0;
+        for (size_t j = 0; j < cursors.size(); j++) {
+            MemScratch::Cursor c = cursors[j];
+            auto [lo, hi] = ms.ranges[j];
+            int len = ms.lens[j];
+            if (len >= min_len) {
+                if (len < c.end - c.q) {
+                    while (hi - lo <= MEM_MAX_OCC && matchAt(lo - 1, c) >= len) lo--;
+                    while (hi - lo <= MEM_MAX_OCC && matchAt(hi, c) >= len) hi++;
+                }
+                found.push_back({c.read, c.strand, c.q, len, lo, hi});
+                covered[2 * c.read + c.strand] += len;
+            }
+            c.q += len + 1;
+            if (nextStretch(c)) cursors[kept++] = c;
+        }
+        cursors.resize(kept);
+        // A strand without a MEM yet gives up once the other strand's cover
+        // half the read: its matches are chance ones, which end every ~log4(n)
+        // bases and would take most of the searches
+        erase_if(cursors, [&](const MemScratch::Cursor& c) {
+            return covered[2 * c.read + c.strand] == 0 &&
+                   2 * covered[2 * c.read + !c.strand] >= (int)strandSeq(c.read, c.strand).size();
+        });
+    }
+    
+    // Re-seed long MEMs with few hits
+    ms.patterns.clear();
+    size_t num_found = found.size();
+    for (size_t m = 0; m < num_found; m++) {
+        const MemSeed& mem = found[m];
+        if (mem.len < 2 * min_len || mem.hi - mem.lo > reseed_occ) continue;
+        int qpos = mem.qpos + (mem.len - min_len) / 2;
+        ms.patterns.push_back(strandSeq(mem.read, mem.strand).substr(qpos, min_len));
+        found.push_back({mem.read, mem.strand, qpos, min_len, (int)m, 0});  // lo: its MEM, until looked up
+    }
+    ms.ranges.resize(ms.patterns.size());
+    ref.findAll(ms.patterns, ms.ranges, scratch.batch);
+    profile.count(profile.sa_probes, ms.patterns.size());
+    size_t kept = num_found;
+    for (size_t j = 0; j < ms.patterns.size(); j++) {
+        MemSeed seed = found[num_found + j];
+        const MemSeed& mem = found[seed.lo];
+        tie(seed.lo, seed.hi) = ms.ranges[j];
+        if (seed.hi - seed.lo > mem.hi - mem.lo) found[kept++] = seed;
+    }
+    found.resize(kept);
+    
+    // Group by read
+    mem_first.assign(which.size() + 1, 0);
+    for (const MemSeed& mem : found) mem_first[mem.read + 1]++;
+    for (size_t k = 0; k < which.size(); k++) mem_first[k + 1] += mem_first[k];
+    mems.resize(found.size());
+    ms.slots.assign(mem_first.begin(), mem_first.end() - 1);
+    for (const MemSeed& mem : found) mems[ms.slots[mem.read]++] = mem;
+}
+
+// Second stage: the batched seed lookups of the reads in scratch.pending
+// (minimizer seeding has its own index; MEM seeding finds the MEMs of all of
+// them, see memSeeds), adding their share to scratch.ticks
+void seedLookups(const ReferenceIndex& ref, span<const bio::FastqRecord> reads, int seed_len, MappingScratch& scratch,
+                 MappingProfile& profile) {
+    uint64_t clock = bio::profileTicks(), start = clock;
+    scratch.pending_index.assign(reads.size(), MappingScratch::NOT_PENDING);
+    for (size_t k = 0; k < scratch.pending.size(); k++) scratch.pending_index[scratch.pending[k]] = k;
+    if (ref.mem_seeding) {
+        memSeeds(ref, reads, scratch.pending, seed_len, scratch, scratch.mems, scratch.seed_first, profile);
+    } else {
+        scratch.patterns.clear();
+        scratch.seeds.clear();
+        scratch.seed_first.assign(1, 0);
+        for (size_t i : scratch.pending) {
+            if (!ref.minimizers) {
+                fixedSeeds(reads[i].seq, scratch.rc[i], seed_len, scratch.map_rc[i], scratch.patterns, scratch.seeds);
+            }
+            scratch.seed_first.push_back(scratch.patterns.size());
+        }
+        scratch.ranges.resize(scratch.patterns.size());
+        ref.findAll(scratch.patterns, scratch.ranges, scratch.batch);
+        profile.count(profile.sa_probes, scratch.patterns.size());
+    }
+    profile.lap(MappingProfile::Seeding, clock);
+    
+    if (scratch.pending.empty()) return;
+    uint64_t share = (clock - start) / scratch.pending.size();
+    for (size_t i : scratch.pending) scratch.ticks[i] += share;
+}
+
+// Candidate loci of read i per strand, from its batched seed lookups (see
+// seedLookups), or from lookups of its own if it had none
+void gatherCandidates(const ReferenceIndex& ref, span<const bio::FastqRecord> reads, size_t i, int seed_len,
+                      int max_errors, MappingScratch& scratch, vector<int> candidates[2], MappingProfile& profile) {
+    candidates[0].clear();
+    candidates[1].clear();
+    string_view read = reads[i].seq;
+    size_t k = scratch.pending_index[i];
+    if (ref.minimizers) {
+        minimizerCandidates(ref, read, max_errors, scratch.map_rc[i], candidates, scratch.minimizer, profile);
+    } else if (ref.mem_seeding && k != MappingScratch::NOT_PENDING) {
+        size_t from = scratch.seed_first[k], to = scratch.seed_first[k + 1];
+        memCandidates(ref, read.size(), span(scratch.mems).subspan(from, to - from), max_errors, candidates,
+                      scratch.mem, profile);
+    } else if (ref.mem_seeding) {
+        memSeeds(ref, reads, span(&i, 1), seed_len, scratch, scratch.own_mems, scratch.own_first, profile);
+        memCandidates(ref, read.size(), scratch.own_mems, max_errors, candidates, scratch.mem, profile);
+    } else if (k != MappingScratch::NOT_PENDING) {
+        size_t from = scratch.seed_first[k], to = scratch.seed_first[k + 1];
+        fixedSeedCandidates(ref, read.size(), span(scratch.ranges).subspan(from, to - from),
+                            span(scratch.seeds).subspan(from, to - from), candidates, profile);
+    } else {
+        scratch.own_patterns.clear();
+        scratch.own_seeds.clear();
+        fixedSeeds(read, scratch.rc[i], seed_len, scratch.map_rc[i], scratch.own_patterns, scratch.own_seeds);
+        scratch.own_ranges.resize(scratch.own_patterns.size());
+        ref.findAll(scratch.own_patterns, scratch.own_ranges, scratch.batch);
+        profile.count(profile.sa_probes, scratch.own_patterns.size());
+        fixedSeedCandidates(ref, read.size(), scratch.own_ranges, scratch.own_seeds, candidates, profile);
+    }
+}
+
+// Map a group of reads with seed-and-extend, on both strands unless
+// forward_only. The suffix-array searches of the whole group are batched so
+// that their cache misses overlap: first the exact-match lookups of every
+// read and its reverse complement, then the seeds of the reads left without
+// one. Candidates are then gathered and verified read by read. Sets
+// scratch.ticks[i] to read i's share of the batched lookups plus its own work.
+// MAPQ is 60 unless another locus (more than max_errors away) is within
+// max_errors edits, then 20 per edit of margin, so 0 for an equally good one.
+// A unique exact match gets 60 without looking further.
+void mapReads(const ReferenceIndex& ref, span<const bio::FastqRecord> reads, int seed_len, int max_errors,
+              bool forward_only, span<MappingResult> results, MappingScratch& scratch, MappingProfile& profile) {
+    exactLookups(ref, reads, forward_only, results, scratch, profile);
+    seedLookups(ref, reads, seed_len, scratch, profile);
+    uint64_t clock = bio::profileTicks();
+    for (size_t i : scratch.pending) {
+        uint64_t read_start = clock;
+        gatherCandidates(ref, reads, i, seed_len, max_errors, scratch, scratch.candidates, profile);
+        profile.lap(MappingProfile::Seeding, clock);
+        if (scratch.candidates[0].empty() && scratch.candidates[1].empty()) {
+            profile.exit(MappingProfile::NoCandidates);
         } else {
-            result.status = MapStatus::Multi;
+            bool mapped = verifyCandidates(ref, reads[i].seq, scratch.rc[i], max_errors, scratch.candidates,
+                                           scratch.dists, scratch.pattern, results[i], profile);
+            profile.exit(mapped ? MappingProfile::Verified : MappingProfile::NotVerified);
+            profile.lap(MappingProfile::Verify, clock);
+        }
+        scratch.ticks[i] += clock - read_start;
+    }
+}
+
+// mapReads behind the read cache: a read whose sequence is cached takes the
+// cached result and is not looked up at all; the others are mapped together
+// and cached with their mapping ticks as cost. A hit verified no candidates
+// itself. Sets scratch.ticks like mapReads, a hit's being its cache probe.
+// Returns the number of hits.
+size_t mapCached(const ReferenceIndex& ref, span<const bio::FastqRecord> reads, int seed_len, int max_errors,
+                 bool forward_only, ReadCache& cache, span<MappingResult> results, MappingScratch& scratch,
+                 MappingProfile& profile) {
+    size_t n = reads.size();
+    uint64_t clock = bio::profileTicks();
+    scratch.keys.resize(n);
+    scratch.misses.clear();
+    scratch.miss_reads.clear();
+    long long saved = 0;
+    // Keys first, prefetching their sets, so that the probes' cache misses overlap
+    for (size_t i = 0; i < n; i++) {
+        scratch.keys[i] = bio::sequenceKey(reads[i].seq);
+        cache.prefetch(scratch.keys[i]);
+    }
+    for (size_t i = 0; i < n; i++) {
+        uint32_t cost;
+        if (cache.find(scratch.keys[i], results[i], cost)) {
+            results[i].candidates = 0;
+            saved += cost;
+            profile.exit(MappingProfile::CacheHit);
+        } else {
+            scratch.misses.push_back(i);
+            scratch.miss_reads.push_back(reads[i]);
+        }
+    }
+    uint64_t probes = clock;
+    profile.lap(MappingProfile::Cache, clock);
+    probes = clock - probes;
+    size_t misses = scratch.misses.size();
+    scratch.miss_results.resize(misses);
+    mapReads(ref, scratch.miss_reads, seed_len, max_errors, forward_only, scratch.miss_results, scratch, profile);
+    
+    clock = bio::profileTicks();
+    uint64_t inserts = clock;
+    scratch.miss_ticks.swap(scratch.ticks);
+    for (size_t k = 0; k < misses; k++) {
+        size_t i = scratch.misses[k];
+        results[i] = scratch.miss_results[k];
+        cache.insert(scratch.keys[i], results[i], min<uint64_t>(scratch.miss_ticks[k], UINT32_MAX));
+    }
+    profile.lap(MappingProfile::Cache, clock);
+    inserts = clock - inserts;
+    profile.count(profile.cache_ticks_saved, saved - (long long)(probes + inserts));
+    
+    scratch.ticks.assign(n, n ? probes / n : 0);
+    for (size_t k = 0; k < misses; k++) scratch.ticks[scratch.misses[k]] += scratch.miss_ticks[k] + inserts / misses;
+    return n - misses;
+}
+
+// Template lengths of proper pairs: mates on opposite strands, facing each
+// other, spanning [min, max] bases from the forward mate's start to the
+// reverse mate's end. Learned from the first pairs (see learnInsertSize);
+// empty (min > max) if too few of them map confidently.
+struct InsertSize {
+    int min = 1, max = 0;
+    int median = 0;
+    double sd = 0;
+    long long samples = 0;
+    
+    bool valid() const { return min <= max; }
+};
+
+// Longest template considered when learning the insert size
+constexpr int MAX_TEMPLATE_LENGTH = 10000;
+
+// A read that can anchor its mate: uniquely mapped with MAPQ 20 or more
+bool isAnchor(const MappingResult& result) {
+    return result.status == MapStatus::Unique && result.mapq >= 20;
+}
+
+// Both mates mapped, to the same reference record
+bool sameContig(const ReferenceIndex& ref, const MappingResult& a, const MappingResult& b) {
+    if (a.status == MapStatus::Unmapped || b.status == MapStatus::Unmapped) return false;
+    return ref.contigs->size() == 1 || ref.contigOf(a.position) == ref.contigOf(b.position);
+}
+
+// Template length of an FR pair (forward mate's start to reverse mate's
+// end), or 0 if the mates are not both mapped to one record on opposite
+// strands
+long long frTemplateLength(const ReferenceIndex& ref, const MappingResult& a, int len_a, const MappingResult& b,
+                           int len_b) {
+    if (!sameContig(ref, a, b) || a.reverse == b.reverse) return 0;
+    return a.reverse ? (long long)a.position + len_a - b.position : (long long)b.position + len_b - a.position;
+}
+
+bool properPair(const ReferenceIndex& ref, const MappingResult& a, int len_a, const MappingResult& b, int len_b,
+                const InsertSize& insert) {
+    long long tlen = frTemplateLength(ref, a, len_a, b, len_b);
+    return tlen >= insert.min && tlen <= insert.max;
+}
+
+// Insert size from the template lengths of confidently mapped pairs: the
+// median +- 4 standard deviations, estimated robustly as 1.4826 x the median
+// absolute deviation so that chimeras and mis-mapped pairs do not widen it
+InsertSize learnInsertSize(vector<int> lengths) {
+    const size_t min_samples = 100;
+    InsertSize insert;
+    insert.samples = lengths.size();
+    if (lengths.size() < min_samples) return insert;
+    auto median = [](vector<int>& v) {
+        nth_element(v.begin(), v.begin() + v.size() / 2, v.end());
+        return v[v.size() / 2];
+    };
+    insert.median = median(lengths);
+    for (int& x : lengths) x = abs(x - insert.median);
+    insert.sd = max(1.0, 1.4826 * median(lengths));
+    insert.min = max(1, (int)floor(insert.median - 4 * insert.sd));
+    insert.max = (int)ceil(insert.median + 4 * insert.sd);
+    return insert;
+}
+
+// Insert size of a read set from pairs of its mates (mates1[i] with mates2[i])
+// mapped on their own: those with both mates anchors, on opposite strands
+// facing each other, MAX_TEMPLATE_LENGTH or less apart
+InsertSize estimateInsertSize(const ReferenceIndex& ref, span<const bio::FastqRecord> mates1,
+                              span<const bio::FastqRecord> mates2, int seed_len, int max_errors) {
+    MappingScratch scratch;
+    MappingProfile profile;  // not reported: the pairs are mapped again by mapPairs
+    vector<MappingResult> results1, results2;
+    vector<int> lengths;
+    for (size_t g = 0; g < mates1.size(); g += MAP_GROUP_SIZE) {
+        size_t n = min(MAP_GROUP_SIZE, mates1.size() - g);
+        results1.resize(n);
+        results2.resize(n);
+        mapReads(ref, mates1.subspan(g, n), seed_len, max_errors, false, results1, scratch, profile);
+        mapReads(ref, mates2.subspan(g, n), seed_len, max_errors, false, results2, scratch, profile);
+        for (size_t i = 0; i < n; i++) {
+            if (!isAnchor(results1[i]) || !isAnchor(results2[i])) continue;
+            long long tlen = frTemplateLength(ref, results1[i], mates1[g + i].seq.size(), results2[i],
+                                              mates2[g + i].seq.size());
+            if (tlen > 0 && tlen <= MAX_TEMPLATE_LENGTH) lengths.push_back(tlen);
         }
-        result.position = best_pos;
-        result.edit_dist = best_dist;
     }
+    return learnInsertSize(std::move(lengths));
+}
+
+// Genome starts [lo, hi] (possibly empty) at which the mate of an anchored
+// read makes a proper pair, on the strand opposite the anchor's and within
+// the anchor's reference record
+struct MateWindow {
+    int lo, hi;
+    bool reverse;
+};
+
+MateWindow mateWindow(const ReferenceIndex& ref, const MappingResult& anchor, int anchor_len, int mate_len,
+                      const InsertSize& insert) {
+    size_t contig = ref.contigOf(anchor.position);
+    MateWindow w;
+    if (!anchor.reverse) {
+        w = {anchor.position + insert.min - mate_len, anchor.position + insert.max - mate_len, true};
+    } else {
+        w = {anchor.position + anchor_len - insert.max, anchor.position + anchor_len - insert.min, false};
+    }
+    w.lo = max<long long>(w.lo, ref.contigs->start(contig));
+    w.hi = min<long long>(w.hi, (long long)ref.contigs->end(contig) - mate_len);
+    return w;
+}
+
+// Search the mate window for a read. By the pigeonhole principle, a read
+// within max_errors edits of a locus holds one of its max_errors + 1
+// non-overlapping pieces unchanged there. Each such piece occurrence covers a
+// whole k-mer of the read starting at a window position that is a multiple of
+// step (k and step chosen from the piece length), so probing those positions
+// in a small hash table of the read's k-mers finds every start the read can
+// have in the window; they are verified like seed candidates. This finds
+// reads whose seeds all carry errors, and costs a few dozen probes of the
+// packed genome instead of suffix-array lookups across it.
+bool searchWindow(const ReferenceIndex& ref, string_view read, string_view rc, const MateWindow& window,
+                  int max_errors, MappingScratch& scratch, MappingResult& result, MappingProfile& profile) {
+    const bio::PackedSequence& genome = *ref.genome;
+    string_view seq = window.reverse ? rc : read;
+    int len = seq.size();
+    int piece = len / (max_errors + 1);
+    int k = min(16, (piece + 1) / 2), step = piece - k + 1;
+    if (k == 0 || window.lo > window.hi) return false;
+    profile.count(profile.mate_searches);
     
-    return result;
+    // Open addressing, entries (k-mer << 32 | read offset + 1), 0 = empty
+    int bits = bit_width(2u * len);
+    size_t slots = size_t(1) << bits;
+    vector<uint64_t>& table = scratch.kmer_table;
+    table.assign(slots, 0);
+    auto slot = [&](uint64_t kmer) { return size_t(kmer * 0x9E3779B97F4A7C15ULL >> (64 - bits)); };
+    uint64_t mask = (1ULL << 2 * k) - 1, code = 0;
+    for (int j = 0, valid = 0; j < len; j++) {
+        int c = bio::PackedSequence::baseCode(seq[j]);
+        valid = c < 0 ? 0 : valid + 1;  // k-mers with N are left out
+        code = (code << 2 | max(c, 0)) & mask;
+        if (valid < k) continue;
+        size_t h = slot(code);
+        while (table[h]) h = (h + 1) & (slots - 1);
+        table[h] = code << 32 | (j - k + 2);
+    }
+    
+    vector<int>* cands = scratch.window_candidates;
+    cands[0].clear();
+    cands[1].clear();
+    long long lo = max(0, window.lo - max_errors), hi = window.hi + max_errors;  // allowing indel drift
+    long long end = min<long long>(genome.size(), hi + len);
+    for (long long t = (lo + step - 1) / step * step; t + k <= end; t += step) {
+        uint64_t kmer = genome.word(t) >> (64 - 2 * k);
+        for (size_t h = slot(kmer); table[h]; h = (h + 1) & (slots - 1)) {
+            if (table[h] >> 32 != kmer) continue;
+            long long start = t - (long long)(table[h] & 0xFFFFFFFF) + 1;
+            vector<int>& out = cands[window.reverse];
+            if (start >= lo && start <= hi && start + len <= (long long)genome.size() &&
+                (out.empty() || out.back() != start)) {  // consecutive probes hit the same start
+                out.push_back(start);
+            }
+        }
+    }
+    if (cands[window.reverse].empty()) return false;
+    return verifyCandidates(ref, read, rc, max_errors, cands, scratch.dists, scratch.pattern, result, profile);
+}
+
+// Map a group of read pairs: reads[i] and reads[i + pairs] are mates, mate 1
+// first. After the batched exact-match lookups of both mates, each pair is
+// anchored on a confidently mapped mate, preferring one settled by an exact
+// match. The other mate is placed within its insert-size window (mateWindow)
+// on the opposite strand: among its exact hits there, else among its seed
+// candidates there, else by a search of the window (searchWindow). The mate of
+// an exact anchor goes straight to that search and skips the seed lookups.
+// Only if all of these fail is it mapped on its own. A mate placed by its
+// anchor has the anchor's MAPQ at most. Without an anchor, or without a
+// learned insert size, both mates are mapped on their own like mapReads.
+void mapPairs(const ReferenceIndex& ref, span<const bio::FastqRecord> reads, int seed_len, int max_errors,
+              const InsertSize& insert, span<MappingResult> results, MappingScratch& scratch,
+              MappingProfile& profile) {
+    using State = MappingScratch::ReadState;
+    size_t n = reads.size(), pairs = n / 2;
+    vector<State>& state = scratch.state;
+    exactLookups(ref, reads, false, results, scratch, profile);
+    state.assign(n, State::Settled);
+    for (size_t i : scratch.pending) state[i] = State::Seeded;
+    if (insert.valid()) {
+        for (size_t p = 0; p < pairs; p++) {
+            for (auto [a, o] : {pair{p, p + pairs}, pair{p + pairs, p}}) {
+                if (state[a] == State::Settled && isAnchor(results[a]) && state[o] == State::Seeded) {
+                    state[o] = State::Deferred;
+                }
+            }
+        }
+        erase_if(scratch.pending, [&](size_t i) { return state[i] == State::Deferred; });
+    }
+    seedLookups(ref, reads, seed_len, scratch, profile);
+    uint64_t clock = bio::profileTicks();
+    
+    // Verify a mate's candidates genome-wide (once), like mapReads; gathered
+    // if its candidates are already in scratch.mate_candidates
+    auto mapAlone = [&](size_t i, int mate, bool gathered = false) {
+        if (state[i] == State::Settled || state[i] == State::Verified) return;
+        state[i] = State::Verified;
+        vector<int>* cands = scratch.mate_candidates[mate];
+        if (!gathered) {
+            gatherCandidates(ref, reads, i, seed_len, max_errors, scratch, cands, profile);
+            profile.lap(MappingProfile::Seeding, clock);
+        }
+        if (cands[0].empty() && cands[1].empty()) {
+            profile.exit(MappingProfile::NoCandidates);
+            return;
+        }
+        bool mapped = verifyCandidates(ref, reads[i].seq, scratch.rc[i], max_errors, cands,
+                                       scratch.mate_dists[mate], scratch.pattern, results[i], profile);
+        profile.exit(mapped ? MappingProfile::Verified : MappingProfile::NotVerified);
+        profile.lap(MappingProfile::Verify, clock);
+    };
+    
+    // Place read i (the given mate) in the window of its anchor
+    auto placeMate = [&](size_t i, int mate, const MateWindow& window, int anchor_mapq) {
+        MappingResult& result = results[i];
+        auto placed = [&](Placement how) {
+            result.placement = how;
+            result.mapq = min(result.mapq, anchor_mapq);
+            if (state[i] != State::Verified && state[i] != State::Settled) {
+                profile.exit(how == Placement::MateWindow ? MappingProfile::MateWindow : MappingProfile::MateSearch);
+            }
+            profile.lap(MappingProfile::Verify, clock);
+        };
+        if (state[i] == State::Settled) {
+            // Settled by its exact lookup: pick among the hits in the window
+            if (result.status != MapStatus::Multi) return;
+            size_t p = scratch.first[i] + (window.reverse && scratch.map_rc[i]);
+            auto [lo, hi] = scratch.exact[p];
+            int in_window = 0, position = -1;
+            const int max_hits = 100;
+            profile.count(profile.sa_locates, min(hi - lo, max_hits));
+            for (int row = lo; row < hi && row < lo + max_hits; row++) {
+                int pos = ref.position(row);
+                if (pos >= window.lo && pos <= window.hi) {
+                    if (in_window++ == 0 || pos < position) position = pos;
+                }
+            }
+            if (in_window > 0) {
+                result.status = in_window == 1 ? MapStatus::Unique : MapStatus::Multi;
+                result.position = position;
+                result.reverse = window.reverse;
+                result.mapq = in_window == 1 ? 60 : 0;
+                placed(Placement::MateWindow);
+            } else if (searchWindow(ref, reads[i].seq, scratch.rc[i], window, max_errors, scratch, result, profile)) {
+                placed(Placement::MateSearch);  // its hits there were past the first max_hits
+            }
+            profile.lap(MappingProfile::Verify, clock);
+            return;
+        }
+        
+        // Its seed candidates in the window, allowing max_errors of indel drift
+        bool gathered = false;
+        if (state[i] != State::Deferred) {
+            vector<int>* cands = scratch.mate_candidates[mate];
+            const vector<int>& dists = scratch.mate_dists[mate][window.reverse];
+            bool verified = state[i] == State::Verified;  // by mapAlone: its distances are in mate_dists
+            if (state[i] == State::Seeded) {
+                gatherCandidates(ref, reads, i, seed_len, max_errors, scratch, cands, profile);
+                profile.lap(MappingProfile::Seeding, clock);
+                gathered = true;
+            }
+            vector<int>* in_window = scratch.window_candidates;
+            in_window[0].clear();
+            in_window[1].clear();
+            scratch.dists[0].clear();
+            scratch.dists[1].clear();
+            for (size_t c = 0; c < cands[window.reverse].size(); c++) {
+                int pos = cands[window.reverse][c];
+                if (pos < window.lo - max_errors || pos > window.hi + max_errors) continue;
+                in_window[window.reverse].push_back(pos);
+                if (verified) scratch.dists[window.reverse].push_back(dists[c]);
+            }
+            // A failed verification leaves the result as it was (see pickBest)
+            if (!in_window[window.reverse].empty() &&
+                (verified ? pickBest(in_window, scratch.dists, max_errors, result)
+                          : verifyCandidates(ref, reads[i].seq, scratch.rc[i], max_errors, in_window, scratch.dists,
+                                             scratch.pattern, result, profile))) {
+                placed(Placement::MateWindow);
+                return;
+            }
+        }
+        if (searchWindow(ref, reads[i].seq, scratch.rc[i], window, max_errors, scratch, result, profile)) {
+            placed(Placement::MateSearch);
+            return;
+        }
+        profile.lap(MappingProfile::Verify, clock);
+        
+        // Not near its mate: map it on its own
+        mapAlone(i, mate, gathered);
+    };
+    
+    for (size_t p = 0; p < pairs; p++) {
+        uint64_t pair_start = clock;
+        size_t mates[2] = {p, p + pairs};
+        auto exactAnchor = [&](int m) { return state[mates[m]] == State::Settled && isAnchor(results[mates[m]]); };
+        int anchor = exactAnchor(0) ? 0 : exactAnchor(1) ? 1 : -1;
+        for (int m = 0; m < 2 && anchor < 0; m++) {
+            mapAlone(mates[m], m);
+            if (isAnchor(results[mates[m]])) anchor = m;
+        }
+        if (anchor < 0 || !insert.valid()) {
+            mapAlone(mates[0], 0);
+            mapAlone(mates[1], 1);
+        } else {
+            size_t a = mates[anchor], o = mates[1 - anchor];
+            MateWindow window = mateWindow(ref, results[a], reads[a].seq.size(), reads[o].seq.size(), insert);
+            placeMate(o, 1 - anchor, window, results[a].mapq);
+        }
+        uint64_t share = (clock - pair_start) / 2;
+        scratch.ticks[mates[0]] += share;
+        scratch.ticks[mates[1]] += share;
+    }
+}
+
+// A read as written to SAM, from alignForSam
+struct SamAlignment {
+    long long position = -1;  // 0-based genome position of the first aligned base; -1 if unmapped
+    long long end = -1;       // one past the last aligned base
+    string rc;                // reverse strand: reverse-complemented sequence, then reversed quality
+    string cigar;
+    int nm = 0;
+};
+
+// Buffers of alignForSam, reused across reads
+struct SamScratch {
+    string window;  // genome at the mapped position
+    bio::BandedAligner aligner;
+    SamAlignment reads[2];  // the read, or the two mates of a pair
+};
+
+// Align a read for its SAM record. Most reads align to their window with at
+// most one mismatch, which no gapped alignment beats, so the CIGAR is simply
+// <len>M. Otherwise it comes from a banded alignment of the read (reverse
+// complemented for the reverse strand) against the genome from its mapped
+// position, which leading deletions move right.
+void alignForSam(const ReferenceIndex& ref, const bio::FastqRecord& read, const MappingResult& result, int max_errors,
+                 SamScratch& scratch, SamAlignment& aln) {
+    aln.position = -1;
+    if (result.status == MapStatus::Unmapped) return;
+    
+    size_t len = read.seq.size();
+    string_view seq = read.seq;
+    if (result.reverse) {
+        // Sequence reverse complemented, quality reversed, stored back to back
+        aln.rc.resize(2 * len);
+        for (size_t i = 0; i < len; i++) {
+            aln.rc[i] = bio::complementBase(read.seq[len - 1 - i]);
+            aln.rc[len + i] = read.qual[len - 1 - i];
+        }
+        seq = string_view(aln.rc).substr(0, len);
+    }
+    string& window = scratch.window;
+    const bio::ContigTable& contigs = *ref.contigs;
+    size_t contig = ref.contigOf(result.position);
+    window.resize(min<size_t>(len + max_errors, contigs.end(contig) - result.position));
+    ref.genome->extract(result.position, window.size(), window.data());
+    aln.position = result.position;
+    
+    int mismatches = len > window.size() ? len - window.size() : 0;
+    for (size_t i = 0; i < min(len, window.size()); i++) mismatches += seq[i] != window[i];
+    if (mismatches <= 1) {
+        aln.cigar.clear();
+        aln.cigar += to_string(len);
+        aln.cigar += 'M';
+        aln.nm = mismatches;
+        aln.end = aln.position + len;
+        return;
+    }
+    // The window extends the verified one and the aligner compares the
+    // same (upper-cased) bases, so a placed read always aligns; never
+    // write a placed record without a CIGAR
+    const bio::Alignment& banded = scratch.aligner.align(seq, window, max_errors);
+    if (banded.distance > max_errors) {
+        throw logic_error("read " + string(read.id) + " does not align at its mapped position");
+    }
+    aln.end = aln.position + banded.text_end;
+    aln.position += banded.text_begin;
+    aln.cigar = banded.cigar;
+    aln.nm = banded.distance;
+}
+
+// The mate of a paired read, for its SAM record
+struct SamMate {
+    const SamAlignment& aln;
+    bool reverse;
+    int flag;  // this read's bio::SAM_FIRST_MATE or SAM_SECOND_MATE, plus SAM_PROPER_PAIR
+};
+
+// Signed SAM template length of read a with mate b: from the leftmost to the
+// rightmost aligned base of the pair, positive for the leftmost read (for
+// a_first on a tie); 0 unless both are mapped to the same record
+long long samTemplateLength(const ReferenceIndex& ref, const SamAlignment& a, const SamAlignment& b, bool a_first) {
+    if (a.position < 0 || b.position < 0 || ref.contigOf(a.position) != ref.contigOf(b.position)) return 0;
+    long long span = max(a.end, b.end) - min(a.position, b.position);
+    bool leftmost = a.position < b.position || (a.position == b.position && a_first);
+    return leftmost ? span : -span;
+}
+
+// Append the SAM record of a mapped or unmapped read, aligned by alignForSam.
+// Positions are given within the read's reference record. A paired read
+// (mate set) is named without its /1 or /2 and gets the mate fields, with the
+// mate's aligned position; if only one mate maps, the other is placed at its
+// position, as SAM recommends.
+void appendSamLine(string& out, const ReferenceIndex& ref, const bio::FastqRecord& read, const MappingResult& result,
+                   const SamAlignment& aln, const SamMate* mate = nullptr) {
+    const bio::ContigTable& contigs = *ref.contigs;
+    bio::SamRecord rec;
+    rec.qname = read.id;
+    rec.seq = read.seq;
+    rec.qual = read.qual;
+    bool mapped = aln.position >= 0;
+    bool mate_mapped = mate && mate->aln.position >= 0;
+    if (mate) {
+        rec.qname = bio::PairedFastqReader::mateName(read.id);
+        rec.flag = bio::SAM_PAIRED | mate->flag;
+        if (mate_mapped) {
+            if (mate->reverse) rec.flag |= bio::SAM_MATE_REVERSE;
+            size_t mate_contig = ref.contigOf(mate->aln.position);
+            bool same = mapped && ref.contigOf(aln.position) == mate_contig;
+            rec.rnext = same || !mapped ? "=" : contigs.name(mate_contig);
+            rec.pnext = mate->aln.position - contigs.start(mate_contig) + 1;
+        } else {
+            rec.flag |= bio::SAM_MATE_UNMAPPED;
+        }
+        rec.tlen = samTemplateLength(ref, aln, mate->aln, mate->flag & bio::SAM_FIRST_MATE);
+    }
+    if (!mapped) {
+        rec.flag |= bio::SAM_UNMAPPED;
+        if (mate_mapped) {
+            rec.rname = contigs.name(ref.contigOf(mate->aln.position));
+            rec.pos = rec.pnext;
+        }
+        bio::appendSamRecord(out, rec);
+        return;
+    }
+    
+    size_t len = read.seq.size();
+    if (result.reverse) {
+        rec.seq = string_view(aln.rc).substr(0, len);
+        rec.qual = string_view(aln.rc).substr(len);
+        rec.flag |= bio::SAM_REVERSE;
+    }
+    size_t contig = ref.contigOf(aln.position);
+    rec.rname = contigs.name(contig);
+    rec.mapq = result.mapq;
+    rec.pos = aln.position - contigs.start(contig) + 1;
+    rec.cigar = aln.cigar;
+    rec.nm = aln.nm;
+    if (mate && !mate_mapped) {
+        rec.rnext = "=";
+        rec.pnext = rec.pos;
+    }
+    bio::appendSamRecord(out, rec);
+}
+
+// Per-worker mapping statistics, folded together once all reads are mapped
+// (cache-line aligned so neighbouring workers do not false-share counters).
+// Per-base depth goes to the shared CoverageCounter through a worker's Writer.
+struct alignas(64) MappingStats {
+    long long total_reads = 0;
+    long long mapped_reads = 0;
+    long long unique_mapped = 0;
+    long long multi_mapped = 0;
+    long long reverse_mapped = 0;
+    long long total_edit_dist = 0;
+    long long total_candidates = 0;
+    long long total_coverage = 0;  // bases covered by uniquely mapped reads, exact
+    long long pairs = 0;           // paired mode: read pairs (each mate also counts as a read)
+    long long proper_pairs = 0;
+    long long mates_in_window = 0; // placed among their hits or candidates in their mate's insert window
+    long long mates_searched = 0;  // found by searching that window
+    long long cache_hits = 0;      // reads given a cached result (--read-cache)
+    
+    void add(const MappingResult& result, int read_len, bio::CoverageCounter::Writer& coverage) {
+        total_reads++;
+        total_candidates += result.candidates;
+        if (result.status == MapStatus::Unmapped) return;
+        
+        mapped_reads++;
+        if (result.reverse) reverse_mapped++;
+        total_edit_dist += result.edit_dist;
+        
+        if (result.status == MapStatus::Unique) {
+            unique_mapped++;
+            total_coverage += coverage.add(result.position, (size_t)result.position + read_len);
+        } else {
+            multi_mapped++;
+        }
+    }
+    
+    void addPair(const MappingResult& mate1, const MappingResult& mate2, bool proper) {
+        pairs++;
+        proper_pairs += proper;
+        for (const MappingResult* r : {&mate1, &mate2}) {
+            mates_in_window += r->placement == Placement::MateWindow;
+            mates_searched += r->placement == Placement::MateSearch;
+        }
+    }
+    
+    void merge(const MappingStats& other) {
+        total_reads += other.total_reads;
+        mapped_reads += other.mapped_reads;
+        unique_mapped += other.unique_mapped;
+        multi_mapped += other.multi_mapped;
+        reverse_mapped += other.reverse_mapped;
+        total_edit_dist += other.total_edit_dist;
+        total_candidates += other.total_candidates;
+        total_coverage += other.total_coverage;
+        pairs += other.pairs;
+        proper_pairs += other.proper_pairs;
+        mates_in_window += other.mates_in_window;
+        mates_searched += other.mates_searched;
+        cache_hits += other.cache_hits;
+    }
+};
+
+// Machine-readable run summary for tracking regressions: the report's totals,
+// wall-clock phases and, unless profiling is compiled out, the merged stage
+// times (summed over threads), per-exit read counts, hot-path counters and
+// per-read candidate and latency distributions
+void writeStatsJson(const string& path, const MappingStats& stats, const InsertSize& insert, size_t cache_capacity,
+                    const MappingProfile& profile, int num_threads, double setup_time, double mapping_time,
+                    double total_time) {
+    ofstream out(path);
+    if (!out) throw runtime_error("Cannot create " + path);
+    out << fixed << setprecision(6);
+    out << "{\n";
+    out << "  \"version\": 1,\n";
+    out << "  \"profiling\": " << (bio::PROFILE_ENABLED ? "true" : "false") << ",\n";
+    out << "  \"threads\": " << num_threads << ",\n";
+    out << "  \"reads\": {\"total\": " << stats.total_reads << ", \"mapped\": " << stats.mapped_reads
+        << ", \"unique\": " << stats.unique_mapped << ", \"multi\": " << stats.multi_mapped
+        << ", \"reverse\": " << stats.reverse_mapped << "},\n";
+    if (stats.pairs > 0) {
+        out << "  \"pairs\": {\"total\": " << stats.pairs << ", \"proper\": " << stats.proper_pairs
+            << ", \"mates_in_window\": " << stats.mates_in_window << ", \"mates_searched\": " << stats.mates_searched
+            << ", \"insert_median\": " << insert.median << ", \"insert_sd\": " << insert.sd
+            << ", \"insert_samples\": " << insert.samples << "},\n";
+    }
+    if (cache_capacity > 0) {
+        out << "  \"read_cache\": {\"capacity\": " << cache_capacity << ", \"hits\": " << stats.cache_hits
+            << ", \"hit_rate\": " << (stats.total_reads ? (double)stats.cache_hits / stats.total_reads : 0);
+        if constexpr (bio::PROFILE_ENABLED) {
+            out << ", \"seconds_saved\": " << profile.cache_ticks_saved / bio::profileTicksPerSecond();
+        }
+        out << "},\n";
+    }
+    out << "  \"seconds\": {\"setup\": " << setup_time << ", \"mapping\": " << mapping_time
+        << ", \"total\": " << total_time << "},\n";
+    out << "  \"reads_per_second\": " << (mapping_time > 0 ? stats.total_reads / mapping_time : 0);
+    if constexpr (bio::PROFILE_ENABLED) {
+        double tick_seconds = 1 / bio::profileTicksPerSecond();
+        out << ",\n  \"stage_seconds\": {";
+        for (int i = 0; i < MappingProfile::NUM_STAGES; i++) {
+            out << (i ? ", " : "") << "\"" << MappingProfile::STAGE_NAMES[i] << "\": " << profile.stage_ticks[i] * tick_seconds;
+        }
+        out << "},\n  \"exits\": {";
+        for (int i = 0; i < MappingProfile::NUM_EXITS; i++) {
+            out << (i ? ", " : "") << "\"" << MappingProfile::EXIT_NAMES[i] << "\": " << profile.exits[i];
+        }
+        out << "},\n";
+        out << "  \"counters\": {\"sa_probes\": " << profile.sa_probes << ", \"sa_locates\": " << profile.sa_locates
+            << ", \"minimizer_lookups\": " << profile.minimizer_lookups
+            << ", \"edit_distance_calls\": " << profile.edit_distance_calls
+            << ", \"mate_searches\": " << profile.mate_searches;
+        if constexpr (bio::ALLOCATIONS_COUNTED) out << ", \"heap_allocations\": " << profile.heap_allocations;
+        out << "},\n";
+        
+        // Distributions as summary plus [lo, hi, count] buckets, scaled to the unit
+        auto histogram = [&](const char* name, const bio::LogHistogram& h, double scale) {
+            out << "  \"" << name << "\": {\"mean\": " << h.mean() * scale;
+            for (auto [label, q] : {pair{"p50", 0.5}, pair{"p90", 0.9}, pair{"p99", 0.99}}) {
+                out << ", \"" << label << "\": " << h.quantile(q) * scale;
+            }
+            out << ", \"max\": " << h.max() * scale << ", \"buckets\": [";
+            bool first = true;
+            h.forEachBucket([&](uint64_t lo, uint64_t hi, uint64_t n) {
+                out << (first ? "" : ", ") << "[" << lo * scale << ", " << hi * scale << ", " << n << "]";
+                first = false;
+            });
+            out << "]}";
+        };
+        histogram("candidates_per_read", profile.candidates, 1);
+        out << ",\n";
+        histogram("read_latency_us", profile.latency, tick_seconds * 1e6);
+    }
+    out << "\n}\n";
+    if (!out.flush()) throw runtime_error("Failed writing " + path);
+}
+
+// Bounded queue handing batches of reads between the reader and the mapping workers
+template<typename Batch>
+struct BatchQueue {
+    mutex m;
+    condition_variable not_empty, not_full;
+    deque<Batch> batches;
+    size_t capacity;
+    bool closed = false;
+    
+    explicit BatchQueue(size_t capacity) : capacity(capacity) {}
+    
+    void push(Batch&& batch) {
+        unique_lock<mutex> lock(m);
+        not_full.wait(lock, [&] { return batches.size() < capacity; });
+        batches.push_back(std::move(batch));
+        not_empty.notify_one();
+    }
+    
+    // Returns false once the queue is closed and drained
+    bool pop(Batch& batch) {
+        unique_lock<mutex> lock(m);
+        not_empty.wait(lock, [&] { return !batches.empty() || closed; });
+        if (batches.empty()) return false;
+        batch = std::move(batches.front());
+        batches.pop_front();
+        not_full.notify_one();
+        return true;
+    }
+    
+    // Non-blocking pop; false if the queue is currently empty
+    bool tryPop(Batch& batch) {
+        lock_guard<mutex> lock(m);
+        if (batches.empty()) return false;
+        batch = std::move(batches.front());
+        batches.pop_front();
+        not_full.notify_one();
+        return true;
+    }
+    
+    void close() {
+        lock_guard<mutex> lock(m);
+        closed = true;
+        not_empty.notify_all();
+    }
+};
+
+// A chunk of reads numbered in input order, so output can follow that order
+struct ReadBatch {
+    size_t index = 0;
+    bio::FastqChunk chunk;
+    bio::FastqChunk mates;  // paired mode: the mate of each read in chunk
+};
+
+// Upper-case the bases of a chunk's reads in place. The index lookups read
+// a-t as ACGT but the verifier, the aligner and the read cache compare bytes,
+// so every stage must see the read in one case (written so to the SAM too).
+void uppercaseReads(bio::FastqChunk& chunk) {
+    for (const bio::FastqRecord& read : chunk.records) {
+        char* seq = chunk.data.data() + (read.seq.data() - chunk.data.data());
+        for (size_t i = 0; i < read.seq.size(); i++) {
+            if (seq[i] >= 'a' && seq[i] <= 'z') seq[i] -= 'a' - 'A';
+        }
+    }
+}
+
+// "mapper count": k-mer spectrum of a read set. This thread parses chunks of
+// reads; each worker stages the k-mers of its chunks in its own Writer and
+// flushes them into the counter's shared partitions.
+int countReadKmers(const string& reads_file, int k, bool canonical, int num_threads, long long max_reads) {
+    auto start_time = chrono::high_resolution_clock::now();
+    unique_ptr<bio::FastqReader> reader;
+    unique_ptr<bio::PartitionedKmerCounter> counter;
+    try {
+        reader = make_unique<bio::FastqReader>(reads_file, 1 << 20, max(1, num_threads / 8));
+        counter = make_unique<bio::PartitionedKmerCounter>(k, canonical);
+    } catch (const exception& e) {
+        cerr << "Error: " << e.what() << endl;
+        return 1;
+    }
+    
+    cerr << "Counting " << k << "-mers with " << num_threads << " thread(s)..." << endl;
+    BatchQueue<bio::FastqChunk> queue(2 * num_threads);
+    BatchQueue<bio::FastqChunk> free_chunks(4 * num_threads + 4);
+    vector<thread> workers;
+    for (int t = 0; t < num_threads; t++) {
+        workers.emplace_back([&] {
+            bio::PartitionedKmerCounter::Writer writer(*counter);
+            bio::FastqChunk chunk;
+            while (queue.pop(chunk)) {
+                for (const bio::FastqRecord& read : chunk.records) writer.add(read.seq);
+                free_chunks.push(std::move(chunk));
+            }
+        });
+    }
+    
+    long long reads_loaded = 0, bases = 0;
+    string read_error;
+    try {
+        while (max_reads < 0 || reads_loaded < max_reads) {
+            bio::FastqChunk chunk;
+            free_chunks.tryPop(chunk);
+            size_t limit = max_reads < 0 ? SIZE_MAX : max_reads - reads_loaded;
+            if (!reader->next(chunk, limit)) break;
+            reads_loaded += chunk.records.size();
+            for (const bio::FastqRecord& read : chunk.records) bases += read.seq.size();
+            queue.push(std::move(chunk));
+        }
+    } catch (const exception& e) {
+        read_error = e.what();
+    }
+    queue.close();
+    for (thread& w : workers) w.join();
+    if (!read_error.empty()) {
+        cerr << "Error: " << read_error << endl;
+        return 1;
+    }
+    
+    // Spectrum summary
+    long long total_kmers = 0, singletons = 0;
+    uint64_t top_kmer = 0;
+    uint32_t top_count = 0;
+    counter->forEach([&](uint64_t kmer, uint32_t n) {
+        total_kmers += n;
+        singletons += n == 1;
+        if (n > top_count || (n == top_count && kmer < top_kmer)) {
+            top_kmer = kmer;
+            top_count = n;
+        }
+    });
+    long long distinct = counter->size();
+    
+    auto end_time = chrono::high_resolution_clock::now();
+    double total_time = chrono::duration_cast<chrono::milliseconds>(end_time - start_time).count() / 1000.0;
+    
+    cout << "=== K-mer Count Report ===" << endl;
+    cout << endl;
+    cout << "Reads file: " << reads_file << endl;
+    cout << "Reads: " << reads_loaded << " (" << bases << " bp)" << endl;
+    cout << "k: " << k << (canonical ? " (canonical)" : "") << endl;
+    cout << endl;
+    cout << "K-mers counted: " << total_kmers << endl;
+    cout << "Distinct k-mers: " << distinct << endl;
+    cout << "Singletons: " << singletons << " (" << fixed << setprecision(2)
+         << (distinct > 0 ? 100.0 * singletons / distinct : 0) << "% of distinct)" << endl;
+    if (top_count > 0) {
+        cout << "Most frequent: " << bio::decodeKmer(top_kmer, k) << " x" << top_count << endl;
+    }
+    cout << "Table memory: " << fixed << setprecision(1) << counter->memoryBytes() / 1048576.0 << " MB" << endl;
+    cout << endl;
+    cout << "Total runtime: " << fixed << setprecision(1) << total_time << " seconds" << endl;
+    cout << "Throughput: " << fixed << setprecision(1)
+         << (total_time > 0 ? total_kmers / total_time / 1e6 : 0) << " M k-mers/s" << endl;
+    return 0;
+}
+
+// "Genome size" line of the reference, without the gaps between records
+void printGenomeSize(ostream& out, const bio::ContigTable& contigs) {
+    out << "Genome size: " << contigs.totalLength() << " bp";
+    if (contigs.size() > 1) out << " in " << contigs.size() << " sequences";
+    out << endl;
 }
 
 int main(int argc, char* argv[]) {
     ios::sync_with_stdio(false);
     cin.tie(nullptr);
     
+    // "mapper index ..." builds the on-disk index instead of mapping
+    bool index_mode = argc > 1 && string(argv[1]) == "index";
+    // "mapper count ..." counts the k-mers of the reads
+    bool count_mode = argc > 1 && string(argv[1]) == "count";
+    
     string genome_file = "data/GCF_000005845.2_ASM584v2_genomic.fna";
     string reads_file = "data/ERR022075_1.fastq";
+    string mates_file;  // second reads of paired-end mapping, empty = single-end
+    bool paired = false;
+    string index_file;  // empty = build the suffix array in memory
+    bool verify_index = false;
+    bool use_fm = false;
+    int prefix_k = -1;  // -1: bio::defaultPrefixK of the genome size
+    string seeding = "fixed";
+    int minimizer_k = 15, minimizer_w = 10;
+    bool forward_only = false;
+    string sam_file;  // empty = statistics only
+    string bedgraph_file, depth_hist_file;  // per-base depth outputs, empty = off
+    string stats_json_file;  // run summary and profile, empty = off
+    int read_cache_mb = 0;   // results cached by read sequence, 0 = off
     int max_reads = -1;  // -1 = all reads
     int seed_len = 20;
     int max_errors = 3;
+    int num_threads = 1;
+    int count_k = 21;
+    bool canonical = false;
     
     // Parse arguments
-    for (int i = 1; i < argc; i++) {
+    for (int i = index_mode || count_mode ? 2 : 1; i < argc; i++) {
         string arg = argv[i];
         if (arg == "-g" && i + 1 < argc) genome_file = argv[++i];
         else if (arg == "-r" && i + 1 < argc) reads_file = argv[++i];
+        else if (arg == "-r1" && i + 1 < argc) reads_file = argv[++i], paired = true;
+        else if (arg == "-r2" && i + 1 < argc) mates_file = argv[++i], paired = true;
+        else if (arg == "-i" && i + 1 < argc) index_file = argv[++i];
+        else if (arg == "--verify-index") verify_index = true;
+        else if (arg == "--fm") use_fm = true;
+        else if (arg == "--prefix-k" && i + 1 < argc) prefix_k = clamp(stoi(argv[++i]), 0, bio::MAX_PREFIX_K);
+        else if (arg == "--forward-only") forward_only = true;
+        else if (arg == "-o" && i + 1 < argc) sam_file = argv[++i];
+        else if (arg == "--bedgraph" && i + 1 < argc) bedgraph_file = argv[++i];
+        else if (arg == "--depth-hist" && i + 1 < argc) depth_hist_file = argv[++i];
+        else if (arg == "--stats-json" && i + 1 < argc) stats_json_file = argv[++i];
+        else if (arg == "--read-cache" && i + 1 < argc) read_cache_mb = max(0, stoi(argv[++i]));
+        else if (arg == "-x" && i + 1 < argc) seeding = argv[++i];
+        else if (arg == "--mm-k" && i + 1 < argc) minimizer_k = clamp(stoi(argv[++i]), 5, 31);
+        else if (arg == "--mm-w" && i + 1 < argc) minimizer_w = clamp(stoi(argv[++i]), 1, 255);
         else if (arg == "-n" && i + 1 < argc) max_reads = stoi(argv[++i]);
         else if (arg == "-s" && i + 1 < argc) seed_len = stoi(argv[++i]);
         else if (arg == "-e" && i + 1 < argc) max_errors = stoi(argv[++i]);
+        else if (arg == "-t" && i + 1 < argc) num_threads = max(1, stoi(argv[++i]));
+        else if (arg == "-k" && i + 1 < argc) count_k = stoi(argv[++i]);
+        else if (arg == "--canonical") canonical = true;
         else if (arg == "-h") {
             cerr << "Usage: " << argv[0] << " [options]\n"
-                 << "  -g <file>  Reference genome (FASTA)\n"
-                 << "  -r <file>  Reads file (FASTQ)\n"
-                 << "  -n <num>   Max reads to process (-1 = all)\n"
-                 << "  -s <len>   Seed length (default: 20)\n"
-                 << "  -e <num>   Max errors allowed (default: 3)\n";
+                 << "       " << argv[0] << " index [-g <file>] [-i <file>] [--prefix-k <k>]\n"
+                 << "       " << argv[0] << " count [-r <file>] [-k <k>] [--canonical] [-n <num>] [-t <num>]\n"
+                 << "  -g <file>  Reference genome (FASTA, optionally gzip/BGZF)\n"
+                 << "  -r <file>  Reads file (FASTQ, optionally gzip/BGZF)\n"
+                 << "  -r1 <file> -r2 <file>  Paired-end reads: first and second mates, in the same order\n"
+                 << "  -i <file>  Prebuilt index (default for 'index': <genome>.idx)\n"
+                 << "  --verify-index  Check index section checksums on load\n"
+                 << "  --fm       Look up seeds with an FM-index instead of the suffix array\n"
+                 << "  --prefix-k <k>  k-mer prefix table over the suffix array, 4^k entries, k <= "
+                 << bio::MAX_PREFIX_K << "\n"
+                 << "             (default: largest k with 4^k <= genome size, at most "
+                 << bio::MAX_PREFIX_K << "; 0 = off)\n"
+                 << "  --forward-only  Map reads on the forward strand only\n"
+                 << "  -o <file>  Write per-read alignments as SAM\n"
+                 << "  --bedgraph <file>  Write the depth of uniquely mapped reads as bedGraph\n"
+                 << "  --depth-hist <file>  Write the histogram of that depth (depth, bases, fraction)\n"
+                 << "  --stats-json <file>  Write run statistics and per-stage profile as JSON\n"
+                 << "  --read-cache <MB>  Reuse the results of reads with the same sequence, from a cache\n"
+                 << "             of at most this size (single-end; default: 0 = off)\n"
+                 << "  -x <mode>  Seeding: 'fixed' (3 seeds of -s bases), 'minimizer' or 'smem' (maximal\n"
+                 << "             exact matches of -s bases or more) (default: fixed)\n"
+                 << "  --mm-k <k>, --mm-w <w>  Minimizer k-mer size and window (default: 15, 10)\n"
+                 << "  -n <num>   Max reads (read pairs with -r1/-r2) to process (-1 = all)\n"
+                 << "  -s <len>   Seed length, or minimum MEM length with -x smem (default: 20)\n"
+                 << "  -e <num>   Max errors allowed (default: 3)\n"
+                 << "  -t <num>   Mapping threads (default: 1)\n"
+                 << "  -k <k>     k-mer size for 'count', 1..32 (default: 21)\n"
+                 << "  --canonical  Count k-mers and their reverse complements together\n";
             return 0;
         }
     }
+    if (seeding != "fixed" && seeding != "minimizer" && seeding != "smem") {
+        cerr << "Error: unknown seeding mode '" << seeding << "' (expected fixed, minimizer or smem)" << endl;
+        return 1;
+    }
+    if (seeding == "smem" && use_fm) {
+        cerr << "Error: -x smem searches the suffix array and cannot be used with --fm" << endl;
+        return 1;
+    }
+    if (paired && (mates_file.empty() || reads_file == mates_file)) {
+        cerr << "Error: paired-end mapping needs two files, -r1 <file> -r2 <file>" << endl;
+        return 1;
+    }
+    if (paired && forward_only) {
+        cerr << "Error: --forward-only cannot be used with paired-end reads" << endl;
+        return 1;
+    }
+    if (paired && read_cache_mb > 0) {
+        cerr << "Error: --read-cache cannot be used with paired-end reads" << endl;
+        return 1;
+    }
+    if (count_mode) return countReadKmers(reads_file, count_k, canonical, num_threads, max_reads);
     
     auto start_time = chrono::high_resolution_clock::now();
+    bio::profileTicksPerSecond();  // start tick calibration
+    
+    // Reference: either loaded from a memory-mapped index or built in memory
+    bio::PackedSequence genome;
+    bio::ContigTable contigs;
+    vector<int> sa_storage;
+    unique_ptr<bio::MappedIndex> index;
+    span<const int> sa;
+    bio::LcpLrTables lcp_lr_storage;
+    span<const uint8_t> lcp_left, lcp_right;
+    vector<uint32_t> prefix_storage;
+    span<const uint32_t> prefix_table;
+    
+    if (index_mode || index_file.empty()) {
+        // Load reference genome
+        cerr << "Loading reference genome..." << endl;
+        genome = bio::PackedSequence(loadFasta(genome_file, contigs));
+        printGenomeSize(cerr, contigs);
+        
+        // Build suffix array
+        cerr << "Building suffix array..." << endl;
+        auto sa_start = chrono::high_resolution_clock::now();
+        sa_storage = bio::buildSuffixArray(genome);
+        sa = sa_storage;
+        auto sa_end = chrono::high_resolution_clock::now();
+        cerr << "Suffix array built in " 
+             << chrono::duration_cast<chrono::milliseconds>(sa_end - sa_start).count() 
+             << " ms" << endl;
+    } else {
+        cerr << "Loading index " << index_file << "..." << endl;
+        try {
+            index = make_unique<bio::MappedIndex>(index_file);
+            if (verify_index && !index->verify()) {
+                throw runtime_error(index_file + " failed checksum verification");
+            }
+            sa = index->array<int>(bio::IndexSection::SuffixArray);
+            genome = bio::PackedSequence::view(sa.size(), index->array<uint64_t>(bio::IndexSection::PackedGenome),
+                                               index->array<uint64_t>(bio::IndexSection::AmbiguousBases));
+            if (genome.words().size() != (sa.size() + 31) / 32 ||
+                (!genome.ambiguityBits().empty() && genome.ambiguityBits().size() != (sa.size() + 63) / 64)) {
+                throw runtime_error(index_file + ": packed genome does not match the suffix array");
+            }
+            if (index->has(bio::IndexSection::LcpLeft)) {
+                lcp_left = index->array<uint8_t>(bio::IndexSection::LcpLeft);
+                lcp_right = index->array<uint8_t>(bio::IndexSection::LcpRight);
+                if (lcp_left.size() != sa.size() || lcp_right.size() != sa.size()) {
+                    throw runtime_error(index_file + ": LCP tables do not match the suffix array");
+                }
+            }
+            if (index->has(bio::IndexSection::PrefixTable)) {
+                prefix_table = index->array<uint32_t>(bio::IndexSection::PrefixTable);
+                if (bio::prefixTableK(prefix_table) < 0 || prefix_table.back() != sa.size()) {
+                    throw runtime_error(index_file + ": prefix table does not match the suffix array");
+                }
+            }
+            contigs = bio::ContigTable::view(index->array<uint64_t>(bio::IndexSection::ContigOffsets),
+                                             index->bytes(bio::IndexSection::ContigNames));
+            if (contigs.offsets().back() != sa.size() + bio::ContigTable::GAP) {
+                throw runtime_error(index_file + ": contig table does not match the suffix array");
+            }
+        } catch (const exception& e) {
+            cerr << "Error: " << e.what() << endl;
+            return 1;
+        }
+        printGenomeSize(cerr, contigs);
+    }
+    
+    // k-mer prefix table narrowing suffix-array lookups; a table stored in the
+    // index is used unless a different k is asked for
+    if (prefix_k < 0) prefix_k = prefix_table.empty() ? bio::defaultPrefixK(genome.size()) : bio::prefixTableK(prefix_table);
+    if (use_fm && !index_mode) prefix_k = 0;
+    if (bio::prefixTableK(prefix_table) != prefix_k) prefix_table = {};
+    if (prefix_table.empty() && prefix_k > 0) {
+        cerr << "Building " << prefix_k << "-mer prefix table..." << endl;
+        auto table_start = chrono::high_resolution_clock::now();
+        prefix_storage = bio::buildPrefixTable(genome, prefix_k);
+        prefix_table = prefix_storage;
+        auto table_end = chrono::high_resolution_clock::now();
+        cerr << "Prefix table built in "
+             << chrono::duration_cast<chrono::milliseconds>(table_end - table_start).count()
+             << " ms (" << fixed << setprecision(1) << prefix_table.size_bytes() / 1048576.0 << " MB)"
+             << defaultfloat << endl;
+    }
+    
+    // LCP-LR tables for one-pass suffix-array lookups without a prefix table
+    // (not used by the FM-index)
+    if (lcp_left.empty() && (index_mode || (!use_fm && prefix_table.empty()))) {
+        cerr << "Building LCP array..." << endl;
+        auto lcp_start = chrono::high_resolution_clock::now();
+        lcp_lr_storage = bio::buildLcpLrTables(bio::buildLcpArray(genome, sa));
+        lcp_left = lcp_lr_storage.left;
+        lcp_right = lcp_lr_storage.right;
+        auto lcp_end = chrono::high_resolution_clock::now();
+        cerr << "LCP array built in "
+             << chrono::duration_cast<chrono::milliseconds>(lcp_end - lcp_start).count()
+             << " ms" << endl;
+    }
+    
+    if (index_mode) {
+        if (index_file.empty()) index_file = genome_file + ".idx";
+        cerr << "Writing index " << index_file << "..." << endl;
+        try {
+            bio::IndexWriter writer;
+            writer.add(bio::IndexSection::PackedGenome, genome.words());
+            writer.add(bio::IndexSection::AmbiguousBases, genome.ambiguityBits());
+            writer.add(bio::IndexSection::SuffixArray, sa);
+            writer.add(bio::IndexSection::LcpLeft, lcp_left);
+            writer.add(bio::IndexSection::LcpRight, lcp_right);
+            if (!prefix_table.empty()) writer.add(bio::IndexSection::PrefixTable, prefix_table);
+            writer.add(bio::IndexSection::ContigOffsets, contigs.offsets());
+            writer.add(bio::IndexSection::ContigNames, contigs.names().data(), contigs.names().size());
+            writer.write(index_file);
+        } catch (const exception& e) {
+            cerr << "Error: " << e.what() << endl;
+            return 1;
+        }
+        return 0;
+    }
+    
+    // Optionally replace suffix-array lookups by a compact FM-index
+    bio::FMIndex fm;
+    ReferenceIndex ref{&genome, sa, lcp_left, lcp_right, prefix_table};
+    ref.contigs = &contigs;
+    if (use_fm) {
+        cerr << "Building FM-index..." << endl;
+        auto fm_start = chrono::high_resolution_clock::now();
+        fm = bio::FMIndex(genome, sa);
+        ref.fm = &fm;
+        ref.sa = sa = {};
+        sa_storage = vector<int>();
+        auto fm_end = chrono::high_resolution_clock::now();
+        cerr << "FM-index built in "
+             << chrono::duration_cast<chrono::milliseconds>(fm_end - fm_start).count()
+             << " ms (" << fixed << setprecision(2) << (double)fm.memoryBytes() / genome.size()
+             << " bytes/base)" << defaultfloat << endl;
+    }
     
-    // Load reference genome
-    cerr << "Loading reference genome..." << endl;
-    string genome = loadFasta(genome_file);
-    cerr << "Genome size: " << genome.size() << " bp" << endl;
-    
-    // Build suffix array
-    cerr << "Building suffix array..." << endl;
-    auto sa_start = chrono::high_resolution_clock::now();
-    vector<int> sa = bio::buildSuffixArray(genome);
-    auto sa_end = chrono::high_resolution_clock::now();
-    cerr << "Suffix array built in " 
-         << chrono::duration_cast<chrono::milliseconds>(sa_end - sa_start).count() 
-         << " ms" << endl;
-    
-    // Open reads file
-    ifstream reads_in(reads_file);
-    if (!reads_in) {
-        cerr << "Error: Cannot open " << reads_file << endl;
+    // Minimizer hash index for -x minimizer seeding
+    bio::MinimizerIndex minimizer_index;
+    if (seeding == "minimizer") {
+        cerr << "Building (" << minimizer_w << "," << minimizer_k << ")-minimizer index..." << endl;
+        auto mm_start = chrono::high_resolution_clock::now();
+        minimizer_index = bio::MinimizerIndex(genome, minimizer_k, minimizer_w);
+        ref.minimizers = &minimizer_index;
+        auto mm_end = chrono::high_resolution_clock::now();
+        cerr << "Minimizer index built in "
+             << chrono::duration_cast<chrono::milliseconds>(mm_end - mm_start).count()
+             << " ms (" << minimizer_index.size() << " minimizers, " << fixed << setprecision(1)
+             << minimizer_index.memoryBytes() / 1048576.0 << " MB)" << defaultfloat << endl;
+    }
+    ref.mem_seeding = seeding == "smem";
+    
+    // Optional cache of mapping results by read sequence, shared by the workers
+    unique_ptr<ReadCache> read_cache;
+    if (read_cache_mb > 0) {
+        read_cache = make_unique<ReadCache>((size_t)read_cache_mb << 20);
+        cerr << "Read cache: " << read_cache->capacity() << " entries (" << fixed << setprecision(1)
+             << read_cache->memoryBytes() / 1048576.0 << " MB)" << defaultfloat << endl;
+    }
+    
+    // Open reads file (or both mate files); it is parsed in blocks of ~4k 100 bp reads
+    const size_t chunk_bytes = 1 << 20;
+    unique_ptr<bio::FastqReader> reader;
+    unique_ptr<bio::PairedFastqReader> pair_reader;
+    try {
+        // One BGZF decompression thread keeps up with roughly eight mapping threads
+        if (paired) {
+            pair_reader = make_unique<bio::PairedFastqReader>(reads_file, mates_file, chunk_bytes, max(1, num_threads / 8));
+        } else {
+            reader = make_unique<bio::FastqReader>(reads_file, chunk_bytes, max(1, num_threads / 8));
+        }
+    } catch (const exception& e) {
+        cerr << "Error: " << e.what() << endl;
         return 1;
     }
     
-    // Mapping statistics
-    long long total_reads = 0;
-    long long mapped_reads = 0;
-    long long unique_mapped = 0;
-    long long multi_mapped = 0;
-    long long total_edit_dist = 0;
-    vector<int> coverage(genome.size(), 0);
+    // Optional SAM output: workers format each batch into its own buffer and
+    // the writer thread writes the buffers in batch (= input) order
+    unique_ptr<bio::SamWriter> sam;
+    if (!sam_file.empty()) {
+        string header = "@HD\tVN:1.6\tSO:unsorted\n";
+        for (size_t i = 0; i < contigs.size(); i++) {
+            header += "@SQ\tSN:" + string(contigs.name(i)) + "\tLN:" + to_string(contigs.length(i)) + "\n";
+        }
+        header += "@PG\tID:mapper\tPN:mapper\tCL:";
+        for (int i = 0; i < argc; i++) header += string(i ? " " : "") + argv[i];
+        header += "\n";
+        try {
+            sam = make_unique<bio::SamWriter>(sam_file, header);
+        } catch (const exception& e) {
+            cerr << "Error: " << e.what() << endl;
+            return 1;
+        }
+    }
     
-    cerr << "Mapping reads..." << endl;
-    Read read;
-    int progress_interval = 100000;
+    // Mapping pipeline: this thread parses chunks of reads, workers map them
+    // against the shared read-only genome/sa into per-thread statistics and
+    // hand the chunk buffers back for reuse. Paired-end reads are mapped as
+    // pairs once this thread has learned the insert size from the first chunk.
+    cerr << "Mapping reads with " << num_threads << " thread(s)..." << endl;
+    auto mapping_start = chrono::high_resolution_clock::now();
+    const long long progress_interval = 100000;
+    BatchQueue<ReadBatch> queue(2 * num_threads);
+    BatchQueue<ReadBatch> free_chunks(4 * num_threads + 4);
+    vector<MappingStats> thread_stats(num_threads);
+    vector<MappingProfile> thread_profiles(num_threads + 1);  // last: the reader
+    bio::CoverageCounter coverage(genome.size());
+    atomic<long long> progress_reads{0}, progress_mapped{0};
+    mutex progress_mutex;
+    InsertSize insert;  // written before the first paired batch is queued
     
-    while (readFastq(reads_in, read)) {
-        if (max_reads >= 0 && total_reads >= max_reads) break;
-        total_reads++;
-        
-        MappingResult result = mapRead(genome, sa, read.seq, seed_len, max_errors);
-        
-        if (result.status != MapStatus::Unmapped) {
-            mapped_reads++;
-            total_edit_dist += result.edit_dist;
-            
-            if (result.status == MapStatus::Unique) {
-                unique_mapped++;
-                // Update coverage
-                int start = result.position;
-                int end = min(start + (int)read.seq.size(), (int)genome.size());
-                for (int i = start; i < end; i++) {
-                    coverage[i]++;
+    vector<thread> workers;
+    for (int t = 0; t < num_threads; t++) {
+        workers.emplace_back([&, t] {
+            MappingStats& stats = thread_stats[t];
+            MappingProfile& profile = thread_profiles[t];
+            bio::CoverageCounter::Writer coverage_writer(coverage);
+            ReadBatch batch;
+            MappingScratch scratch;
+            vector<MappingResult> results;
+            vector<bio::FastqRecord> pair_reads;  // mates 1 then mates 2 of a group of pairs
+            string sam_text;
+            SamScratch sam_scratch;
+            // Statistics and SAM record of one read, ticks being its mapping time.
+            // The mates of a pair are both aligned for SAM beforehand (aligned set)
+            // so that each record can give the other's aligned position.
+            auto finishRead = [&](const bio::FastqRecord& read, const MappingResult& result, uint64_t ticks,
+                                  const SamMate* mate = nullptr, const SamAlignment* aligned = nullptr) {
+                uint64_t clock = bio::profileTicks(), read_start = clock - ticks;
+                stats.add(result, read.seq.size(), coverage_writer);
+                profile.lap(MappingProfile::Coverage, clock);
+                if (sam) {
+                    if (!aligned) {
+                        alignForSam(ref, read, result, max_errors, sam_scratch, sam_scratch.reads[0]);
+                        aligned = &sam_scratch.reads[0];
+                    }
+                    appendSamLine(sam_text, ref, read, result, *aligned, mate);
+                    profile.lap(MappingProfile::Output, clock);
+                }
+                profile.read(result.candidates, read_start, clock);
+            };
+            while (queue.pop(batch)) {
+                long long mapped_before = stats.mapped_reads;
+                if (sam) sam_text = sam->buffer();
+                span<const bio::FastqRecord> records = batch.chunk.records;
+                uint64_t allocations_before = bio::thread_allocations;
+                if (!paired) {
+                    for (size_t g = 0; g < records.size(); g += MAP_GROUP_SIZE) {
+                        span<const bio::FastqRecord> group = records.subspan(g, min(MAP_GROUP_SIZE, records.size() - g));
+                        results.resize(group.size());
+                        if (read_cache) {
+                            stats.cache_hits += mapCached(ref, group, seed_len, max_errors, forward_only, *read_cache,
+                                                          results, scratch, profile);
+                        } else {
+                            mapReads(ref, group, seed_len, max_errors, forward_only, results, scratch, profile);
+                        }
+                        for (size_t i = 0; i < group.size(); i++) {
+                            finishRead(group[i], results[i], scratch.ticks[i]);
+                        }
+                    }
+                }
+                span<const bio::FastqRecord> mates = batch.mates.records;
+                for (size_t g = 0; paired && g < records.size(); g += MAP_GROUP_SIZE / 2) {
+                    size_t n = min(MAP_GROUP_SIZE / 2, records.size() - g);
+                    pair_reads.assign(records.begin() + g, records.begin() + g + n);
+                    pair_reads.insert(pair_reads.end(), mates.begin() + g, mates.begin() + g + n);
+                    results.resize(2 * n);
+                    mapPairs(ref, pair_reads, seed_len, max_errors, insert, results, scratch, profile);
+                    for (size_t i = 0; i < n; i++) {
+                        const MappingResult &result1 = results[i], &result2 = results[n + i];
+                        int len1 = pair_reads[i].seq.size(), len2 = pair_reads[n + i].seq.size();
+                        bool proper = properPair(ref, result1, len1, result2, len2, insert);
+                        stats.addPair(result1, result2, proper);
+                        int proper_flag = proper ? bio::SAM_PROPER_PAIR : 0;
+                        SamAlignment &aln1 = sam_scratch.reads[0], &aln2 = sam_scratch.reads[1];
+                        if (sam) {
+                            uint64_t clock = bio::profileTicks();
+                            alignForSam(ref, pair_reads[i], result1, max_errors, sam_scratch, aln1);
+                            alignForSam(ref, pair_reads[n + i], result2, max_errors, sam_scratch, aln2);
+                            profile.lap(MappingProfile::Output, clock);
+                        }
+                        SamMate mate1{aln2, result2.reverse, bio::SAM_FIRST_MATE | proper_flag};
+                        SamMate mate2{aln1, result1.reverse, bio::SAM_SECOND_MATE | proper_flag};
+                        finishRead(pair_reads[i], result1, scratch.ticks[i], &mate1, &aln1);
+                        finishRead(pair_reads[n + i], result2, scratch.ticks[n + i], &mate2, &aln2);
+                    }
+                }
+                profile.count(profile.heap_allocations, bio::thread_allocations - allocations_before);
+                if (sam) sam->write(batch.index, std::move(sam_text));
+                
+                long long batch_reads = batch.chunk.records.size() + batch.mates.records.size();
+                free_chunks.push(std::move(batch));
+                long long done = progress_reads.fetch_add(batch_reads) + batch_reads;
+                long long mapped = progress_mapped.fetch_add(stats.mapped_reads - mapped_before)
+                                 + stats.mapped_reads - mapped_before;
+                if ((done - batch_reads) / progress_interval != done / progress_interval) {
+                    lock_guard<mutex> lock(progress_mutex);
+                    cerr << "\rProcessed " << done << " reads... " << fixed << setprecision(1)
+                         << (100.0 * mapped / done) << "% mapped" << defaultfloat << flush;
                 }
-            } else {
-                multi_mapped++;
             }
+        });
+    }
+    
+    long long reads_loaded = 0;
+    size_t batches_loaded = 0;
+    string read_error;
+    MappingProfile& reader_profile = thread_profiles[num_threads];
+    try {
+        while (max_reads < 0 || reads_loaded < max_reads) {
+            ReadBatch batch;
+            free_chunks.tryPop(batch);
+            size_t limit = max_reads < 0 ? SIZE_MAX : max_reads - reads_loaded;
+            uint64_t clock = bio::profileTicks();
+            bool more = paired ? pair_reader->next(batch.chunk, batch.mates, limit) : reader->next(batch.chunk, limit);
+            if (more) {
+                uppercaseReads(batch.chunk);
+                if (paired) uppercaseReads(batch.mates);
+            }
+            reader_profile.lap(MappingProfile::Parse, clock);
+            if (!more) break;
+            if (paired && batches_loaded == 0) {
+                insert = estimateInsertSize(ref, batch.chunk.records, batch.mates.records, seed_len, max_errors);
+                if (insert.valid()) {
+                    cerr << "Insert size: median " << insert.median << ", sd " << fixed << setprecision(1) << insert.sd
+                         << defaultfloat << " (proper pairs " << insert.min << "-" << insert.max << ", from "
+                         << insert.samples << " pairs)" << endl;
+                } else {
+                    cerr << "Warning: only " << insert.samples << " confidently mapped pairs in the first "
+                         << batch.chunk.records.size() << "; mapping the mates independently" << endl;
+                }
+            }
+            reads_loaded += batch.chunk.records.size();
+            batch.index = batches_loaded++;
+            queue.push(std::move(batch));
         }
-        
-        if (total_reads % progress_interval == 0) {
-            cerr << "\rProcessed " << total_reads << " reads... " 
-                 << (100.0 * mapped_reads / total_reads) << "% mapped" << flush;
-        }
+    } catch (const exception& e) {
+        read_error = e.what();
     }
+    queue.close();
+    for (thread& w : workers) w.join();
     cerr << endl;
+    if (!read_error.empty()) {
+        cerr << "Error: " << read_error << endl;
+        return 1;
+    }
+    if (sam) {
+        try {
+            sam->close();
+        } catch (const exception& e) {
+            cerr << "Error: " << e.what() << endl;
+            return 1;
+        }
+    }
+    auto mapping_end = chrono::high_resolution_clock::now();
+    double mapping_time = chrono::duration<double>(mapping_end - mapping_start).count();
+    
+    // Merge per-thread statistics and profiles
+    MappingStats stats = std::move(thread_stats[0]);
+    for (int t = 1; t < num_threads; t++) {
+        stats.merge(thread_stats[t]);
+    }
+    thread_stats.clear();
+    MappingProfile profile;
+    for (const MappingProfile& p : thread_profiles) profile.merge(p);
+    long long total_reads = stats.total_reads;
+    long long mapped_reads = stats.mapped_reads;
+    long long unique_mapped = stats.unique_mapped;
+    long long multi_mapped = stats.multi_mapped;
+    long long reverse_mapped = stats.reverse_mapped;
+    long long total_edit_dist = stats.total_edit_dist;
+    long long total_coverage = stats.total_coverage;
+    
+    // Coverage statistics and optional depth files, streamed from the 2-byte
+    // depths; the gaps between records are never covered and not counted
+    long long reference_bases = contigs.totalLength();
+    vector<long long> depth_hist = coverage.histogram();
+    depth_hist[0] -= genome.size() - reference_bases;
+    long long covered_bases = reference_bases - depth_hist[0];
+    try {
+        if (!bedgraph_file.empty()) bio::writeBedGraph(bedgraph_file, contigs, coverage);
+        if (!depth_hist_file.empty()) bio::writeDepthHistogram(depth_hist_file, depth_hist);
+    } catch (const exception& e) {
+        cerr << "Error: " << e.what() << endl;
+        return 1;
+    }
     
     auto end_time = chrono::high_resolution_clock::now();
     double total_time = chrono::duration_cast<chrono::milliseconds>(end_time - start_time).count() / 1000.0;
-    
-    // Calculate coverage statistics
-    long long covered_bases = 0;
-    long long total_coverage = 0;
-    for (int c : coverage) {
-        if (c > 0) covered_bases++;
-        total_coverage += c;
+    if (!stats_json_file.empty()) {
+        double setup_time = chrono::duration<double>(mapping_start - start_time).count();
+        try {
+            writeStatsJson(stats_json_file, stats, insert, read_cache ? read_cache->capacity() : 0, profile, num_threads, setup_time, mapping_time, total_time);
+        } catch (const exception& e) {
+            cerr << "Error: " << e.what() << endl;
+            return 1;
+        }
     }
     
     // Output report
     cout << "=== Genome Mapping Report ===" << endl;
     cout << endl;
     cout << "Algorithms used:" << endl;
-    cout << "  - Suffix array O(n log^2 n) construction" << endl;
-    cout << "  - Seed-and-extend with " << seed_len << "-mer seeds" << endl;
-    cout << "  - Band-limited edit distance (max " << max_errors << " errors)" << endl;
+    cout << "  - Suffix array SA-IS O(n) construction" << endl;
+    if (use_fm) cout << "  - FM-index backward search with sampled suffix array" << endl;
+    else if (prefix_k > 0) cout << "  - " << prefix_k << "-mer prefix table + suffix array search" << endl;
+    else cout << "  - LCP-LR accelerated suffix array search (Kasai LCP)" << endl;
+    if (ref.minimizers) {
+        cout << "  - (" << minimizer_w << "," << minimizer_k << ")-minimizer seeding with co-linear chaining" << endl;
+    } else if (ref.mem_seeding) {
+        cout << "  - Maximal exact match seeding (" << seed_len << "+ bases) with re-seeding and chaining" << endl;
+    } else {
+        cout << "  - Seed-and-extend with " << seed_len << "-mer seeds" << endl;
+    }
+    cout << "  - " << (forward_only ? "Forward strand only" : "Both strands (reverse-complement)") << endl;
+    cout << "  - Bit-parallel edit distance (max " << max_errors << " errors)" << endl;
     cout << endl;
-    cout << "Reference: " << genome_file << endl;
-    cout << "Genome size: " << genome.size() << " bp" << endl;
+    cout << "Reference: " << (index_file.empty() ? genome_file : index_file) << endl;
+    printGenomeSize(cout, contigs);
     cout << endl;
-    cout << "Reads file: " << reads_file << endl;
+    if (paired) cout << "Reads files: " << reads_file << ", " << mates_file << endl;
+    else cout << "Reads file: " << reads_file << endl;
     cout << "Total reads processed: " << total_reads << endl;
     cout << endl;
+    if (paired) {
+        cout << "Paired-end mapping:" << endl;
+        cout << "  Read pairs: " << stats.pairs << endl;
+        if (insert.valid()) {
+            cout << "  Insert size: median " << insert.median << ", sd " << fixed << setprecision(1) << insert.sd
+                 << " (proper: " << insert.min << "-" << insert.max << ", from " << insert.samples << " pairs)" << endl;
+        } else {
+            cout << "  Insert size: not learned (" << insert.samples << " confident pairs), mates mapped independently" << endl;
+        }
+        cout << "  Proper pairs: " << stats.proper_pairs
+             << " (" << fixed << setprecision(2) << (stats.pairs ? 100.0 * stats.proper_pairs / stats.pairs : 0) << "%)" << endl;
+        cout << "  Mates placed in the insert window: " << stats.mates_in_window
+             << " (" << fixed << setprecision(2) << (100.0 * stats.mates_in_window / total_reads) << "%)" << endl;
+        cout << "  Mates found by window search: " << stats.mates_searched
+             << " (" << fixed << setprecision(2) << (100.0 * stats.mates_searched / total_reads) << "%)" << endl;
+        cout << endl;
+    }
+    if (read_cache) {
+        cout << "Read cache (" << read_cache->capacity() << " entries):" << endl;
+        cout << "  Hits: " << stats.cache_hits
+             << " (" << fixed << setprecision(2) << (100.0 * stats.cache_hits / total_reads) << "%)" << endl;
+        if constexpr (bio::PROFILE_ENABLED) {
+            cout << "  Mapping time saved, net of lookups: " << fixed << setprecision(2)
+                 << profile.cache_ticks_saved / bio::profileTicksPerSecond() << " s (all threads)" << endl;
+        }
+        cout << endl;
+    }
     cout << "Mapping statistics:" << endl;
     cout << "  Mapped reads: " << mapped_reads 
          << " (" << fixed << setprecision(2) << (100.0 * mapped_reads / total_reads) << "%)" << endl;
@@ -270,16 +2235,25 @@ int main(int argc, char* argv[]) {
     cout << "  Multi-mapped: " << multi_mapped
          << " (" << fixed << setprecision(2) << (100.0 * multi_mapped / total_reads) << "%)" << endl;
     cout << endl;
+    cout << "  Forward strand: " << (mapped_reads - reverse_mapped)
+         << " (" << fixed << setprecision(2) << (100.0 * (mapped_reads - reverse_mapped) / total_reads) << "%)" << endl;
+    cout << "  Reverse strand: " << reverse_mapped
+         << " (" << fixed << setprecision(2) << (100.0 * reverse_mapped / total_reads) << "%)" << endl;
+    cout << endl;
     cout << "Alignment quality:" << endl;
     cout << "  Average edit distance: " << fixed << setprecision(2) 
          << (mapped_reads > 0 ? (double)total_edit_dist / mapped_reads : 0) << endl;
+    cout << "  Candidates verified per read: " << fixed << setprecision(2)
+         << (total_reads > 0 ? (double)stats.total_candidates / total_reads : 0) << endl;
     cout << endl;
     cout << "Genome coverage (from uniquely mapped reads):" << endl;
     cout << "  Covered bases: " << covered_bases 
-         << " (" << fixed << setprecision(2) << (100.0 * covered_bases / genome.size()) << "%)" << endl;
+         << " (" << fixed << setprecision(2) << (100.0 * covered_bases / reference_bases) << "%)" << endl;
     cout << "  Average depth: " << fixed << setprecision(2) 
-         << (double)total_coverage / genome.size() << "x" << endl;
+         << (double)total_coverage / reference_bases << "x" << endl;
     cout << endl;
+    if (sam) cout << "Alignments written to: " << sam_file << endl;
+    cout << "Mapping throughput: " << fixed << setprecision(0) << total_reads / mapping_time << " reads/s" << endl;
     cout << "Total runtime: " << fixed << setprecision(1) << total_time << " seconds" << endl;
     
     return 0;
@@ -0,0 +1,75 @@
+// buildBWT against computeBWT
+//
+//   g++ -std=c++23 -O2 -pthread -o bwt_test tests/bwt_test.cpp
+//   ./bwt_test
+//
+// Small random texts on 1-3 threads, in one block and spilled; then 4 Mbp
+// texts with a 400 kbp N run, a 300 kbp repeat, a tandem repeat and a poly-A
+// run at budgets of 4 MB and 1 MB. Each must also finish within TIME_LIMIT
+// seconds: a suffix in a long run may cost up to v = 4096 bases to sort, not
+// the whole run (about 1 s here; it was 30 s when v grew with tight budgets).
+
+#include <iostream>
+#include <string>
+#include <random>
+#include <chrono>
+#include "../lib/bwt.hpp"
+
+using namespace std;
+
+constexpr double TIME_LIMIT = 10;
+
+int failures = 0;
+
+void check(bool ok, const string& what) {
+    if (!ok && failures++ < 10) cerr << "FAIL: " << what << endl;
+}
+
+int main() {
+    mt19937_64 rng(5);
+    for (int t = 0; t < 300; t++) {
+        size_t n = rng() % 600;
+        string alphabet = t % 3 == 0 ? "ACGTN" : t % 3 == 1 ? "AC" : "A";
+        string text(n, 'A');
+        for (char& c : text) c = alphabet[rng() % alphabet.size()];
+        if (t % 7 == 0 && n > 100) {
+            for (size_t i = 10; i < 90; i++) text[i] = 'N';
+        }
+        bio::BwtBuildOptions options;
+        options.threads = 1 + t % 3;
+        options.memory_bytes = t % 2 ? 1000 : 1 << 20;  // spilled, then one block
+        check(bio::buildBWT(string_view(text), options) == bio::computeBWT(text),
+              "text " + to_string(t) + " (" + to_string(n) + " bases)");
+    }
+
+    const char* names[] = {"N run", "repeat", "tandem repeat", "poly-A"};
+    for (int kind = 0; kind < 4; kind++) {
+        string text(4000000, 'A');
+        for (char& c : text) c = "ACGT"[rng() % 4];
+        for (size_t i = 0; i < 400000; i++) {
+            if (kind == 0) text[1000000 + i] = 'N';
+            if (kind == 1 && i < 300000) text[2000000 + i] = text[500000 + i];
+            if (kind == 2) text[2000000 + i] = "ACGTTGA"[i % 7];
+            if (kind == 3) text[1000000 + i] = 'A';
+        }
+        string want = bio::computeBWT(text);
+        for (size_t mb : {4, 1}) {
+            bio::BwtBuildOptions options;
+            options.threads = 2;
+            options.memory_bytes = mb << 20;
+            auto start = chrono::steady_clock::now();
+            bool same = bio::buildBWT(string_view(text), options) == want;
+            double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            string what = string(names[kind]) + " at " + to_string(mb) + " MB";
+            check(same, what);
+            check(seconds < TIME_LIMIT, what + ": " + to_string(seconds) + " s");
+            cout << what << ": " << seconds << " s" << endl;
+        }
+    }
+    if (failures) {
+        cerr << failures << " failures" << endl;
+        return 1;
+    }
+    cout << "bwt_test: OK" << endl;
+    return 0;
+}
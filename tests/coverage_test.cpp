@@ -0,0 +1,128 @@
+// CoverageCounter against a per-base count
+//
+//   g++ -std=c++23 -O2 -pthread -o coverage_test tests/coverage_test.cpp
+//   ./coverage_test
+//
+// Four threads add reads to one counter through their own Writers, on 1 to
+// 38 shards: clusters of overlapping reads (flushed through the difference
+// array), reads spread thinly over the genome (added directly), reads
+// crossing shard boundaries and running off the genome end, and a hotspot
+// covered more than MAX_DEPTH times. Depths must equal min(count, MAX_DEPTH)
+// of a plain vector<int>, and histogram() and add()'s counted bases must
+// agree with them.
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <random>
+#include <thread>
+#include "../lib/coverage.hpp"
+
+using namespace std;
+
+int failures = 0;
+
+void check(bool ok, const string& what) {
+    if (!ok && failures++ < 10) cerr << "FAIL: " << what << endl;
+}
+
+struct Read {
+    size_t start, end;
+};
+
+// Reads of thread t in groups, each flushed on its own so that a flush sees
+// only dense or only sparse reads
+vector<vector<Read>> makeReads(size_t genome, size_t shard_len, int t, mt19937_64& rng) {
+    vector<vector<Read>> groups(4);
+    vector<Read>* reads = &groups[0];
+    for (int c = 0; c < 20; c++) {
+        size_t at = rng() % genome;
+        for (int i = 0; i < 500; i++) {
+            size_t start = at + rng() % 300;
+            reads->push_back({start, start + 50 + rng() % 100});
+        }
+    }
+    reads = &groups[1];
+    for (int i = 0; i < 3000; i++) {
+        size_t start = rng() % genome;
+        reads->push_back({start, start + 1 + rng() % 150});
+    }
+    reads = &groups[2];
+    for (size_t b = shard_len; b < genome; b += shard_len) {
+        size_t start = b - 1 - rng() % 100;
+        reads->push_back({start, start + 100 + rng() % (2 * shard_len)});
+    }
+    reads->push_back({genome - 10, genome + 90});
+    reads = &groups[3];
+    // The hotspot: 20000 reads per thread over the same 300 bases
+    for (int i = 0; i < 20000; i++) {
+        size_t start = genome / 3 + (i + t) % 50;
+        reads->push_back({start, start + 250});
+    }
+    for (vector<Read>& group : groups) shuffle(group.begin(), group.end(), rng);
+    return groups;
+}
+
+int main() {
+    const int threads = 4;
+    for (size_t genome : {size_t(1000), size_t(300000), size_t(2500000)}) {
+        for (size_t max_shards : {size_t(1), size_t(7), size_t(256)}) {
+            string name = "genome " + to_string(genome) + ", " + to_string(max_shards) + " shards";
+            bio::CoverageCounter coverage(genome, max_shards);
+            size_t shards = clamp<size_t>(genome >> 16, 1, max_shards);  // as CoverageCounter splits it
+            size_t shard_len = (genome + shards - 1) / shards;
+            vector<vector<vector<Read>>> reads(threads);
+            mt19937_64 rng(genome + max_shards);
+            for (int t = 0; t < threads; t++) reads[t] = makeReads(genome, shard_len, t, rng);
+
+            vector<size_t> counted(threads, 0);
+            vector<thread> workers;
+            for (int t = 0; t < threads; t++) {
+                workers.emplace_back([&, t] {
+                    bio::CoverageCounter::Writer writer(coverage);
+                    for (const vector<Read>& group : reads[t]) {
+                        for (const Read& r : group) counted[t] += writer.add(r.start, r.end);
+                        writer.flush();
+                    }
+                });
+            }
+            for (thread& w : workers) w.join();
+
+            vector<int> naive(genome + 1, 0);
+            size_t bases = 0;
+            for (const auto& groups : reads) {
+                for (const vector<Read>& group : groups) {
+                    for (const Read& r : group) {
+                        size_t end = min(r.end, genome);
+                        if (end <= r.start) continue;
+                        naive[r.start]++;
+                        naive[end]--;
+                        bases += end - r.start;
+                    }
+                }
+            }
+            vector<long long> hist;
+            int depth = 0, saturated = 0;
+            for (size_t i = 0; i < genome; i++) {
+                depth += naive[i];
+                int want = min<int>(depth, bio::CoverageCounter::MAX_DEPTH);
+                saturated += depth > bio::CoverageCounter::MAX_DEPTH;
+                check(coverage.depth(i) == want, name + ": depth at " + to_string(i) + " is " +
+                      to_string(coverage.depth(i)) + ", not " + to_string(want));
+                if ((size_t)want >= hist.size()) hist.resize(want + 1, 0);
+                hist[want]++;
+            }
+            check(saturated > 0, name + ": no base above MAX_DEPTH");
+            check(coverage.histogram() == hist, name + ": histogram");
+            size_t total = 0;
+            for (size_t c : counted) total += c;
+            check(total == bases, name + ": add() counted " + to_string(total) + " bases, not " + to_string(bases));
+        }
+    }
+    if (failures) {
+        cerr << failures << " failures" << endl;
+        return 1;
+    }
+    cout << "coverage_test: OK" << endl;
+    return 0;
+}
@@ -0,0 +1,97 @@
+// Bit-parallel edit distance kernels against editDistanceFull
+//
+//   g++ -std=c++23 -O2 -o edit_distance_test tests/edit_distance_test.cpp
+//   ./edit_distance_test
+//
+// Patterns of 1-300 bases are mutated copies of a random text window, so
+// distances fall on both sides of max_errors. One BitParallelPattern is
+// reassigned for every pattern; distance(), editDistanceBitParallel() and
+// distances() over the string and the packed text, at each SimdLevel the CPU
+// supports, must all equal min(editDistanceFull, max_errors + 1). Patterns
+// over 256 bases take the scalar path of distances() at every level.
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include "../lib/edit_distance.hpp"
+
+using namespace std;
+
+int failures = 0;
+
+void check(bool ok, const string& what) {
+    if (!ok && failures++ < 10) cerr << "FAIL: " << what << endl;
+}
+
+// Up to `edits` substitutions, insertions and deletions
+string mutate(string s, int edits, mt19937_64& rng) {
+    for (int e = 0; e < edits; e++) {
+        size_t p = rng() % (s.size() + 1);
+        char c = "ACGT"[rng() % 4];
+        switch (rng() % 3) {
+            case 0: if (p < s.size()) s[p] = c; break;
+            case 1: s.insert(s.begin() + p, c); break;
+            default: if (p < s.size() && s.size() > 1) s.erase(s.begin() + p); break;
+        }
+    }
+    return s;
+}
+
+int main() {
+    mt19937_64 rng(3);
+    const bio::SimdLevel levels[] = {bio::SimdLevel::Scalar, bio::SimdLevel::SSE41, bio::SimdLevel::AVX2};
+    int num_levels = 1 + (int)bio::detectSimdLevel();
+
+    string text(4000, 'A');
+    for (char& c : text) c = "ACGT"[rng() % 4];
+    for (int k = 0; k < 20; k++) text[rng() % text.size()] = 'N';
+    bio::PackedSequence packed(text);
+
+    bio::BitParallelPattern pattern;
+    vector<int> starts, expected, out;
+    for (int t = 0; t < 3000; t++) {
+        int m = t < 300 ? 1 + t : 1 + rng() % 300;
+        int max_errors = rng() % 8;
+        size_t origin = max_errors + rng() % (text.size() - m - 2 * max_errors);
+        string p = mutate(text.substr(origin, m), rng() % (max_errors + 3), rng);
+        pattern.assign(p);
+        string name = "pattern " + to_string(t) + " (m = " + to_string(p.size()) + ", k = " + to_string(max_errors) + ")";
+
+        // Windows of one length around the origin, and a few random ones
+        int len = max(1, m + (int)(rng() % (2 * max_errors + 1)) - max_errors);
+        starts.clear();
+        for (int s = -max_errors; s <= max_errors; s++) starts.push_back(origin + s);
+        for (int r = 0; r < 3; r++) starts.push_back(rng() % (text.size() - len));
+        expected.resize(starts.size());
+        for (size_t i = 0; i < starts.size(); i++) {
+            string_view window = string_view(text).substr(starts[i], len);
+            expected[i] = min(bio::editDistanceFull(p, window), max_errors + 1);
+            check(pattern.distance(window, max_errors) == expected[i], name + ": distance at " + to_string(starts[i]));
+            check(bio::editDistanceBitParallel(window, p, max_errors) == expected[i],
+                  name + ": editDistanceBitParallel at " + to_string(starts[i]));
+        }
+
+        for (int l = 0; l < num_levels; l++) {
+            string level = " at level " + to_string(l);
+            out.assign(starts.size(), -1);
+            pattern.distances(text, starts, len, max_errors, out, levels[l]);
+            check(out == expected, name + ": distances" + level);
+            out.assign(starts.size(), -1);
+            pattern.distances(packed, starts, len, max_errors, out, levels[l]);
+            check(out == expected, name + ": packed distances" + level);
+            // Counts that leave a partial lane group
+            size_t count = 1 + rng() % starts.size();
+            out.assign(count, -1);
+            pattern.distances(text, span<const int>(starts).first(count), len, max_errors, out, levels[l]);
+            check(equal(out.begin(), out.end(), expected.begin()), name + ": " + to_string(count) + " distances" + level);
+        }
+    }
+    if (failures) {
+        cerr << failures << " failures" << endl;
+        return 1;
+    }
+    cout << "edit_distance_test: OK" << endl;
+    return 0;
+}
@@ -0,0 +1,71 @@
+// readFasta on hand-written files
+//
+//   g++ -std=c++23 -O2 -o fasta_test tests/fasta_test.cpp -lz
+//   ./fasta_test
+//
+// Records, multi-line sequences, blank and ';' comment lines, trailing blanks,
+// and sequence before the first header, which is read as one unnamed record
+// (as the original line reader, which ignored headers, accepted such files).
+// Small blocks make lines straddle block boundaries.
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "../lib/fastx.hpp"
+
+using namespace std;
+
+int failures = 0;
+
+void check(bool ok, const string& what) {
+    if (!ok && failures++ < 10) cerr << "FAIL: " << what << endl;
+}
+
+struct Expected {
+    string name;
+    string seq;
+};
+
+void checkFile(const string& text, const vector<Expected>& expected, const string& what) {
+    string path = "fasta_test.tmp.fa";
+    ofstream(path, ios::binary) << text;
+    for (size_t block : {size_t(3), size_t(4) << 20}) {
+        string label = what + " (block " + to_string(block) + ")";
+        string sequence;
+        vector<bio::FastaContig> contigs;
+        try {
+            contigs = bio::readFasta(path, sequence, block);
+        } catch (const exception& e) {
+            check(false, label + ": threw " + e.what());
+            continue;
+        }
+        check(contigs.size() == expected.size(), label + ": " + to_string(contigs.size()) + " records");
+        string all;
+        for (size_t i = 0; i < min(contigs.size(), expected.size()); i++) {
+            check(contigs[i].name == expected[i].name, label + ": name of record " + to_string(i));
+            check(contigs[i].offset == all.size(), label + ": offset of record " + to_string(i));
+            check(sequence.substr(contigs[i].offset, contigs[i].length) == expected[i].seq,
+                  label + ": sequence of record " + to_string(i));
+            all += expected[i].seq;
+        }
+        check(sequence == all, label + ": concatenated sequence");
+    }
+    remove(path.c_str());
+}
+
+int main() {
+    checkFile(">chr1 first\nACGT\nAC\n>chr2\nGGTT\n", {{"chr1", "ACGTAC"}, {"chr2", "GGTT"}}, "records");
+    checkFile("; comment\n\n>a\tdesc\nAC \n\nGT\t\n;x\nNN", {{"a", "ACGTNN"}}, "blanks and comments");
+    checkFile("ACGT\nTTGA\n", {{"", "ACGTTTGA"}}, "headerless");
+    checkFile("\nACGT\nAC\n>chr2\nGG\n", {{"", "ACGTAC"}, {"chr2", "GG"}}, "sequence before the first header");
+    checkFile(">empty\n>chr2\nGG\n", {{"empty", ""}, {"chr2", "GG"}}, "empty record");
+    checkFile("", {}, "empty file");
+    if (failures) {
+        cerr << failures << " failures" << endl;
+        return 1;
+    }
+    cout << "fasta_test: OK" << endl;
+    return 0;
+}
@@ -0,0 +1,71 @@
+// FMIndex against the suffix array it is built from
+//
+//   g++ -std=c++23 -O2 -o fm_index_test tests/fm_index_test.cpp
+//   ./fm_index_test
+//
+// On random texts with and without N (single bases, runs, and the N between
+// the records of a contig table), every backwardSearch() interval must equal
+// suffixArrayLowerBound/UpperBound and every locate() the suffix array entry,
+// for both the string and the packed text.
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <random>
+#include "../lib/bwt.hpp"
+
+using namespace std;
+
+int failures = 0;
+
+void check(bool ok, const string& what) {
+    if (!ok && failures++ < 10) cerr << "FAIL: " << what << endl;
+}
+
+template<typename Text>
+void checkIndex(const string& text, const Text& indexed, const vector<int>& sa, mt19937_64& rng, const string& name) {
+    bio::FMIndex fm(indexed, sa, 8);
+    for (size_t row = 0; row < sa.size(); row++) {
+        check(fm.locate(row) == sa[row], name + ": locate(" + to_string(row) + ")");
+    }
+    for (int q = 0; q < 2000; q++) {
+        size_t len = 1 + rng() % 12, pos = rng() % text.size();
+        string pattern = text.substr(pos, len);
+        if (q % 3 == 0) {
+            for (char& c : pattern) c = "ACGT"[rng() % 4];  // mostly absent
+        }
+        int lo = bio::suffixArrayLowerBound(text, sa, pattern), hi = bio::suffixArrayUpperBound(text, sa, pattern);
+        if (pattern.find_first_not_of("ACGT") != string::npos) lo = hi = 0;  // never matched
+        if (lo == hi) lo = hi = 0;
+        auto [fm_lo, fm_hi] = fm.backwardSearch(pattern);
+        check(fm_lo == lo && fm_hi == hi, name + ": backwardSearch(" + pattern + ")");
+    }
+}
+
+int main() {
+    mt19937_64 rng(7);
+    for (int t = 0; t < 60; t++) {
+        size_t n = 50 + rng() % 3000;
+        string text(n, 'A');
+        for (char& c : text) c = "ACGT"[rng() % 4];
+        if (t % 4 == 1) {
+            for (int k = 0; k < 3; k++) text[rng() % n] = 'N';
+        } else if (t % 4 == 2) {
+            size_t run = rng() % n;
+            for (size_t i = run; i < min(n, run + 1 + rng() % 40); i++) text[i] = 'N';
+        } else if (t % 4 == 3) {
+            // Records separated like a ContigTable
+            for (size_t i = 0; i < n; i += 1 + rng() % 500) text[i] = 'N';
+        }
+        vector<int> sa = bio::buildSuffixArray(text);
+        string name = "text " + to_string(t);
+        checkIndex(text, string_view(text), sa, rng, name);
+        checkIndex(text, bio::PackedSequence(text), sa, rng, name + " (packed)");
+    }
+    if (failures) {
+        cerr << failures << " failures" << endl;
+        return 1;
+    }
+    cout << "fm_index_test: OK" << endl;
+    return 0;
+}
@@ -0,0 +1,136 @@
+// GzipReader against the plain file
+//
+//   g++ -std=c++23 -O2 -pthread -o gzip_test tests/gzip_test.cpp -lz
+//   ./gzip_test
+//
+// A 12 MB FASTQ is written plain, as one gzip member, as three concatenated
+// members and as BGZF (compressed here with zlib). Each is read back through
+// BlockFile with 1 and 4 decompression threads, in reads of random size so
+// the background threads run ahead into the in-flight limit, and must give
+// the plain bytes; closing a reader after its first block must stop its
+// threads. Truncated copies of every compressed form must throw.
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <random>
+#include <zlib.h>
+#include "../lib/fastx.hpp"
+
+using namespace std;
+
+int failures = 0;
+
+void check(bool ok, const string& what) {
+    if (!ok && failures++ < 10) cerr << "FAIL: " << what << endl;
+}
+
+// One gzip member (windowBits 31), or a raw deflate stream (windowBits -15)
+string deflateBytes(string_view data, int window_bits) {
+    z_stream zs{};
+    deflateInit2(&zs, 6, Z_DEFLATED, window_bits, 8, Z_DEFAULT_STRATEGY);
+    string out(deflateBound(&zs, data.size()), '\0');
+    zs.next_in = (unsigned char*)data.data();
+    zs.avail_in = data.size();
+    zs.next_out = (unsigned char*)out.data();
+    zs.avail_out = out.size();
+    deflate(&zs, Z_FINISH);
+    out.resize(zs.total_out);
+    deflateEnd(&zs);
+    return out;
+}
+
+// BGZF: gzip members of at most 64 KiB with a 'BC' extra field holding the
+// member size, then the empty end-of-file member
+string bgzf(string_view data) {
+    string out;
+    auto member = [&](string_view in) {
+        string body = deflateBytes(in, -15);
+        size_t bsize = 18 + body.size() + 8 - 1;
+        unsigned char header[18] = {0x1f, 0x8b, 8, 4, 0, 0, 0, 0, 0, 0xff, 6, 0, 'B', 'C', 2, 0,
+                                    (unsigned char)(bsize & 0xff), (unsigned char)(bsize >> 8)};
+        uint32_t crc = crc32(0, (const unsigned char*)in.data(), in.size());
+        uint32_t isize = in.size();
+        out.append((const char*)header, sizeof(header));
+        out += body;
+        for (int i = 0; i < 4; i++) out += char(crc >> (8 * i));
+        for (int i = 0; i < 4; i++) out += char(isize >> (8 * i));
+    };
+    for (size_t i = 0; i < data.size(); i += 65280) member(data.substr(i, 65280));
+    member("");
+    return out;
+}
+
+string readAll(const string& path, int threads, mt19937_64& rng) {
+    bio::detail::BlockFile file(path, threads);
+    string out;
+    vector<char> buf(1 << 20);
+    while (size_t got = file.read(buf.data(), 1 + rng() % buf.size())) out.append(buf.data(), got);
+    return out;
+}
+
+int main() {
+    mt19937_64 rng(9);
+    string fastq;
+    for (int r = 0; fastq.size() < (12 << 20); r++) {
+        string seq(100, 'A'), qual(100, 'I');
+        for (char& c : seq) c = "ACGTN"[rng() % 5];
+        for (char& c : qual) c = '!' + rng() % 41;
+        fastq += "@read" + to_string(r) + "\n" + seq + "\n+\n" + qual + "\n";
+    }
+    string_view all(fastq);
+    size_t third = fastq.size() / 3;
+    vector<pair<string, string>> files = {
+        {"plain", fastq},
+        {"gzip", deflateBytes(all, 31)},
+        {"concatenated gzip", deflateBytes(all.substr(0, third), 31) + deflateBytes(all.substr(third, third), 31) +
+                              deflateBytes(all.substr(2 * third), 31)},
+        {"BGZF", bgzf(all)},
+    };
+
+    string path = "gzip_test.tmp.fq";
+    for (const auto& [name, bytes] : files) {
+        ofstream(path, ios::binary) << bytes;
+        for (int threads : {1, 4}) {
+            string label = name + " (" + to_string(threads) + " threads)";
+            try {
+                check(readAll(path, threads, rng) == fastq, label + ": bytes differ");
+            } catch (const exception& e) {
+                check(false, label + ": threw " + e.what());
+            }
+        }
+        if (name == "plain") continue;
+
+        // Closing early stops threads blocked on the in-flight limit
+        for (int threads : {1, 4}) {
+            bio::detail::BlockFile file(path, threads);
+            vector<char> buf(4096);
+            check(file.read(buf.data(), buf.size()) > 0 && string_view(buf.data(), 6) == "@read0",
+                  name + " (" + to_string(threads) + " threads): first block");
+        }
+
+        // Cut inside the last member, and inside the first
+        for (size_t cut : {bytes.size() - 40, bytes.size() / 5}) {
+            ofstream(path, ios::binary) << string_view(bytes).substr(0, cut);
+            for (int threads : {1, 4}) {
+                string label = name + " cut at " + to_string(cut) + " (" + to_string(threads) + " threads)";
+                bool threw = false;
+                try {
+                    readAll(path, threads, rng);
+                } catch (const runtime_error&) {
+                    threw = true;
+                }
+                check(threw, label + ": no error");
+            }
+        }
+    }
+    remove(path.c_str());
+    if (failures) {
+        cerr << failures << " failures" << endl;
+        return 1;
+    }
+    cout << "gzip_test: OK" << endl;
+    return 0;
+}
@@ -0,0 +1,109 @@
+// IndexWriter and MappedIndex on small files
+//
+//   g++ -std=c++23 -O2 -o index_file_test tests/index_file_test.cpp
+//   ./index_file_test
+//
+// A written index reads back section by section and verifies; rewriting it
+// while it is mapped leaves the mapping intact and no temporary file behind.
+// Section entries pointing past the end of the file, including ones whose
+// offset + size wraps around, must be rejected even with a valid header
+// checksum.
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <string>
+#include <vector>
+#include "../lib/index_file.hpp"
+
+using namespace std;
+
+int failures = 0;
+
+void check(bool ok, const string& what) {
+    if (!ok && failures++ < 10) cerr << "FAIL: " << what << endl;
+}
+
+string readFile(const string& path) {
+    ifstream in(path, ios::binary);
+    return string(istreambuf_iterator<char>(in), {});
+}
+
+// Rewrites the entry of section i with the given offset and size and a header
+// checksum matching the change
+void tamper(const string& path, size_t i, uint64_t offset, uint64_t size) {
+    string data = readFile(path);
+    bio::IndexHeader header;
+    memcpy(&header, data.data(), sizeof(header));
+    vector<bio::IndexSectionEntry> entries(header.section_count);
+    memcpy(entries.data(), data.data() + sizeof(header), entries.size() * sizeof(bio::IndexSectionEntry));
+    entries[i].offset = offset;
+    entries[i].size = size;
+    header.table_checksum = bio::detail::tableChecksum(header, entries.data());
+    memcpy(data.data(), &header, sizeof(header));
+    memcpy(data.data() + sizeof(header), entries.data(), entries.size() * sizeof(bio::IndexSectionEntry));
+    ofstream(path, ios::binary | ios::trunc) << data;
+}
+
+bool rejected(const string& path) {
+    try {
+        bio::MappedIndex index(path);
+    } catch (const exception&) {
+        return true;
+    }
+    return false;
+}
+
+int main() {
+    string path = "index_file_test.tmp.idx";
+    vector<uint64_t> offsets = {0, 1000, 2001};
+    string names = "chr1\nchr2\n";
+
+    bio::IndexWriter writer;
+    writer.add(bio::IndexSection::ContigOffsets, span<const uint64_t>(offsets));
+    writer.add(bio::IndexSection::ContigNames, names.data(), names.size());
+    writer.write(path);
+    check(!ifstream(path + ".tmp"), "temporary file left behind");
+    {
+        bio::MappedIndex index(path);
+        check(index.verify(), "verify");
+        auto read_offsets = index.array<uint64_t>(bio::IndexSection::ContigOffsets);
+        check(vector<uint64_t>(read_offsets.begin(), read_offsets.end()) == offsets, "offsets read back");
+        check(index.bytes(bio::IndexSection::ContigNames) == names, "names read back");
+
+        // Replacing the file leaves the old mapping readable
+        bio::IndexWriter other;
+        string other_names = "other\n";
+        other.add(bio::IndexSection::ContigNames, other_names.data(), other_names.size());
+        other.write(path);
+        check(index.bytes(bio::IndexSection::ContigNames) == names, "mapping after rewrite");
+        check(bio::MappedIndex(path).bytes(bio::IndexSection::ContigNames) == other_names, "rewritten file");
+    }
+
+    writer.write(path);
+    string good = readFile(path);
+    uint64_t max = numeric_limits<uint64_t>::max();
+    struct Case {
+        uint64_t offset, size;
+        const char* what;
+    };
+    for (Case c : {Case{good.size() + 64, 0, "offset past the end"},
+                   Case{64, good.size(), "size past the end"},
+                   Case{64, max - 63, "offset + size wrapping to 0"},
+                   Case{max, 2, "offset + size wrapping to 1"}}) {
+        tamper(path, 0, c.offset, c.size);
+        check(rejected(path), c.what);
+        ofstream(path, ios::binary | ios::trunc) << good;
+    }
+    check(!rejected(path), "restored file");
+    remove(path.c_str());
+
+    if (failures) {
+        cerr << failures << " failures" << endl;
+        return 1;
+    }
+    cout << "index_file_test: OK" << endl;
+    return 0;
+}
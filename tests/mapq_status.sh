@@ -0,0 +1,55 @@
+#!/bin/sh
+# A read's status and its MAPQ must agree: on a reference with repeats, and
+# reads with substitutions and indels, the uniquely mapped reads of
+# --stats-json are exactly the SAM records with MAPQ > 0, and the
+# multi-mapped ones those with MAPQ 0
+#
+#   g++ -std=c++23 -O3 -pthread -o mapper mapper.cpp -lz
+#   tests/mapq_status.sh
+
+mapper=${MAPPER:-./mapper}
+work=${WORK:-${TMPDIR:-/tmp}}/mapq_status.$$
+mkdir -p "$work" || exit 1
+trap 'rm -rf "$work"' EXIT
+
+awk 'BEGIN {
+    srand(23)
+    unit = ""
+    for (i = 0; i < 300; i++) unit = unit substr("ACGT", int(rand() * 4) + 1, 1)
+    s = ""
+    for (b = 0; b < 200; b++) {
+        if (b % 10 == 0) { s = s unit; continue }  # a repeat every 10th block
+        for (i = 0; i < 300; i++) s = s substr("ACGT", int(rand() * 4) + 1, 1)
+    }
+    print ">chr1" > "'"$work"'/ref.fa"
+    for (i = 1; i <= length(s); i += 60) print substr(s, i, 60) > "'"$work"'/ref.fa"
+    qual = ""
+    for (i = 0; i < 100; i++) qual = qual "I"
+    for (k = 0; k < 3000; k++) {
+        # Up to 3 substitutions, insertions or deletions, then trimmed to 100
+        r = substr(s, int(rand() * (length(s) - 110)) + 1, 110)
+        for (e = int(rand() * 4); e > 0; e--) {
+            p = int(rand() * 100) + 1
+            c = substr("ACGT", int(rand() * 4) + 1, 1)
+            t = int(rand() * 3)
+            if (t == 0) r = substr(r, 1, p - 1) c substr(r, p + 1)
+            else if (t == 1) r = substr(r, 1, p - 1) c substr(r, p)
+            else r = substr(r, 1, p - 1) substr(r, p + 1)
+        }
+        r = substr(r, 1, 100)
+        printf "@read%d\n%s\n+\n%s\n", k, r, qual > "'"$work"'/reads.fq"
+    }
+}'
+
+"$mapper" -g "$work/ref.fa" -r "$work/reads.fq" -o "$work/out.sam" --stats-json "$work/stats.json" > /dev/null 2>&1 \
+    || { echo "mapq_status: mapper failed" >&2; exit 1; }
+
+unique=$(sed -n 's/.*"unique": \([0-9]*\).*/\1/p' "$work/stats.json")
+multi=$(sed -n 's/.*"multi": \([0-9]*\).*/\1/p' "$work/stats.json")
+positive=$(grep -v '^@' "$work/out.sam" | awk '$3 != "*" && $5 > 0' | wc -l)
+zero=$(grep -v '^@' "$work/out.sam" | awk '$3 != "*" && $5 == 0' | wc -l)
+if [ "$multi" -eq 0 ] || [ "$unique" -ne "$positive" ] || [ "$multi" -ne "$zero" ]; then
+    echo "mapq_status: $unique unique and $multi multi-mapped, but $positive records with MAPQ > 0 and $zero with MAPQ 0" >&2
+    exit 1
+fi
+echo "mapq_status: OK"
@@ -0,0 +1,45 @@
+#!/bin/sh
+# --fm on a multi-record reference, where the contig table joins the records
+# with N: reads drawn from every record must map, with the same SAM records
+# as the suffix-array lookup
+#
+#   g++ -std=c++23 -O3 -pthread -o mapper mapper.cpp -lz
+#   tests/multi_record_fm.sh
+
+mapper=${MAPPER:-./mapper}
+work=${WORK:-${TMPDIR:-/tmp}}/multi_record_fm.$$
+mkdir -p "$work" || exit 1
+trap 'rm -rf "$work"' EXIT
+
+awk 'BEGIN {
+    srand(11)
+    for (r = 1; r <= 3; r++) {
+        s = ""
+        for (i = 0; i < 20000; i++) s = s substr("ACGT", int(rand() * 4) + 1, 1)
+        seq[r] = s
+        printf ">chr%d\n", r > "'"$work"'/ref.fa"
+        for (i = 1; i <= length(s); i += 60) print substr(s, i, 60) > "'"$work"'/ref.fa"
+    }
+    qual = ""
+    for (i = 0; i < 100; i++) qual = qual "I"
+    for (k = 0; k < 600; k++) {
+        r = k % 3 + 1
+        printf "@read%d\n%s\n+\n%s\n", k, substr(seq[r], int(rand() * 19900) + 1, 100), qual > "'"$work"'/reads.fq"
+    }
+}'
+
+"$mapper" -g "$work/ref.fa" -r "$work/reads.fq" -o "$work/sa.sam" > /dev/null 2>&1 || { echo "multi_record_fm: mapper failed" >&2; exit 1; }
+"$mapper" -g "$work/ref.fa" -r "$work/reads.fq" -o "$work/fm.sam" --fm > /dev/null 2>&1 || { echo "multi_record_fm: mapper --fm failed" >&2; exit 1; }
+
+mapped=$(grep -v '^@' "$work/fm.sam" | awk '$3 != "*"' | wc -l)
+if [ "$mapped" -ne 600 ]; then
+    echo "multi_record_fm: $mapped of 600 reads mapped with --fm" >&2
+    exit 1
+fi
+# The @PG lines differ by the command line
+grep -v '^@PG' "$work/fm.sam" > "$work/fm.sam.body"
+if ! grep -v '^@PG' "$work/sa.sam" | cmp -s - "$work/fm.sam.body"; then
+    echo "multi_record_fm: --fm SAM differs from the suffix array's" >&2
+    exit 1
+fi
+echo "multi_record_fm: OK"
@@ -0,0 +1,89 @@
+#!/bin/sh
+# Paired-end SAM fields on simulated pairs, some with an unmappable second
+# mate: FLAG bits 0x1/0x2/0x8/0x20/0x40/0x80 and RNEXT/PNEXT/TLEN must agree
+# with the mate's record (PNEXT its POS, TLEN the aligned span of both), most
+# pairs must be proper, and -t 1 and -t 8 must write the same records
+#
+#   g++ -std=c++23 -O3 -pthread -o mapper mapper.cpp -lz
+#   g++ -std=c++23 -O3 -pthread -o simulate_reads bench/simulate_reads.cpp -lz
+#   SIMULATE_READS=./simulate_reads tests/paired_end.sh
+
+mapper=${MAPPER:-./mapper}
+work=${WORK:-${TMPDIR:-/tmp}}/paired_end.$$
+mkdir -p "$work" || exit 1
+trap 'rm -rf "$work"' EXIT
+
+simulate=${SIMULATE_READS:-}
+if [ -z "$simulate" ]; then
+    simulate="$work/simulate_reads"
+    g++ -std=c++23 -O2 -pthread -o "$simulate" "$(dirname "$0")/../bench/simulate_reads.cpp" -lz \
+        || { echo "paired_end: cannot build simulate_reads" >&2; exit 1; }
+fi
+"$simulate" --random-genome 1 --repeat-fraction 0.1 --genome-out "$work/ref.fa" -n 20000 \
+    -o "$work/reads_1.fq" --pair-out "$work/mates.fq" > /dev/null 2>&1 \
+    || { echo "paired_end: simulate_reads failed" >&2; exit 1; }
+# Every 50th second mate becomes random bases, which do not map
+awk 'BEGIN { srand(3) }
+NR % 4 == 2 && (NR - 2) % 200 == 0 {
+    s = ""
+    for (i = 0; i < length($0); i++) s = s substr("ACGT", int(rand() * 4) + 1, 1)
+    $0 = s
+}
+{ print }' "$work/mates.fq" > "$work/reads_2.fq"
+
+for t in 1 8; do
+    "$mapper" -g "$work/ref.fa" -r1 "$work/reads_1.fq" -r2 "$work/reads_2.fq" -t $t -o "$work/out$t.sam" > /dev/null 2>&1 \
+        || { echo "paired_end: mapper -t $t failed" >&2; exit 1; }
+    grep -v '^@' "$work/out$t.sam" > "$work/records$t"
+done
+if ! cmp -s "$work/records1" "$work/records8"; then
+    echo "paired_end: -t 1 and -t 8 write different records" >&2
+    exit 1
+fi
+
+# Records come in pairs, first mate then second
+awk -F '\t' '
+function bit(flag, b) { return int(flag / b) % 2 }
+# One past the last reference base: POS plus the M and D lengths of CIGAR
+function end(pos, cigar,    n) {
+    while (match(cigar, /^[0-9]+[MID]/)) {
+        n = substr(cigar, 1, RLENGTH - 1)
+        if (substr(cigar, RLENGTH, 1) != "I") pos += n
+        cigar = substr(cigar, RLENGTH + 1)
+    }
+    return pos
+}
+function fail(what) { print "paired_end: " $1 ": " what > "/dev/stderr"; bad++ }
+NR % 2 == 1 { for (i = 1; i <= 9; i++) a[i] = $i; next }
+{
+    for (i = 1; i <= 9; i++) b[i] = $i
+    pairs++
+    if (a[1] != b[1]) fail("mates named differently")
+    if (!bit(a[2], 1) || !bit(b[2], 1)) fail("0x1 missing")
+    if (!bit(a[2], 64) || bit(a[2], 128) || !bit(b[2], 128) || bit(b[2], 64)) fail("0x40/0x80 wrong")
+    if (bit(a[2], 2) != bit(b[2], 2)) fail("0x2 on one mate only")
+    if (bit(a[2], 8) != bit(b[2], 4) || bit(b[2], 8) != bit(a[2], 4)) fail("0x8 does not match the mate")
+    if (bit(a[2], 2)) proper++
+    if (!bit(a[2], 4) && !bit(b[2], 4)) {
+        if (bit(a[2], 32) != bit(b[2], 16) || bit(b[2], 32) != bit(a[2], 16)) fail("0x20 does not match the mate")
+        if (a[8] != b[4] || b[8] != a[4]) fail("PNEXT is not the mate position")
+        if (a[3] == b[3] && (a[7] != "=" || b[7] != "=")) fail("RNEXT is not =")
+        if (a[3] != b[3] && (a[7] != b[3] || b[7] != a[3])) fail("RNEXT is not the mate reference")
+        if (a[9] + b[9] != 0 || (bit(a[2], 2) && a[9] == 0)) fail("TLEN " a[9] " and " b[9])
+        span = (end(a[4], a[6]) > end(b[4], b[6]) ? end(a[4], a[6]) : end(b[4], b[6])) - (a[4] < b[4] ? a[4] : b[4])
+        if (a[3] == b[3] && (a[9] < 0 ? -a[9] : a[9]) != span) fail("TLEN " a[9] " is not the span " span)
+    } else if (bit(a[2], 4) != bit(b[2], 4)) {
+        unmapped++
+        if (bit(a[2], 2)) fail("proper pair with an unmapped mate")
+        if (a[3] != b[3] || a[4] != b[4]) fail("unmapped mate not placed at its mate")
+        if (a[7] != "=" || b[7] != "=" || a[8] != a[4] || b[8] != b[4]) fail("RNEXT/PNEXT of a one-mate pair")
+        if (a[9] != 0 || b[9] != 0) fail("TLEN of a one-mate pair")
+    }
+}
+END {
+    if (pairs != 20000) { print "paired_end: " pairs " pairs" > "/dev/stderr"; bad++ }
+    if (proper < 0.9 * pairs) { print "paired_end: only " proper " proper pairs" > "/dev/stderr"; bad++ }
+    if (unmapped < 300) { print "paired_end: only " unmapped " pairs with one mate unmapped" > "/dev/stderr"; bad++ }
+    exit bad > 0
+}' "$work/records1" || exit 1
+echo "paired_end: OK"
@@ -0,0 +1,24 @@
+#!/bin/sh
+# Builds and runs every test in this directory from the repository root:
+#
+#   tests/run_tests.sh
+#
+# Each tests/*.cpp is a standalone program that exits non-zero on failure;
+# each tests/*.sh other than this one runs against a freshly built ./mapper.
+
+set -e
+cd "$(dirname "$0")/.."
+out=$(mktemp -d)
+trap 'rm -rf "$out"' EXIT
+
+g++ -std=c++23 -O2 -pthread -o "$out/mapper" mapper.cpp -lz
+for test in tests/*.cpp; do
+    name=$(basename "$test" .cpp)
+    g++ -std=c++23 -O2 -pthread -o "$out/$name" "$test" -lz
+    "$out/$name"
+done
+for test in tests/*.sh; do
+    [ "$test" = tests/run_tests.sh ] && continue
+    MAPPER="$out/mapper" WORK="$out" sh "$test"
+done
+echo "All tests passed"
@@ -0,0 +1,50 @@
+#!/bin/sh
+# Lowercase and empty reads in SAM output: a lowercase read drawn from the
+# reference maps with a CIGAR on both strands, with and without a mismatch,
+# and an empty read is unmapped. No mapped record may lack a CIGAR.
+#
+#   g++ -std=c++23 -O3 -pthread -o mapper mapper.cpp -lz
+#   tests/sam_read_case.sh
+
+mapper=${MAPPER:-./mapper}
+work=${WORK:-${TMPDIR:-/tmp}}/sam_read_case.$$
+mkdir -p "$work" || exit 1
+trap 'rm -rf "$work"' EXIT
+
+awk 'BEGIN {
+    srand(5)
+    s = ""
+    for (i = 0; i < 20000; i++) s = s substr("ACGT", int(rand() * 4) + 1, 1)
+    print ">c1" > "'"$work"'/ref.fa"
+    for (i = 1; i <= length(s); i += 60) print substr(s, i, 60) > "'"$work"'/ref.fa"
+    r = substr(s, 4001, 100)
+    m = substr(r, 1, 50) (substr(r, 51, 1) == "A" ? "C" : "A") substr(r, 52)
+    qual = ""
+    for (i = 0; i < 100; i++) qual = qual "I"
+    printf "@fwd\n%s\n+\n%s\n", tolower(r), qual > "'"$work"'/reads.fq"
+    printf "@rev\n%s\n+\n%s\n", tolower(rc(r)), qual > "'"$work"'/reads.fq"
+    printf "@fwd_mismatch\n%s\n+\n%s\n", tolower(m), qual > "'"$work"'/reads.fq"
+    printf "@rev_mismatch\n%s\n+\n%s\n", tolower(rc(m)), qual > "'"$work"'/reads.fq"
+    printf "@empty\n\n+\n\n" > "'"$work"'/reads.fq"
+}
+function rc(x,    out, i, c) {
+    out = ""
+    for (i = length(x); i > 0; i--) {
+        c = substr(x, i, 1)
+        out = out (c == "A" ? "T" : c == "C" ? "G" : c == "G" ? "C" : "A")
+    }
+    return out
+}'
+
+"$mapper" -g "$work/ref.fa" -r "$work/reads.fq" -o "$work/out.sam" > /dev/null 2>&1 \
+    || { echo "sam_read_case: mapper failed" >&2; exit 1; }
+
+# name, flag, position, MAPQ and CIGAR of each record
+grep -v '^@' "$work/out.sam" | cut -f 1,2,4,5,6 > "$work/got"
+printf 'fwd\t0\t4001\t60\t100M\nrev\t16\t4001\t60\t100M\nfwd_mismatch\t0\t4001\t60\t100M\nrev_mismatch\t16\t4001\t60\t100M\nempty\t4\t0\t0\t*\n' > "$work/expected"
+if ! cmp -s "$work/got" "$work/expected"; then
+    echo "sam_read_case: unexpected records:" >&2
+    cat "$work/got" >&2
+    exit 1
+fi
+echo "sam_read_case: OK"
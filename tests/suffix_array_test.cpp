@@ -0,0 +1,136 @@
+// Suffix array construction and range searches against the binary searches
+//
+//   g++ -std=c++23 -O2 -o suffix_array_test tests/suffix_array_test.cpp
+//   ./suffix_array_test
+//
+// SA-IS (32- and 64-bit indices, string and packed text) must equal prefix
+// doubling on random texts, texts with N (single bases and runs), tandem
+// repeats and poly-A runs longer than LCP_LR_MAX, so the LCP-LR tables
+// saturate. Every suffixArrayRange (LCP-LR and prefix table, string and packed
+// text) must return [suffixArrayLowerBound, suffixArrayUpperBound) for
+// substrings of the text, mutated and random patterns, patterns with N,
+// patterns running off the text end and patterns shorter than the prefix
+// table's k. So must SuffixArrayBatch::ranges (all four overloads) at widths
+// 1, 8 and 32, for counts that are not multiples of the width.
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <random>
+#include "../lib/suffix_array.hpp"
+
+using namespace std;
+
+int failures = 0;
+
+void check(bool ok, const string& what) {
+    if (!ok && failures++ < 10) cerr << "FAIL: " << what << endl;
+}
+
+string randomBases(size_t n, mt19937_64& rng) {
+    string s(n, 'A');
+    for (char& c : s) c = "ACGT"[rng() % 4];
+    return s;
+}
+
+// Text t: random, with N, or with long repeats (t % 4)
+string makeText(int t, mt19937_64& rng) {
+    size_t n = 20 + rng() % 4000;
+    string text = randomBases(n, rng);
+    if (t % 4 == 1) {
+        for (int k = 0; k < 5; k++) text[rng() % n] = 'N';
+        size_t run = rng() % n;
+        for (size_t i = run; i < min(n, run + 1 + rng() % 30); i++) text[i] = 'N';
+    } else if (t % 4 == 2) {
+        // A tandem repeat and a copy of a long stretch: LCPs well over 255
+        string unit = randomBases(1 + rng() % 8, rng);
+        size_t at = rng() % n;
+        for (size_t i = at; i < min(n, at + 300 + rng() % 700); i++) text[i] = unit[(i - at) % unit.size()];
+        if (n > 1200) text.replace(n - 600, 500, text.substr(rng() % (n - 1200), 500));
+    } else if (t % 4 == 3) {
+        size_t at = rng() % n;
+        for (size_t i = at; i < min(n, at + 260 + rng() % 400); i++) text[i] = 'A';
+    }
+    return text;
+}
+
+// Patterns: substrings (often long, some running off the end), mutated
+// copies, random bases, and patterns with N
+vector<string> makePatterns(const string& text, mt19937_64& rng, size_t count) {
+    vector<string> patterns;
+    for (size_t q = 0; q < count; q++) {
+        size_t len = q % 5 == 0 ? 1 + rng() % 600 : 1 + rng() % 20;
+        size_t pos = rng() % text.size();
+        string p = text.substr(pos, len);
+        switch (q % 6) {
+            case 1: p = randomBases(len, rng); break;
+            case 2: p[rng() % p.size()] = "ACGT"[rng() % 4]; break;
+            case 3: p[rng() % p.size()] = 'N'; break;
+            case 4: p += randomBases(1 + rng() % 4, rng); break;  // off the end unless pos was early
+            case 5: p = text.substr(text.size() - min(text.size(), len)) + randomBases(rng() % 3, rng); break;
+        }
+        patterns.push_back(p);
+    }
+    return patterns;
+}
+
+int main() {
+    mt19937_64 rng(11);
+    for (int t = 0; t < 200; t++) {
+        string text = makeText(t, rng);
+        string name = "text " + to_string(t) + " (n = " + to_string(text.size()) + ")";
+        bio::PackedSequence packed(text);
+
+        vector<int> sa = bio::buildSuffixArray(text);
+        check(sa == bio::buildSuffixArrayDoubling(text), name + ": SA-IS differs from prefix doubling");
+        check(sa == bio::buildSuffixArray(packed), name + ": packed SA-IS differs");
+        vector<long long> sa64 = bio::buildSuffixArray64(text);
+        check(vector<int>(sa64.begin(), sa64.end()) == sa, name + ": 64-bit SA-IS differs");
+
+        bio::LcpLrTables lcp_lr = bio::buildLcpLrTables(bio::buildLcpArray(text, sa));
+        check(lcp_lr.left == bio::buildLcpLrTables(bio::buildLcpArray(packed, sa)).left,
+              name + ": packed LCP-LR tables differ");
+        int k = 1 + t % 8;
+        vector<uint32_t> table = bio::buildPrefixTable(text, k);
+        check(table == bio::buildPrefixTable(packed, k), name + ": packed prefix table differs");
+
+        vector<string> patterns = makePatterns(text, rng, 400);
+        vector<string_view> views(patterns.begin(), patterns.end());
+        vector<pair<int, int>> expected, packed_expected;
+        for (const string& p : patterns) {
+            string label = name + ": pattern " + p.substr(0, 40);
+            pair<int, int> want{bio::suffixArrayLowerBound(text, sa, p), bio::suffixArrayUpperBound(text, sa, p)};
+            pair<int, int> packed_want{bio::suffixArrayLowerBound(packed, sa, p), bio::suffixArrayUpperBound(packed, sa, p)};
+            expected.push_back(want);
+            packed_expected.push_back(packed_want);
+            check(bio::suffixArrayRange(text, sa, lcp_lr.left, lcp_lr.right, p) == want, label + ": LCP-LR range");
+            check(bio::suffixArrayRange(packed, sa, lcp_lr.left, lcp_lr.right, p) == packed_want,
+                  label + ": packed LCP-LR range");
+            check(bio::suffixArrayRange(text, sa, table, p) == want, label + ": prefix table range");
+            check(bio::suffixArrayRange(packed, sa, table, p) == packed_want, label + ": packed prefix table range");
+        }
+
+        for (size_t width : {1, 8, 32}) {
+            bio::SuffixArrayBatch batch(width);
+            size_t count = width * 7 + 1 + rng() % (width + 2);  // not a multiple of width
+            span<const string_view> some = span<const string_view>(views).first(count);
+            vector<pair<int, int>> out(count);
+            auto same = [&](const vector<pair<int, int>>& want) { return equal(out.begin(), out.end(), want.begin()); };
+            string label = name + ": batch of " + to_string(count) + " at width " + to_string(width);
+            batch.ranges(text, sa, lcp_lr.left, lcp_lr.right, some, out);
+            check(same(expected), label + ": LCP-LR ranges");
+            batch.ranges(packed, sa, lcp_lr.left, lcp_lr.right, some, out);
+            check(same(packed_expected), label + ": packed LCP-LR ranges");
+            batch.ranges(text, sa, table, some, out);
+            check(same(expected), label + ": prefix table ranges");
+            batch.ranges(packed, sa, table, some, out);
+            check(same(packed_expected), label + ": packed prefix table ranges");
+        }
+    }
+    if (failures) {
+        cerr << failures << " failures" << endl;
+        return 1;
+    }
+    cout << "suffix_array_test: OK" << endl;
+    return 0;
+}